@@ -20,6 +20,11 @@
 #define RAY_TRACING 0
 #define HEATMAP 1
 
+// Formats of BVH nodes (BVH_NODES_* of RadixTree_BVH.h)
+#define NODES_RANGES 0
+#define NODES_RADIX_TREE 1
+#define NODES_INDEXED_RANGES 2
+
 // Structure of material
 struct Material{
   vec3 diffuseCol;
@@ -58,6 +63,16 @@ struct Ray{
 	float energy;
 };
 
+// Ray prepared for watertight triangle test (same as TriangleIntersection)
+struct WatertightRay{
+
+  // Permuted axes, z is the largest component of direction
+  ivec3 k;
+
+  // Shear constants, ray goes along z axis after shear
+  vec3 shear;
+};
+
 // Point of collision between ray and triangle
 struct CollisionPoint{
 	float dist;
@@ -81,15 +96,21 @@ struct Node{
   int left;
   int right;
 
-  // Indices to node's primitives
+  // Indices to node's primitives (inner node - quantized bounds of children on x and y axis)
   int first;
   int last;
 
   // Index of parent node
   int parent;
 
-  // Additional info + memory alignment
-  int gapa, gapb, gapc;
+  // Index of sibling node (-1 for root and for node with triangle sibling in radix tree)
+  int sibling;
+
+  // Quantized bounds of children on z axis (build counter of GPU BVH)
+  int bounds;
+
+  // Split axis, left child is on its lower side (-1 for leaf)
+  int axis;
 };
 
 // Workgroup size
@@ -131,7 +152,7 @@ uniform int width;
 uniform int height;
 
 uniform int renderMode;
-uniform int bvhType;
+uniform int nodeFormat;
 
 uniform int shadowSamples = 1;
 uniform int indirectSamples = 1;
@@ -153,31 +174,6 @@ float randm(vec2 co){
     return fract(sin(dot(co.xy ,vec2(12.9898,78.233))) * 43758.5453);
 }
 
-/* Barycentric interpolation
-*
-* tr - input triangle
-* point - point for interpolation compute
-* bar_coords - variable for result barycentric coordinates
-*/
-void barycentricInterpolation(Triangle tr, vec3 point, out vec3 bar_coords){
-
-  vec3 v0 = tr.pos_b - tr.pos_a;
-	vec3 v1 = tr.pos_c - tr.pos_a;
-	vec3 v2 = point - tr.pos_a;
-
-	float d00 = dot(v0, v0);
-	float d01 = dot(v0, v1);
-	float d11 = dot(v1, v1);
-	float d20 = dot(v2, v0);
-	float d21 = dot(v2, v1);
-
-	float den = d00 * d11 - d01 * d01;
-
-  bar_coords.y = (d11 * d20 - d01 * d21) / den;
-	bar_coords.z = (d00 * d21 - d01 * d20) / den;
-	bar_coords.x = 1.0 - bar_coords.y - bar_coords.z;
-}
-
 /* Computation of lighting in some point
 *
 * col - input triangle
@@ -269,53 +265,105 @@ vec3 computeLighting(CollisionPoint col, float fresnell){
 
 }
 
-/* Ray triangle intersection (Moller-Trumbore algorithm)
+/* Preparation of ray for watertight triangle test, computed once per ray
 *
-* ray - input ray
-* tr - input triangle
-* inter - description of point of potential collision
+* r - input ray
 *
-* return true - collision occurs, false - no collision
+* return permutation of axes and shear of ray
 */
-bool rayTriangleIntersection(Ray ray, Triangle tr, out CollisionPoint inter){
+WatertightRay watertightSetup(Ray r){
+
+  WatertightRay wr;
+  vec3 d = abs(r.direction);
 
-	vec3 e1 = tr.pos_b - tr.pos_a;
-	vec3 e2 = tr.pos_c - tr.pos_a;
+  wr.k.z = d.x > d.y ? (d.x > d.z ? 0 : 2) : (d.y > d.z ? 1 : 2);
+  wr.k.x = (wr.k.z + 1) % 3;
+  wr.k.y = (wr.k.x + 1) % 3;
 
-	vec3 s1 = cross(ray.direction, e2);
+  // Winding of triangles is preserved by swap
+  if (r.direction[wr.k.z] < 0.0f)
+    wr.k.xy = wr.k.yx;
 
-	float div = dot(s1, e1);
-	if(div < 1e-7) return false;
+  wr.shear = vec3(r.direction[wr.k.x], r.direction[wr.k.y], 1.0f) / r.direction[wr.k.z];
 
-	float invdiv = 1.0 / div;
-	vec3 dis = ray.origin - tr.pos_a;
+  return wr;
+}
 
-	float u = dot(dis, s1) * invdiv;
+/* Watertight ray triangle intersection (Woop, Benthin, Wald), both sides of triangle,
+* rays through shared edges and vertices hit at least one triangle
+*
+* r - input ray
+* wr - ray prepared by watertightSetup
+* a, b, c - vertices of triangle
+* closest - distance of the closest collision found so far
+* t - output distance of collision
+* bary - output barycentric coordinates of vertices a and b
+*
+* return true - collision occurs before the closest collision, false - no collision
+*/
+bool rayTriangleIntersection(Ray r, WatertightRay wr, vec3 a, vec3 b, vec3 c, float closest, out float t, out vec2 bary){
+
+  vec3 A = a - r.origin;
+  vec3 B = b - r.origin;
+  vec3 C = c - r.origin;
+
+  // Vertices in space of ray
+  precise float ax = A[wr.k.x] - wr.shear.x * A[wr.k.z];
+  precise float ay = A[wr.k.y] - wr.shear.y * A[wr.k.z];
+  precise float bx = B[wr.k.x] - wr.shear.x * B[wr.k.z];
+  precise float by = B[wr.k.y] - wr.shear.y * B[wr.k.z];
+  precise float cx = C[wr.k.x] - wr.shear.x * C[wr.k.z];
+  precise float cy = C[wr.k.y] - wr.shear.y * C[wr.k.z];
+
+  // Edge functions (not fused, shared edge gives the same value with opposite sign)
+  precise float u = cx * by - cy * bx;
+  precise float v = ax * cy - ay * cx;
+  precise float w = bx * ay - by * ax;
+
+  // Ray through edge or vertex - sign is decided in double precision
+  if (u == 0.0f || v == 0.0f || w == 0.0f) {
+    u = float(double(cx) * double(by) - double(cy) * double(bx));
+    v = float(double(ax) * double(cy) - double(ay) * double(cx));
+    w = float(double(bx) * double(ay) - double(by) * double(ax));
+  }
 
-  if (u < 0.0 || u > 1.0)
+  if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
     return false;
 
-  vec3 qv = cross(dis, e1);
-	float v = dot(ray.direction, qv) * invdiv;
+  float det = u + v + w;
 
-  if (v < 0.0 || u + v > 1.0)
+  if (det == 0.0f)
     return false;
 
+  // Distance in range (0, closest) scaled by determinant (the same comparison as CPU test)
+  float T = wr.shear.z * (u * A[wr.k.z] + v * B[wr.k.z] + w * C[wr.k.z]);
 
-  float t = dot(e2, qv) * invdiv;
-  if(t < 1e-7)
+  if (det > 0.0f ? (T <= 0.0f || T >= closest * det) : (T >= 0.0f || T <= closest * det))
     return false;
 
-  // Collision point properties
+  t = T / det;
+  bary = vec2(u, v) / det;
+
+  return true;
+}
+
+/* Properties of collision, computed once for the closest collision after traversal
+*
+* r - input ray
+* tr - hit triangle
+* t - distance of collision
+* bary - barycentric coordinates of vertices a and b
+* inter - output collision point
+*/
+void shadeCollision(Ray r, Triangle tr, float t, vec2 bary, out CollisionPoint inter){
+
+  vec3 bc = vec3(bary, 1.0f - bary.x - bary.y);
+
 	inter.dist = t;
-	inter.position = ray.origin + t * ray.direction;
-	inter.normal = tr.nor_a;
-	inter.color = materials[tr.mat_id].diffuseCol;
+	inter.position = r.origin + t * r.direction;
   inter.metalness = materials[tr.mat_id].metalness;
   inter.roughness = materials[tr.mat_id].roughness;
 
-  vec3 bc;
-  barycentricInterpolation(tr, inter.position, bc);
   inter.normal = (bc.x * tr.nor_a) + (bc.y * tr.nor_b) + (bc.z * tr.nor_c);
 
   inter.uvs = (bc.x * tr.uv_a) + (bc.y * tr.uv_b) + (bc.z * tr.uv_c);
@@ -323,220 +371,219 @@ bool rayTriangleIntersection(Ray ray, Triangle tr, out CollisionPoint inter){
   if(inter.color.r == 0.0 && inter.color.g == 0.0 && inter.color.b == 0.0)
     inter.color = materials[tr.mat_id].diffuseCol;
 	//inter.refractionIndex = materials[tr.mat_id].refIndex;
-	//inter.metalness = materials[tr.mat_id].metalness;
 
-	return true;
 }
 
-/* Ray AABB intersection
+/* Ray test of triangle of data buffer, only positions are read
 *
-* minbb - minimal bounding box coordinates
-* maxbb - maximal bounding box coordinates
+* triangle - index of triangle in data buffer
 * r - input ray
-* t - distance of collision
+* wr - ray prepared by watertightSetup
+* closest - distance of the closest collision
+* hitTriangle - triangle of the closest collision
+* bary - barycentric coordinates of the closest collision
 *
-* return true - collision occurs, false - no collision
+* return true if found closer collision
 */
-bool boxTest(vec3 minbb, vec3 maxbb, Ray r, inout float t, inout float tbegin) {
-
-	vec3 invdir = 1.0f / r.direction;
-
-	float t1 = (minbb.x - r.origin.x) * invdir.x;
-	float t2 = (maxbb.x - r.origin.x) * invdir.x;
+bool triangleTest(int triangle, Ray r, WatertightRay wr, inout float closest, inout int hitTriangle, inout vec2 bary){
 
-	float tmin = min(t1, t2);
-	float tmax = max(t1, t2);
+  float t;
+  vec2 b;
 
-	t1 = (minbb.y - r.origin.y) * invdir.y;
-	t2 = (maxbb.y - r.origin.y) * invdir.y;
-
-	tmin = max(tmin, min(min(t1, t2), tmax));
-	tmax = min(tmax, max(max(t1, t2), tmin));
-
-	t1 = (minbb.z - r.origin.z) * invdir.z;
-	t2 = (maxbb.z - r.origin.z) * invdir.z;
+  if (!rayTriangleIntersection(r, wr, data[triangle].pos_a, data[triangle].pos_b, data[triangle].pos_c, closest, t, b))
+    return false;
 
-	tmin = max(tmin, min(min(t1, t2), tmax));
-	tmax = min(tmax, max(max(t1, t2), tmin));
+  closest = t;
+  hitTriangle = triangle;
+  bary = b;
 
-	return tmax > max(tmin, 0.0f);
+  return true;
 
 }
 
-
-/* Ray BVH traversal
+/* Ray AABB intersection
 *
+* minbb - minimal bounding box coordinates
+* maxbb - maximal bounding box coordinates
 * r - input ray
-* c - output collision point
+* invdir - reciprocal direction of ray
+* closest - distance of the closest collision found so far
 *
-* return true if found some collision with any primitive, else it returns false
+* return true - collision occurs before the closest collision, false - no collision
 */
-bool bvhTraversal(Ray r, out CollisionPoint c){
-
-  int found = -1;
-  int top = 0;
-  long lstack = 0;
-  long rstack = 0;
-  CollisionPoint hitPoint;
-  float closest = 10000.0;
-  bool res = false;
+bool boxTest(vec3 minbb, vec3 maxbb, Ray r, vec3 invdir, float closest) {
 
-  // Traversal loop
-  while (top != -1) {
+  vec3 t1 = (minbb - r.origin) * invdir;
+  vec3 t2 = (maxbb - r.origin) * invdir;
 
-    Node n = tree[top];
-  	bool backtrack = false;
+  vec3 tmin = min(t1, t2);
+  vec3 tmax = max(t1, t2);
 
-    heat += 0.001f;
+  float tnear = max(max(tmin.x, tmin.y), max(tmin.z, 0.0f));
+  float tfar = min(min(tmax.x, tmax.y), min(tmax.z, closest));
 
-    // Leaf nodes - ray-triangle intersection tests
-  	if (n.first != -1 || n.last != -1) {
+  return tnear <= tfar;
 
-      // GPU BVH leaf node
-      if(bvhType == 1){
+}
 
-       if(n.first != -1){
+/* Ray test of child box, one fetch of inner node gives bounds of both children
+*
+* n - inner node
+* child - index of child node
+* r - input ray
+* invdir - reciprocal direction of ray
+* closest - distance of the closest collision found so far
+*
+* return true - collision occurs before the closest collision, false - no collision
+*/
+bool childTest(Node n, int child, Ray r, vec3 invdir, float closest){
 
-          if(rayTriangleIntersection(r, data[indices[n.first]], hitPoint)){
+  // GPU BVH - bounds are read from child node
+  if (nodeFormat == NODES_RADIX_TREE)
+    return boxTest(vec3(tree[child].min), vec3(tree[child].max), r, invdir, closest);
 
-            if(hitPoint.dist < closest){
-              c = hitPoint;
-              closest = hitPoint.dist;
-              res = true;
-            }
+  // Planes of children quantized relative to node (left min, left max, right min, right max)
+  vec4 qx = unpackUnorm4x8(uint(n.first));
+  vec4 qy = unpackUnorm4x8(uint(n.last));
+  vec4 qz = unpackUnorm4x8(uint(n.bounds));
 
-          }
+  vec3 low = child == n.left ? vec3(qx.x, qy.x, qz.x) : vec3(qx.z, qy.z, qz.z);
+  vec3 high = child == n.left ? vec3(qx.y, qy.y, qz.y) : vec3(qx.w, qy.w, qz.w);
 
-        }
+  vec3 minbb = vec3(n.min) * (1.0f - low) + vec3(n.max) * low;
+  vec3 maxbb = vec3(n.min) * (1.0f - high) + vec3(n.max) * high;
 
-        if(n.last != -1){
+  return boxTest(minbb, maxbb, r, invdir, closest);
 
-          if(rayTriangleIntersection(r, data[indices[n.last]], hitPoint)){
+}
 
-              if(hitPoint.dist < closest){
-                c = hitPoint;
-                closest = hitPoint.dist;
-                res = true;
-              }
+/* Ray tests of triangles of entered node
+*
+* n - entered node (leaf or radix tree node with triangle children)
+* r - input ray
+* wr - ray prepared by watertightSetup
+* closest - distance of the closest collision
+* hitTriangle - triangle of the closest collision
+* bary - barycentric coordinates of the closest collision
+*
+* return true if found closer collision
+*/
+bool nodeTriangles(Node n, Ray r, WatertightRay wr, inout float closest, inout int hitTriangle, inout vec2 bary){
 
-            }
+  bool res = false;
 
-          }
+  // GPU BVH - triangle children of radix tree node
+  if (nodeFormat == NODES_RADIX_TREE) {
 
-          if(n.first != -1 && n.last != -1)
-            backtrack = true;
+    if (n.first != -1 && triangleTest(indices[n.first], r, wr, closest, hitTriangle, bary))
+      res = true;
 
-        }
+    if (n.last != -1 && triangleTest(indices[n.last], r, wr, closest, hitTriangle, bary))
+      res = true;
 
-        // CPU BVH leaf node
-        else{
+  }
 
-        for(int i = n.first; i <= n.last; i++){
+  // CPU BVH leaf node (optimized GPU BVH - range of triangle indices)
+  else if (n.left == -1 && n.right == -1) {
 
-          if(rayTriangleIntersection(r, data[i], hitPoint)){
+    for (int i = n.first; i <= n.last; i++) {
 
-            if(hitPoint.dist < closest){
-              c = hitPoint;
-              closest = hitPoint.dist;
-              res = true;
-            }
+      if (triangleTest(nodeFormat == NODES_INDEXED_RANGES ? indices[i] : i, r, wr, closest, hitTriangle, bary))
+        res = true;
 
-          }
+    }
 
-        }
+  }
 
-  		  backtrack = true;
-      }
-  	}
+  return res;
 
-    // Inner node
-  	if (n.left != -1 || n.right != -1) {
+}
 
-  		Node lf = tree[n.left];
-  		Node rg = tree[n.right];
+/* Ray BVH traversal - stackless, parent links replace stack (any depth of BVH),
+* same traversal and triangle test as CPUTracer
+*
+* r - input ray
+* c - output collision point
+*
+* return true if found some collision with any primitive, else it returns false
+*/
+bool bvhTraversal(Ray r, out CollisionPoint c){
 
-      float t1, t2;
-  		bool r1 = false, r2 = false;
-      float tq;
+  vec3 invdir = 1.0f / r.direction;
+  WatertightRay wr = watertightSetup(r);
+  float closest = 10000.0;
+  int hitTriangle = -1;
+  vec2 bary;
 
-  		if (n.left != -1) r1 = boxTest(vec3(lf.min), vec3(lf.max), r, tq, t1);
-  		if (n.right != -1) r2 = boxTest(vec3(rg.min), vec3(rg.max), r, tq, t2);
+  heat += 0.001f;
 
-  		if (r1 && r2) {
+  if (!boxTest(vec3(tree[0].min), vec3(tree[0].max), r, invdir, closest))
+    return false;
 
-  			if (t1 <= t2) {
-  				top = n.left;
-  				lstack = (lstack | 1) << 1;
-  				rstack <<= 1;
-  			}
-  			else {
-  				top = n.right;
-  				rstack = (rstack | 1) << 1;
-  				lstack <<= 1;
-  			}
+  // Child, from which traversal returned to current node (-1 - current node is entered)
+  int current = 0;
+  int from = -1;
 
-  		}
+  // Traversal loop
+  while (true) {
 
-  		else if (r1) {
-  			top = n.left;
-  			lstack <<= 1;
-  			rstack <<= 1;
-  		}
+    Node n = tree[current];
 
-  		else if (r2) {
-  			top = n.right;
-  			lstack <<= 1;
-  			rstack <<= 1;
-  		}
+    heat += 0.001f;
 
-  		else {
-  			backtrack = true;
-  		}
+    // Order of children by split axis (the only child is near)
+    int nearChild = n.left;
+    int farChild = n.right;
 
-  	}
+    if (n.axis >= 0 && r.direction[n.axis] < 0.0f) {
+      nearChild = n.right;
+      farChild = n.left;
+    }
 
-    // Backtrack in BVH structure
-  	if (backtrack) {
+    if (nearChild == -1) {
+      nearChild = farChild;
+      farChild = -1;
+    }
 
-  		bool f = false;
+    if (from == -1) {
 
-  		while (lstack != 0 || rstack != 0) {
-  			n = tree[top];
+      nodeTriangles(n, r, wr, closest, hitTriangle, bary);
 
-        if ((lstack & 1) != 0) {
-  				// visit right node
-  				top = n.right;
-  				lstack &= ~1;
-  				lstack <<= 1;
-  				rstack <<= 1;
-  				f = true;
-  				break;
-  			}
+      if (nearChild != -1 && childTest(n, nearChild, r, invdir, closest)) {
+        current = nearChild;
+        continue;
+      }
 
-  			else if ((rstack & 1) != 0) {
-  				// visit left node
-  				top = n.left;
-  				rstack &= ~1;
-  				lstack <<= 1;
-  				rstack <<= 1;
-  				f = true;
-  				break;
-  			}
+      if (farChild != -1 && childTest(n, farChild, r, invdir, closest)) {
+        current = farChild;
+        continue;
+      }
 
-  			top = n.parent;
-  			lstack >>= 1;
-  			rstack >>= 1;
+    }
 
-  		}
+    // Far child is tested again after subtree of near child (with the closer collision)
+    else if (from == nearChild && farChild != -1 && childTest(n, farChild, r, invdir, closest)) {
+      current = farChild;
+      from = -1;
+      continue;
+    }
 
-  		if (!f)
-        break;
+    // Subtree of node is finished
+    if (current == 0)
+      break;
 
-  	}
+    from = current;
+    current = n.parent;
 
   }
 
-  return res;
+  // Shading data are read only for the closest collision
+  if (hitTriangle == -1)
+    return false;
+
+  shadeCollision(r, data[hitTriangle], closest, bary, c);
+
+  return true;
 
 }
 
@@ -0,0 +1,209 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* AllocationCounter.cpp
+*/
+
+#include <AllocationCounter.h>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> AllocationCounter::allocations{ 0 };
+std::atomic<size_t> AllocationCounter::allocated{ 0 };
+std::atomic<size_t> AllocationCounter::peak{ 0 };
+std::atomic<size_t> AllocationCounter::subsystemBytes[SUBSYSTEM_COUNT] = {};
+std::atomic<size_t> AllocationCounter::subsystemPeak[SUBSYSTEM_COUNT] = {};
+std::atomic<size_t> AllocationCounter::gpuSubsystemBytes[SUBSYSTEM_COUNT] = {};
+std::atomic<size_t> AllocationCounter::gpuSubsystemPeak[SUBSYSTEM_COUNT] = {};
+
+namespace {
+
+	// Tag of calling thread (trivial type, access does not allocate)
+	thread_local AllocationCounter::subsystem threadTag = AllocationCounter::OTHER;
+
+}
+
+#ifdef RT_COUNT_ALLOCATIONS
+
+// Size and subsystem of block are stored in front of it (header keeps maximal alignment)
+#define ALLOCATION_HEADER alignof(std::max_align_t)
+
+static_assert(ALLOCATION_HEADER >= sizeof(std::size_t) + 1, "Allocation header is too small");
+
+// Global allocation functions (array and sized versions forward to these)
+void* operator new(std::size_t size){
+
+	AllocationCounter::add();
+
+	char* p = static_cast<char*>(std::malloc(size + ALLOCATION_HEADER));
+
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	AllocationCounter::subsystem s = AllocationCounter::current();
+
+	*reinterpret_cast<std::size_t*>(p) = size;
+	p[sizeof(std::size_t)] = static_cast<char>(s);
+	AllocationCounter::addBytes(static_cast<std::ptrdiff_t>(size), s);
+
+	return p + ALLOCATION_HEADER;
+}
+
+void operator delete(void* p) noexcept{
+
+	if (p == nullptr)
+		return;
+
+	char* block = static_cast<char*>(p) - ALLOCATION_HEADER;
+	AllocationCounter::addBytes(-static_cast<std::ptrdiff_t>(*reinterpret_cast<std::size_t*>(block)), static_cast<AllocationCounter::subsystem>(block[sizeof(std::size_t)]));
+
+	std::free(block);
+}
+
+#endif // RT_COUNT_ALLOCATIONS
+
+size_t AllocationCounter::count(){
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::add(){
+	allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::bytes(){
+	return allocated.load(std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::peakBytes(){
+	return peak.load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::resetPeak(){
+
+	peak.store(allocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	for (unsigned s = 0; s < SUBSYSTEM_COUNT; s++) {
+		subsystemPeak[s].store(subsystemBytes[s].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		gpuSubsystemPeak[s].store(gpuSubsystemBytes[s].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+}
+
+void AllocationCounter::addBytes(std::ptrdiff_t size, subsystem s){
+
+	raise(peak, allocated.fetch_add(static_cast<size_t>(size), std::memory_order_relaxed) + static_cast<size_t>(size));
+	raise(subsystemPeak[s], subsystemBytes[s].fetch_add(static_cast<size_t>(size), std::memory_order_relaxed) + static_cast<size_t>(size));
+
+}
+
+AllocationCounter::subsystem AllocationCounter::current(){
+	return threadTag;
+}
+
+size_t AllocationCounter::bytes(subsystem s){
+	return subsystemBytes[s].load(std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::peakBytes(subsystem s){
+	return subsystemPeak[s].load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::addGpuBytes(subsystem s, std::ptrdiff_t size){
+	raise(gpuSubsystemPeak[s], gpuSubsystemBytes[s].fetch_add(static_cast<size_t>(size), std::memory_order_relaxed) + static_cast<size_t>(size));
+}
+
+size_t AllocationCounter::gpuBytes(subsystem s){
+	return gpuSubsystemBytes[s].load(std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::gpuPeakBytes(subsystem s){
+	return gpuSubsystemPeak[s].load(std::memory_order_relaxed);
+}
+
+const char * AllocationCounter::getName(subsystem s){
+
+	switch (s) {
+	case OTHER: return "Other";
+	case LOADER: return "Loader";
+	case SCENE: return "Scene";
+	case BVH: return "BVH";
+	case PREPROCESSOR: return "Preprocessor";
+	case RENDERER: return "Renderer";
+	case TEXTURES: return "Textures";
+	default: return "";
+	}
+
+}
+
+void AllocationCounter::writeReport(std::ostream & output){
+
+	const double megabyte = 1024.0 * 1024.0;
+
+	// Format of stream is restored (stream is usually std::cout)
+	std::ios::fmtflags flags = output.flags();
+	std::streamsize precision = output.precision();
+
+	output << "Memory (MB)        heap   heap peak   gpu   gpu peak" << (count() == 0 ? " (heap counting disabled)" : "") << std::endl;
+
+	for (unsigned s = 0; s < SUBSYSTEM_COUNT; s++) {
+		subsystem sub = static_cast<subsystem>(s);
+		output << std::left << std::setw(14) << getName(sub) << std::right << std::fixed << std::setprecision(1)
+			   << std::setw(10) << bytes(sub) / megabyte << std::setw(12) << peakBytes(sub) / megabyte
+			   << std::setw(8) << gpuBytes(sub) / megabyte << std::setw(11) << gpuPeakBytes(sub) / megabyte << std::endl;
+	}
+
+	output.flags(flags);
+	output.precision(precision);
+
+}
+
+void AllocationCounter::raise(std::atomic<size_t>& target, size_t value){
+
+	size_t highest = target.load(std::memory_order_relaxed);
+
+	// Peak is raised only by the thread, which has seen the higher value
+	while (value > highest && !target.compare_exchange_weak(highest, value, std::memory_order_relaxed));
+
+}
+
+void AllocationCounter::begin(){
+	start = count();
+}
+
+size_t AllocationCounter::end(){
+
+	size_t frame = count() - start;
+
+	// Steady state frame has to be allocation free
+	if (frames >= ALLOCATION_WARMUP_FRAMES && frame > 0) {
+		std::cout << "Frame allocated " << frame << " times" << std::endl;
+		allocatingFrames++;
+	}
+
+	frames++;
+
+	return frame;
+}
+
+void AllocationCounter::reset(){
+	frames = 0;
+}
+
+unsigned AllocationCounter::getAllocatingFrames(){
+	return allocatingFrames;
+}
+
+AllocationCounter::tag::tag(subsystem s) : previous(threadTag){
+	threadTag = s;
+}
+
+AllocationCounter::tag::~tag(){
+	threadTag = previous;
+}
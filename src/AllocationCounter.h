@@ -0,0 +1,201 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* AllocationCounter.h
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+// Counting of heap allocations (global operator new is replaced), disabled in release builds
+//#define RT_COUNT_ALLOCATIONS
+
+// Number of frames after reset, which can allocate (buffers of renderer grow to steady state)
+#define ALLOCATION_WARMUP_FRAMES 10
+
+/**
+* @brief Instrumentation of heap allocations, reports frames which allocate in steady state
+* @note Without RT_COUNT_ALLOCATIONS all calls are empty, GPU memory is accounted explicitly (always)
+*/
+class AllocationCounter {
+
+public:
+
+	/**
+	* @brief Subsystems of memory accounting (heap allocations are tagged by scope of calling thread)
+	*/
+	typedef enum {
+		OTHER,			// Untagged allocations
+		LOADER,			// Assimp and scene generator (scene graph)
+		SCENE,			// Attributes, triangles and materials of Scene, clusters
+		BVH,			// BVH builders (nodes, centers, GPU build buffers)
+		PREPROCESSOR,	// Flattening of CPU BVH
+		RENDERER,		// Renderer buffers
+		TEXTURES,		// Decoded textures and GPU textures
+		SUBSYSTEM_COUNT
+	} subsystem;
+
+	/**
+	* @brief Scoped tag - heap allocations of calling thread are accounted to subsystem until end of scope
+	*/
+	class tag {
+
+	public:
+
+		/**
+		* @brief Sets tag of calling thread
+		* @param s Subsystem
+		*/
+		tag(subsystem s);
+
+		/**
+		* @brief Restores previous tag
+		*/
+		~tag();
+
+	private:
+
+		subsystem previous;
+
+	};
+
+	/**
+	* @brief Getter for number of allocations since start of application
+	* @return Number of calls of operator new (0 if counting is disabled)
+	*/
+	static size_t count();
+
+	/**
+	* @brief Increments number of allocations (called by replaced operator new)
+	*/
+	static void add();
+
+	/**
+	* @brief Getter for size of allocated memory
+	* @return Number of bytes currently allocated by operator new (0 if counting is disabled)
+	*/
+	static size_t bytes();
+
+	/**
+	* @brief Getter for peak of allocated memory since last resetPeak call
+	* @return Number of bytes (0 if counting is disabled)
+	*/
+	static size_t peakBytes();
+
+	/**
+	* @brief Starts new measurement of peak memory from currently allocated size (all subsystems)
+	*/
+	static void resetPeak();
+
+	/**
+	* @brief Updates allocated size (called by replaced operator new and delete)
+	* @param size Size of allocated (positive) or freed (negative) block
+	* @param s Subsystem, which allocated block
+	*/
+	static void addBytes(std::ptrdiff_t size, subsystem s = OTHER);
+
+	/**
+	* @brief Getter for tag of calling thread
+	* @return Subsystem of new allocations
+	*/
+	static subsystem current();
+
+	/**
+	* @brief Getter for heap memory of subsystem
+	* @param s Subsystem
+	* @return Number of bytes currently allocated (0 if counting is disabled)
+	*/
+	static size_t bytes(subsystem s);
+
+	/**
+	* @brief Getter for peak of heap memory of subsystem since last resetPeak call
+	* @param s Subsystem
+	* @return Number of bytes (0 if counting is disabled)
+	*/
+	static size_t peakBytes(subsystem s);
+
+	/**
+	* @brief Updates GPU memory of subsystem (buffers and textures are accounted by their owners)
+	* @param s Subsystem
+	* @param size Size of created (positive) or deleted (negative) object
+	*/
+	static void addGpuBytes(subsystem s, std::ptrdiff_t size);
+
+	/**
+	* @brief Getter for GPU memory of subsystem
+	* @param s Subsystem
+	* @return Number of bytes
+	*/
+	static size_t gpuBytes(subsystem s);
+
+	/**
+	* @brief Getter for peak of GPU memory of subsystem since last resetPeak call
+	* @param s Subsystem
+	* @return Number of bytes
+	*/
+	static size_t gpuPeakBytes(subsystem s);
+
+	/**
+	* @brief Getter for name of subsystem
+	* @param s Subsystem
+	* @return Name used in reports
+	*/
+	static const char* getName(subsystem s);
+
+	/**
+	* @brief Writes current and peak memory of all subsystems (one line per subsystem)
+	* @param output Output stream
+	*/
+	static void writeReport(std::ostream& output);
+
+	/**
+	* @brief Starts measured part of frame
+	*/
+	void begin();
+
+	/**
+	* @brief Ends measured part of frame, allocations in steady state are reported
+	* @return Number of allocations since begin call
+	*/
+	size_t end();
+
+	/**
+	* @brief Starts new warm-up (e.g. after scene change)
+	*/
+	void reset();
+
+	/**
+	* @brief Getter for number of steady state frames, which allocated (warm-ups are not counted)
+	* @return Number of reported frames since construction (0 if counting is disabled)
+	*/
+	unsigned getAllocatingFrames();
+
+private:
+
+	/**
+	* @brief Raises peak to value (peaks are updated by several threads)
+	*/
+	static void raise(std::atomic<size_t>& target, size_t value);
+
+	static std::atomic<size_t> allocations;
+	static std::atomic<size_t> allocated;
+	static std::atomic<size_t> peak;
+
+	// Per subsystem accounting (peaks of subsystems are independent, they need not be simultaneous)
+	static std::atomic<size_t> subsystemBytes[SUBSYSTEM_COUNT];
+	static std::atomic<size_t> subsystemPeak[SUBSYSTEM_COUNT];
+	static std::atomic<size_t> gpuSubsystemBytes[SUBSYSTEM_COUNT];
+	static std::atomic<size_t> gpuSubsystemPeak[SUBSYSTEM_COUNT];
+
+	size_t start = 0;
+	unsigned frames = 0;
+	unsigned allocatingFrames = 0;
+
+};
@@ -13,20 +13,42 @@
 #include <memory>
 #include <string>
 #include <iostream>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <algorithm>
 
 #include <Window.h>
 #include <UserInterface.h>
 #include <Renderer.h>
+#include <AllocationCounter.h>
+#include <JobFile.h>
+#include <CameraPath.h>
+#include <FrameStats.h>
+#include <BVHMetrics.h>
+#include <SceneGenerator.h>
+#include <bvhPreprocessor.h>
+#include <Profiler.h>
+#include <ThreadPool.h>
 
 #include <BVH.h>
 #include <geSG/AABB.h>
 #include <AABB_SAH_BVH.h>
 #include <RadixTree_BVH.h>
+#include <PLOC_BVH.h>
+
+#include <3rd_party/image/stb_image_write.h>
 
 #define APP_DEFAULT_WIDTH 1200
 #define APP_DEFAULT_HEIGHT 800
 #define APP_DEFAULT_TITLE "windowTitle"
 
+// Per-frame timing of last replay of camera path
+#define APP_REPLAY_REPORT "replay_report.csv"
+
 /**
 * @brief Base app class, maintains application attributes
 */
@@ -39,49 +61,139 @@ public:
 	* @param width Width of app window (in pixels)
 	* @param height Height of app window (in pixels)
 	* @param title Title string of window
+	* @param headless true for batch rendering (window is hidden)
 	*/
-	App(unsigned width = APP_DEFAULT_WIDTH, unsigned height = APP_DEFAULT_HEIGHT, std::string title = APP_DEFAULT_TITLE);
+	App(unsigned width = APP_DEFAULT_WIDTH, unsigned height = APP_DEFAULT_HEIGHT, std::string title = APP_DEFAULT_TITLE, bool headless = false);
 
 	/**
 	* @brief initialization of application objects and attributes
 	* @param width Width of app window (in pixels)
 	* @param height Height of app window (in pixels)
 	* @param title Title string of window
+	* @param headless true for batch rendering (window is hidden)
 	*/
-	void init(unsigned width, unsigned height, std::string title);
+	void init(unsigned width, unsigned height, std::string title, bool headless);
 	
 	/**
 	* @brief runs actual application
 	*/
 	void run();
 
+	/**
+	* @brief Renders jobs of job file without user interface, writes images and timing report
+	* @param jobFile Path to job file
+	* @param reportFile Path to timing report (CSV)
+	* @param validateSort true if GPU radix sort of every GPU BVH build is compared with sort on CPU
+	* @return true if all jobs were rendered (and all validated sorts match)
+	*/
+	bool runBatch(std::string jobFile, std::string reportFile, bool validateSort = false);
+
+	/**
+	* @brief Loads scene and BVH and waits until they are uploaded (batch rendering)
+	* @param file path to file with scene data
+	* @param bvhType Type of BVH (BVH_TYPE_SAH, BVH_TYPE_GPU or BVH_TYPE_PLOC)
+	* @return true if success
+	*/
+	bool loadScene(std::string file, int bvhType);
+
+	/**
+	* @brief Starts and stops recording and replay of camera path, sets view of replayed frame
+	*/
+	void updateCameraPath();
+
+	/**
+	* @brief Renders one frame and waits until it is finished on GPU
+	* @return Timing of frame
+	*/
+	FrameStats::frame renderTimed();
+
+	/**
+	* @brief Starts loading of scene selected in UI (new scene and BVH set is created)
+	*/
+	void startLoading();
+
+	/**
+	* @brief Loads new scene and builds CPU BVH (runs in loading thread)
+	* @param file path to file with scene data
+	* @param bvhType Type of BVH (BVH_TYPE_SAH, BVH_TYPE_GPU or BVH_TYPE_PLOC)
+	* @return true if success
+	*/
+	bool loadNextScene(std::string file, int bvhType);
+
+	/**
+	* @brief Checks state of loading, starts upload of loaded scene and swaps scenes after upload
+	*/
+	void updateLoading();
+
+	/**
+	* @brief Computes quality metrics of CPU BVH and writes them into report file (runs in loading thread)
+	* @param root Root of built BVH
+	* @param indices Vertex indices of triangles in order of leaves (3 per triangle)
+	* @param name Name of BVH builder
+	*/
+	void measureCPUBVH(ge::sg::BVH_Node<ge::sg::AABB>* root, const std::vector<unsigned>& indices, std::string name);
+
+	/**
+	* @brief Reads GPU BVH back, computes its quality metrics and writes them into report file
+	*/
+	void measureGPUBVH();
+
 	// Application attributes
 	std::shared_ptr<Window> win;
 	std::shared_ptr<UserInterface> ui;
 	std::shared_ptr<Renderer> ren;
 	std::shared_ptr<UserInterface::uiData> ui_data;
 	std::shared_ptr<Scene> scene;
+	std::shared_ptr<ThreadPool> workers;	// Worker threads shared by builds of acceleration structures
 	
 	// Acceleration structures
 	std::shared_ptr<ge::sg::BVH<ge::sg::AABB_SAH_BVH>> sah_bvh;
 	std::shared_ptr<ge::sg::BVH<ge::sg::RadixTree_BVH>> gpu_bvh;
-	std::shared_ptr<float> tmp;
+	std::shared_ptr<ge::sg::BVH<ge::sg::PLOC_BVH>> ploc_bvh;
+
+	// Scene and acceleration structures, which are being loaded (builders are swapped with current ones, their buffers and kernels are reused)
+	std::shared_ptr<Scene> nextScene;
+	std::shared_ptr<ge::sg::BVH<ge::sg::AABB_SAH_BVH>> nextSahBvh;
+	std::shared_ptr<ge::sg::BVH<ge::sg::RadixTree_BVH>> nextGpuBvh;
+	std::shared_ptr<ge::sg::BVH<ge::sg::PLOC_BVH>> nextPlocBvh;
+
+	// State of loading
+	std::future<bool> loading;
+	std::atomic<float> loadProgress{ 0.0f };
+	bool uploading = false;
+	int nextBvhType = 0;
+	bool nextOutOfCore = false;
+	bool nextMetrics = false;
+	std::shared_ptr<BVHMetrics::report> nextBvhReport;
 
 	bool initScene = false;
+
+	// Instrumentation of allocations in rendered frames
+	AllocationCounter frameAllocations;
+
+	// Recording and replay of camera path
+	CameraPath cameraPath;
+	FrameStats replayStats;
+	size_t replayFrame = 0;
+	bool recording = false;
+	bool replaying = false;
 	
 };
 
 template<typename RenderTech>
-inline App<RenderTech>::App(unsigned width, unsigned height, std::string title){
+inline App<RenderTech>::App(unsigned width, unsigned height, std::string title, bool headless){
 
-	init(width, height, title);
+	init(width, height, title, headless);
 
 }
 
 template<typename RenderTech>
-inline void App<RenderTech>::init(unsigned width, unsigned height, std::string title){
+inline void App<RenderTech>::init(unsigned width, unsigned height, std::string title, bool headless){
+
+	Profiler::setThreadName("Main");
 
 	win = std::make_shared<Window>(width, height, title);
+	win->setHeadless(headless);
 	win->showWindow();
 
 	ui_data = std::make_shared<UserInterface::uiData>();
@@ -94,12 +206,18 @@ inline void App<RenderTech>::init(unsigned width, unsigned height, std::string t
 	ren->init();
 
 	scene = std::make_shared<Scene>();
+	workers = std::make_shared<ThreadPool>();
 
 	sah_bvh = std::make_shared<ge::sg::BVH<ge::sg::AABB_SAH_BVH>>();
 	gpu_bvh = std::make_shared<ge::sg::BVH<ge::sg::RadixTree_BVH>>();
+	ploc_bvh = std::make_shared<ge::sg::BVH<ge::sg::PLOC_BVH>>();
 
-	
-	tmp = std::make_shared<float>();
+	nextSahBvh = std::make_shared<ge::sg::BVH<ge::sg::AABB_SAH_BVH>>();
+	nextGpuBvh = std::make_shared<ge::sg::BVH<ge::sg::RadixTree_BVH>>();
+	nextPlocBvh = std::make_shared<ge::sg::BVH<ge::sg::PLOC_BVH>>();
+
+	gpu_bvh->setThreadPool(workers);
+	nextGpuBvh->setThreadPool(workers);
 
 }
 
@@ -107,48 +225,526 @@ template<typename RenderTech>
 inline void App<RenderTech>::run(){
 
 	while (!win->isClosed()) {
+
+		Profiler::nextFrame();
+		PROFILE_ZONE("Frame");
 		
-		// Load new scene
-		if (ui_data->changeNotify) {
-			initScene = true;
+		// Load new scene (next request waits until current loading is finished)
+		if (ui_data->changeNotify && !loading.valid() && !uploading) {
 			ui_data->changeNotify = false;
+			startLoading();
+		}
+
+		updateLoading();
+
+		// Stream textures of current scene
+		if (initScene && scene->updateTextures())
+			ren->updateMaterials(*scene.get());
+
+		// Loading thread allocates concurrently, steady state starts after loading
+		if (loading.valid() || uploading)
+			frameAllocations.reset();
+
+		updateCameraPath();
+
+		// Render new screen (without allocations in steady state)
+		FrameStats::frame timing;
+
+		frameAllocations.begin();
+		if (replaying) timing = renderTimed();
+		else if(initScene) ren->render();
+		frameAllocations.end();
+
+		if (replaying)
+			replayStats.add(timing);
+
+		if (recording && initScene)
+			cameraPath.record(ren->getView());
+
+		{
+			PROFILE_ZONE("GUI");
+			ui->renderGUI();
+		}
+
+		{
+			PROFILE_ZONE("Swap buffers");
+			win->swapBuffers();
+		}
+
+		// GPU times of older frames (never waits for GPU)
+		ui_data->gpuTimer->nextFrame();
+	}
+
+	// Loading thread uses objects of app
+	if (loading.valid())
+		loading.wait();
+
+}
 
-			scene->loadScene(ui_data->sceneFile, ui_data->bvhType);
-			
-			// CPU BVH usage
-			if (!ui_data->bvhType) {
-
-				sah_bvh->setGeometryData(*((scene->getSceneMesh()).get()));
-				sah_bvh->setDepth(35);
-				//sah_bvh->setMinimumPrimitivesInNode(25);
-				sah_bvh->setMinimumPrimitivesInNode(25);
-				sah_bvh->buildBVH();
-				
-				ren->setupCPUBVH(sah_bvh);
-					
-				scene->prepareScene();
+template<typename RenderTech>
+inline bool App<RenderTech>::runBatch(std::string jobFile, std::string reportFile, bool validateSort){
+
+	std::vector<JobFile::job> jobs;
+
+	if (!JobFile::load(jobFile, jobs))
+		return false;
+
+	std::ofstream report(reportFile);
+
+	if (!report.is_open()) {
+		std::cout << "Report " << reportFile << " cannot be created" << std::endl;
+		return false;
+	}
+
+	report << "job,scene,bvh,width,height,frames,load_ms,mean_ms,p50_ms,p95_ms,p99_ms,min_ms,max_ms,rays_per_second" << std::endl;
+
+	// View is given by jobs only
+	ren->setInputControl(false);
+	ui_data->sortValidation = validateSort;
+
+	std::string loadedScene;
+	int loadedBvh = -1;
+	bool success = true;
+
+	FrameStats stats;
+	CameraPath path;
+	std::vector<unsigned char> pixels;
+
+	for (size_t i = 0; i < jobs.size(); i++) {
+
+		JobFile::job& job = jobs[i];
+		double loadTime = 0.0;
+
+		// Scene and BVH of previous job are reused
+		if (job.scene != loadedScene || job.bvhType != loadedBvh) {
+
+			auto start = std::chrono::high_resolution_clock::now();
+
+			if (!loadScene(job.scene, job.bvhType)) {
+				std::cout << "Job " << i << " skipped, scene " << job.scene << " cannot be loaded" << std::endl;
+				loadedScene.clear();
+				success = false;
+				continue;
+			}
+
+			loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			loadedScene = job.scene;
+			loadedBvh = job.bvhType;
+
+			if (job.bvhType == BVH_TYPE_GPU && !gpu_bvh->isSortValid()) {
+				std::cout << "Job " << i << " radix sort on GPU differs from sort on CPU" << std::endl;
+				success = false;
+			}
+
+			// Peaks of loading and build, frames of job are measured separately
+			std::cout << "Job " << i << " loaded, memory" << std::endl;
+			AllocationCounter::writeReport(std::cout);
+			AllocationCounter::resetPeak();
+		}
+
+		win->setSize(job.width, job.height);
+		ui_data->shadowSamples = job.shadowSamples;
+		ui_data->indirectSamples = job.indirectSamples;
+		ui_data->aoSamples = job.aoSamples;
+		ren->setView(job.view);
+
+		// Recorded camera path gives view of every frame
+		if (!job.path.empty()) {
+
+			if (!path.load(job.path)) {
+				success = false;
+				continue;
 			}
-			
-			// GPU BVH usage
-			else {
-				
-				tmp.reset(scene->getPositionsVector().data());
 
-				gpu_bvh->setGeometryData(tmp, scene->getPositionsVector().size());
-				gpu_bvh->buildBVH();
-				
-				ren->setupGPUBVH(gpu_bvh);
+			job.frames = static_cast<unsigned>(path.size());
+		}
+
+		stats.reset(FrameStats::rays(win->getWidth(), win->getHeight(), job.shadowSamples, job.indirectSamples, job.aoSamples), job.frames);
+
+		// Buffers grow with resolution of job, frames after warm-up must not allocate
+		frameAllocations.reset();
+		unsigned allocatingFrames = frameAllocations.getAllocatingFrames();
+
+		for (unsigned f = 0; f < job.frames; f++) {
+
+			if (!job.path.empty())
+				ren->setView(path.get(f));
+
+			// Frames are rendered back to back, time includes whole frame on GPU
+			Profiler::nextFrame();
+			frameAllocations.begin();
+			FrameStats::frame timing = renderTimed();
+			frameAllocations.end();
+
+			stats.add(timing);
+
+			ui_data->gpuTimer->nextFrame();
+
+			ren->getImage(pixels);
+			stbi_flip_vertically_on_write(true);
+			std::string image = JobFile::framePath(job, f);
+
+			if (!stbi_write_png(image.c_str(), win->getWidth(), win->getHeight(), 4, pixels.data(), 0)) {
+				std::cout << "Image " << image << " cannot be written" << std::endl;
+				success = false;
+			}
+		}
+
+		FrameStats::summary s = stats.compute();
+
+		report << i << "," << job.scene << "," << job.bvhType << "," << win->getWidth() << "," << win->getHeight() << "," << job.frames << "," << loadTime << ","
+			<< s.mean << "," << s.p50 << "," << s.p95 << "," << s.p99 << "," << s.min << "," << s.max << "," << s.raysPerSecond << std::endl;
+
+		std::cout << "Job " << i << " finished, ";
+		stats.print();
+		AllocationCounter::writeReport(std::cout);
+
+		// Only with RT_COUNT_ALLOCATIONS (counter is empty otherwise)
+		if (frameAllocations.getAllocatingFrames() != allocatingFrames) {
+			std::cout << "Job " << i << " allocated in " << frameAllocations.getAllocatingFrames() - allocatingFrames << " steady state frames" << std::endl;
+			success = false;
+		}
+	}
+
+	// Zones of loading, builds and frames of all jobs
+	Profiler::writeTrace(PROFILER_TRACE_FILE);
+
+	return success;
+}
+
+template<typename RenderTech>
+inline bool App<RenderTech>::loadScene(std::string file, int bvhType){
+
+	auto previous = scene;
+
+	ui_data->sceneFile = file;
+	ui_data->bvhType = bvhType;
+	ui_data->outOfCore = false;
+
+	startLoading();
+
+	// Loading thread and upload steps
+	while (loading.valid() || uploading) {
+		updateLoading();
+		std::this_thread::yield();
+	}
+
+	// Failed loading keeps previous scene
+	if (scene == previous)
+		return false;
+
+	// All textures are resident before rendering
+	while (!scene->texturesLoaded()) {
+		if (scene->updateTextures())
+			ren->updateMaterials(*scene.get());
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	if (scene->updateTextures())
+		ren->updateMaterials(*scene.get());
+
+	return true;
+}
+
+template<typename RenderTech>
+inline void App<RenderTech>::updateCameraPath(){
+
+	// Start and end of recording
+	if (ui_data->recordPath != recording) {
+
+		recording = ui_data->recordPath;
+
+		if (recording)
+			cameraPath.clear();
+		else if (cameraPath.save(CAMERA_PATH_FILE))
+			std::cout << "Camera path saved (" << cameraPath.size() << " frames)" << std::endl;
+	}
+
+	// Start of replay (view of every frame is given by path, input is ignored)
+	if (ui_data->replayPath && !replaying) {
+
+		ui_data->replayPath = false;
+
+		if (initScene && !recording && cameraPath.load(CAMERA_PATH_FILE) && cameraPath.size() > 0) {
+			replaying = true;
+			replayFrame = 0;
+			ren->setInputControl(false);
+			replayStats.reset(FrameStats::rays(win->getWidth(), win->getHeight(), ui_data->shadowSamples, ui_data->indirectSamples, ui_data->aoSamples), cameraPath.size());
+		}
+	}
+
+	if (!replaying)
+		return;
+
+	// End of replay
+	if (replayFrame == cameraPath.size()) {
+		replaying = false;
+		ren->setInputControl(true);
+
+		std::cout << "Replay finished, ";
+		replayStats.print();
+		replayStats.write(APP_REPLAY_REPORT);
+		return;
+	}
+
+	ren->setView(cameraPath.get(replayFrame++));
+
+}
+
+template<typename RenderTech>
+inline FrameStats::frame App<RenderTech>::renderTimed(){
+
+	auto start = std::chrono::high_resolution_clock::now();
+	ren->render();
+	auto submitted = std::chrono::high_resolution_clock::now();
+
+	// Whole frame on GPU
+	ge::gl::glFinish();
+	auto finished = std::chrono::high_resolution_clock::now();
+
+	return { std::chrono::duration<double, std::milli>(submitted - start).count(), std::chrono::duration<double, std::milli>(finished - start).count() };
+}
+
+template<typename RenderTech>
+inline void App<RenderTech>::startLoading(){
+
+	// GL objects of new scene are created in main thread, builders of previous scene are reused
+	nextScene = std::make_shared<Scene>();
+	nextGpuBvh->setMortonCodeBits(ui_data->mortonCode64 ? MORTON_CODE_BITS_64 : MORTON_CODE_BITS);
+	nextGpuBvh->setTreeletOptimization(ui_data->treeletOptimization);
+	nextGpuBvh->setTimer(ui_data->gpuTimer);
+	nextGpuBvh->setSortValidation(ui_data->sortValidation);
+	nextBvhType = ui_data->bvhType;
+	SceneGenerator::distribution generated;
+	size_t generatedTriangles;
+
+	// Generated scenes are always in memory
+	nextOutOfCore = ui_data->outOfCore && !SceneGenerator::parse(ui_data->sceneFile, generated, generatedTriangles);
+	nextMetrics = ui_data->bvhMetrics;
+	nextBvhReport.reset();
+
+	loadProgress = 0.0f;
+	ui_data->loading = true;
+	ui_data->loadProgress = 0.0f;
+
+	loading = std::async(std::launch::async, &App<RenderTech>::loadNextScene, this, ui_data->sceneFile, nextBvhType);
+
+}
+
+template<typename RenderTech>
+inline bool App<RenderTech>::loadNextScene(std::string file, int bvhType){
+
+	Profiler::setThreadName("Loading");
+	PROFILE_ZONE("Load scene");
+
+	// Out-of-core scene - BVH over clusters is built during partitioning
+	if (nextOutOfCore) {
+		size_t megabyte = 1024 * 1024;
+		bool loaded = nextScene->loadClustered(file, ui_data->memoryBudget * megabyte, ui_data->gpuBudget * megabyte);
+		loadProgress = 0.9f;
+		return loaded;
+	}
+
+	SceneGenerator::distribution generated;
+	size_t generatedTriangles;
+
+	// Procedural scene (generated:<distribution>:<triangles>) or scene file
+	{
+		PROFILE_ZONE("Read scene");
+
+		if (SceneGenerator::parse(file, generated, generatedTriangles)) {
+			if (!nextScene->loadGenerated(generated, generatedTriangles))
+				return false;
+		}
+		else if (!nextScene->loadScene(file))
+			return false;
+	}
+
+	loadProgress = 0.5f;
+
+	// CPU BVH usage
+	if (bvhType == BVH_TYPE_SAH) {
+
+		AllocationCounter::tag memoryTag(AllocationCounter::BVH);
+
+		nextSahBvh->setGeometryData(nextScene->getGeometryView());
+		nextSahBvh->setDepth(35);
+		//sah_bvh->setMinimumPrimitivesInNode(25);
+		nextSahBvh->setMinimumPrimitivesInNode(25);
+		nextSahBvh->buildBVH();
+
+		if (nextMetrics)
+			measureCPUBVH(nextSahBvh->getRoot().get(), nextSahBvh->getPrimitiveIndices(), "AABB_SAH_BVH");
+
+		loadProgress = 0.75f;
+
+		ren->setupCPUBVH(nextSahBvh);
+
+		// Triangles in order of BVH leaves
+		PROFILE_ZONE("Prepare scene");
+		nextScene->prepareScene(nextSahBvh->getPrimitiveIndices());
+	}
+
+	// CPU BVH built by clustering
+	else if (bvhType == BVH_TYPE_PLOC) {
 
+		AllocationCounter::tag memoryTag(AllocationCounter::BVH);
+
+		nextPlocBvh->setGeometryData(nextScene->getGeometryView());
+		nextPlocBvh->setMinimumPrimitivesInNode(4);
+		nextPlocBvh->buildBVH();
+
+		if (nextMetrics)
+			measureCPUBVH(nextPlocBvh->getRoot().get(), nextPlocBvh->getPrimitiveIndices(), "PLOC_BVH");
+
+		loadProgress = 0.75f;
+
+		ren->setupCPUBVH(nextPlocBvh);
+
+		// Triangles in order of BVH leaves
+		PROFILE_ZONE("Prepare scene");
+		nextScene->prepareScene(nextPlocBvh->getPrimitiveIndices());
+	}
+
+	// GPU BVH references triangles in order of loading
+	else {
+		PROFILE_ZONE("Prepare scene");
+		nextScene->prepareScene(nextScene->getIndices());
+	}
+
+	loadProgress = 0.9f;
+
+	return true;
+}
+
+template<typename RenderTech>
+inline void App<RenderTech>::updateLoading(){
+
+	// Loading thread is running
+	if (loading.valid()) {
+
+		if (loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			ui_data->loadProgress = std::max(loadProgress.load(), 0.5f * nextScene->getLoadProgress());
+			return;
+		}
+
+		if (!loading.get()) {
+			std::cout << "Scene " << ui_data->sceneFile << " loading failed" << std::endl;
+			nextScene.reset();
+			ui_data->loading = false;
+			return;
+		}
+
+		// Out-of-core scene
+		if (nextOutOfCore)
+			ren->setupClusters(nextScene->getClusters());
+
+		// GPU BVH usage (build runs on GPU, it needs GL context of main thread)
+		else if (nextBvhType == BVH_TYPE_GPU) {
+
+			PROFILE_ZONE("GPU BVH build");
+			AllocationCounter::tag memoryTag(AllocationCounter::BVH);
+
+			nextGpuBvh->setGeometryData(nextScene->getGeometryView());
+			nextGpuBvh->buildBVH();
+
+			// Previous scene is kept
+			if (!nextGpuBvh->isBuilt()) {
+				std::cout << "Scene " << ui_data->sceneFile << " loading failed" << std::endl;
+				nextScene.reset();
+				ui_data->loading = false;
+				return;
 			}
 
-			ren->updateScene(*scene.get());
-				
+			if (nextMetrics)
+				measureGPUBVH();
+
+			ren->setupGPUBVH(nextGpuBvh);
 		}
 
-		// Render new screen
-		if(initScene) ren->render();
-		ui->renderGUI();
-		win->swapBuffers();
+		ren->updateScene(*nextScene.get());
+		uploading = true;
 	}
 
+	if (!uploading)
+		return;
+
+	// Previous scene is rendered until new scene is uploaded
+	if (!ren->uploadStep()) {
+		ui_data->loadProgress = 0.9f + 0.1f * ren->getUploadProgress();
+		return;
+	}
+
+	scene = nextScene;
+	ui_data->bvhReport = nextBvhReport;
+
+	// Builders of previous scene build the next one (each set owns its buffers, rendered scene is never overwritten)
+	std::swap(sah_bvh, nextSahBvh);
+	std::swap(gpu_bvh, nextGpuBvh);
+	std::swap(ploc_bvh, nextPlocBvh);
+
+	nextScene.reset();
+
+	// Textures of new scene could become resident during upload
+	ren->updateMaterials(*scene.get());
+
+	uploading = false;
+	initScene = true;
+	ui_data->loading = false;
+	ui_data->loadProgress = 1.0f;
+
+}
+
+template<typename RenderTech>
+inline void App<RenderTech>::measureCPUBVH(ge::sg::BVH_Node<ge::sg::AABB>* root, const std::vector<unsigned>& indices, std::string name){
+
+	PROFILE_ZONE("BVH metrics");
+
+	// Same flattened nodes as uploaded on GPU (leaf range ends behind last primitive)
+	bvhPreprocessor bp;
+	bp.transformBVH(root, root->first);
+
+	std::vector<bvhPreprocessor::gpuNode>& nodes = *bp.getTree();
+	size_t memory = nodes.size() * sizeof(bvhPreprocessor::gpuNode) + indices.size() * sizeof(unsigned);
+
+	// Build reorders indices, triangle on every position is viewed through them
+	ge::sg::GeometryView scene = nextScene->getGeometryView();
+	ge::sg::GeometryView geometry(scene.positions, scene.vertexCount, indices.data(), indices.size(), scene.stride);
+
+	std::vector<unsigned> order(geometry.triangleCount());
+
+	for (unsigned i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	nextBvhReport = std::make_shared<BVHMetrics::report>(BVHMetrics::compute(BVHMetrics::fromNodes(nodes, false), order, geometry, memory));
+
+	if (!BVHMetrics::writeJson(*nextBvhReport, name, BVH_METRICS_FILE))
+		std::cout << "BVH metrics could not be written into " << BVH_METRICS_FILE << std::endl;
+
+	if (!nextBvhReport->valid)
+		std::cout << "BVH validation failed with " << nextBvhReport->errorCount << " errors" << std::endl;
+
+}
+
+template<typename RenderTech>
+inline void App<RenderTech>::measureGPUBVH(){
+
+	PROFILE_ZONE("BVH metrics");
+
+	std::vector<ge::sg::RadixTree_BVH::bvh_node> nodes;
+	std::vector<unsigned> order;
+	nextGpuBvh->readNodes(nodes, order);
+
+	int format = nextGpuBvh->getNodeFormat();
+	size_t memory = nodes.size() * sizeof(ge::sg::RadixTree_BVH::bvh_node) + order.size() * sizeof(unsigned);
+	ge::sg::GeometryView geometry = nextScene->getGeometryView();
+
+	nextBvhReport = std::make_shared<BVHMetrics::report>(BVHMetrics::compute(BVHMetrics::fromRadixTree(nodes, format, order, geometry), order, geometry, memory));
+
+	if (!BVHMetrics::writeJson(*nextBvhReport, format == BVH_NODES_INDEXED_RANGES ? "RadixTree_BVH (treelets)" : "RadixTree_BVH", BVH_METRICS_FILE))
+		std::cout << "BVH metrics could not be written into " << BVH_METRICS_FILE << std::endl;
+
+	if (!nextBvhReport->valid)
+		std::cout << "BVH validation failed with " << nextBvhReport->errorCount << " errors" << std::endl;
+
 }
@@ -15,6 +15,8 @@ using BVHNode = ge::sg::BVH_Node<ge::sg::AABB>;
 
 void ge::sg::AABB_SAH_BVH::build() {
 
+	PROFILE_ZONE("SAH build");
+
 	computeCenters(_firstPrimitive, _lastPrimitive);
 	
 	ge::sg::AABB bvol;
@@ -22,12 +24,6 @@ void ge::sg::AABB_SAH_BVH::build() {
 
 	recursiveBuild(*rootNode, _firstPrimitive, maxDepth - 1, DivideAxis::X_AXIS);
 
-#ifdef CPU_BVH_MEASURE
-	std::cout << "Bound boxes " << minBB * 1000.0f << "ms" << std::endl;
-	std::cout << "Sort " << sort * 1000.0f << "ms" << std::endl;
-	std::cout << "Division " << divide * 1000.0f << "ms" << std::endl;
-#endif
-
 }
 
 void ge::sg::AABB_SAH_BVH::setSplitPartitions(unsigned numberOfParts) {
@@ -44,10 +40,12 @@ void ge::sg::AABB_SAH_BVH::recursiveBuild(BVHNode & node, ge::sg::IndexedTriangl
 	glm::vec3 _min(std::numeric_limits<float>::max()), _max(-std::numeric_limits<float>::max());
 
 	assert((node.last - node.first) > 0);
-	
-#ifdef CPU_BVH_MEASURE
-	std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+	// Only top levels are profiled (zones of all nodes would overwrite profiler history), bounds are measured by node zone
+#ifdef RT_PROFILE
+	bool profiled = maxDepth - 1 - currentDepth < AABB_SAH_BVH_PROFILE_DEPTH;
 #endif
+	PROFILE_ZONE_IF(profiled, "SAH node");
 	
 	//for (auto i = node.first; i < node.last; i = i + 1) {
 	unsigned begin = node.first - _firstPrimitive, end = node.last - _firstPrimitive;
@@ -75,13 +73,6 @@ void ge::sg::AABB_SAH_BVH::recursiveBuild(BVHNode & node, ge::sg::IndexedTriangl
 
 	assert(abs(_min.x - std::numeric_limits<float>::max()) > 1e-5);
 
-#ifdef CPU_BVH_MEASURE
-	std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-	std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
-	minBB += time_span.count();
-#endif
-
-	
 	
 	node.left = nullptr, node.right = nullptr;
 	
@@ -100,37 +91,27 @@ void ge::sg::AABB_SAH_BVH::recursiveBuild(BVHNode & node, ge::sg::IndexedTriangl
 	if (maxCoord - minCoord <= 0.0f)
 		return;
 
-#ifdef CPU_BVH_MEASURE
-	t1 = std::chrono::high_resolution_clock::now();
-#endif
-
 	// Sort centers by one axis
-	if (node.first.getIndices() == nullptr)
-		sortCenters(node.first, node.last, start, axis);
-	else
-		sortCentersIndexed(node.first, node.last, start, axis);
-
-#ifdef CPU_BVH_MEASURE
-	t2 = std::chrono::high_resolution_clock::now();
-	time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
-	sort += time_span.count();
-#endif
+	{
+		PROFILE_ZONE_IF(profiled, "Sort");
+
+		if (node.first.getIndices() == nullptr)
+			sortCenters(node.first, node.last, start, axis);
+		else
+			sortCentersIndexed(node.first, node.last, start, axis);
+	}
 
-#ifdef CPU_BVH_MEASURE
-	t1 = std::chrono::high_resolution_clock::now();
-#endif
-	
 	// Divide node
 	node.left = nullptr, node.right = nullptr;
 	ge::sg::IndexedTriangleIterator splitPosition;
 
-	splitPosition = divideBySAH(node, start, axis);
+	{
+		PROFILE_ZONE_IF(profiled, "Divide");
+		splitPosition = divideBySAH(node, start, axis);
+	}
 
-#ifdef CPU_BVH_MEASURE
-	t2 = std::chrono::high_resolution_clock::now();
-	time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
-	divide += time_span.count();
-#endif
+	// Children are sorted along split axis, left child is on its lower side
+	node.axis = axis == DivideAxis::X_AXIS ? 0 : axis == DivideAxis::Y_AXIS ? 1 : 2;
 
 	// Left child
 	if ((splitPosition - node.first) > 0) {
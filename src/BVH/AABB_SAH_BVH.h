@@ -19,10 +19,12 @@
 
 #include <BVH_Node.h>
 
+#include <Profiler.h>
+
 #include <limits>
-#include <chrono>
 
-//#define CPU_BVH_MEASURE
+// Number of top levels of build with profiled nodes
+#define AABB_SAH_BVH_PROFILE_DEPTH 4
 
 namespace ge {
 	namespace sg {
@@ -60,10 +62,6 @@ namespace ge {
 			// number of candidate split planes
 			unsigned nrOfPartitions = 10;
 
-#ifdef CPU_BVH_MEASURE
-			double sort, divide, minBB;
-#endif
-
 			/*
 			* Function, which recursively builds BVH structure
 			* node - expanded node
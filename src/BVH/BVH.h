@@ -18,6 +18,7 @@
 
 #include <GeneralCPUBVH.h>
 #include <GeneralGPUBVH.h>
+#include <GeometryView.h>
 
 #include <memory>
 
@@ -56,6 +57,14 @@ namespace ge {
 				build();
 			}
 
+			/**
+			 * @brief Setting geometry data for BVH (without copy of positions)
+			 * @param view non-owning view of positions and indices
+			 */
+			void setGeometryData(const ge::sg::GeometryView& view) {
+				BuildPolicy::setGeometry(view);
+			}
+
 			/**
 			 * @brief Setting geometry data for BVH
 			 * @param data pointer to geometry data (coordinates)
@@ -115,6 +124,14 @@ namespace ge {
 				BuildPolicy::setMinNodePrimitives(primitivesNumber);
 			}
 
+			/**
+			 * @brief Sets number of worker threads of parallel build
+			 * @param threads number of threads (0 - hardware concurrency)
+			 */
+			void setThreads(unsigned threads) {
+				BuildPolicy::setThreads(threads);
+			}
+
 		};
 
 	}
@@ -73,6 +73,7 @@ namespace ge {
 			Bound_volume volume;							// Bounding Volume
 			ge::sg::IndexedTriangleIterator first, last;	// Primitives in node
 			std::shared_ptr<BVH_Node> left, right;			// Pointers to childs
+			int axis = -1;									// Split axis of inner node (-1 if builder has no split planes)
 
 		protected:
 
@@ -19,6 +19,28 @@ void ge::sg::GeneralCPUBVH::setGeometry(std::shared_ptr<float> data, size_t size
 
 }
 
+void ge::sg::GeneralCPUBVH::setGeometry(const ge::sg::GeometryView & view){
+
+	// Only indices are copied - build reorders them, positions are never written
+	primitiveIndices.resize(3 * view.triangleCount());
+
+	if (view.indices != nullptr)
+		std::copy(view.indices, view.indices + primitiveIndices.size(), primitiveIndices.begin());
+	else
+		for (unsigned i = 0; i < primitiveIndices.size(); i++)
+			primitiveIndices[i] = i;
+
+	float* positions = const_cast<float*>(view.positions);
+
+	_firstPrimitive = ge::sg::IndexedTriangleIterator(positions, primitiveIndices.data(), view.stride);
+	_lastPrimitive = _firstPrimitive + static_cast<int>(view.triangleCount());
+
+}
+
+std::vector<unsigned>& ge::sg::GeneralCPUBVH::getPrimitiveIndices(){
+	return primitiveIndices;
+}
+
 void ge::sg::GeneralCPUBVH::setGeometry(ge::sg::IndexedTriangleIterator & _start, ge::sg::IndexedTriangleIterator & _end){
 
 	_firstPrimitive = _start;
@@ -73,8 +95,18 @@ void ge::sg::GeneralCPUBVH::setMinNodePrimitives(unsigned _minNodePrimitives){
 
 }
 
+void ge::sg::GeneralCPUBVH::setThreads(unsigned _threads){
+
+	threads = _threads;
+
+}
+
 void ge::sg::GeneralCPUBVH::computeCenters(ge::sg::IndexedTriangleIterator & _start, ge::sg::IndexedTriangleIterator & _end){
 
+	// Builder is reused for next scenes (capacity of centers is kept)
+	associatedCenters.clear();
+	associatedCenters.reserve(_end - _start);
+
 	for (auto it = _start; it < _end; it += 1) {
 
 		primitiveCenter c;
@@ -18,6 +18,8 @@
 
 #include <geCore/idlist.h>
 
+#include <GeometryView.h>
+
 #include <algorithm>
 #include <vector>
 
@@ -52,10 +54,26 @@ namespace ge {
 			unsigned maxDepth = 10;
 			unsigned dividePartitions = 10;
 			unsigned minVolumePrimitives = 10;
+			unsigned threads = 0;			// Worker threads of parallel builders (0 - hardware concurrency)
 			
 			std::vector<primitiveCenter> associatedCenters;
 			ge::sg::IndexedTriangleIterator _firstPrimitive, _lastPrimitive;
 
+			// Indices of triangles (reordered by build, positions stay in viewed memory)
+			std::vector<unsigned> primitiveIndices;
+
+
+			/*
+			* @param view - non-owning view of geometry (indices are copied, positions are used in place)
+			*/
+			void setGeometry(const ge::sg::GeometryView& view);
+
+			/*
+			* @brief Getter for triangle indices in order of BVH leaves (valid for geometry set by view)
+			* @return Vector of indices, 3 per triangle
+			*/
+			std::vector<unsigned>& getPrimitiveIndices();
+
 
 			/*
 			* @param _start - first primitive
@@ -98,6 +116,12 @@ namespace ge {
 			void setMinNodePrimitives(unsigned _minNodePrimitives);
 
 
+			/*
+			* @param _threads - number of worker threads of parallel build (0 - hardware concurrency)
+			*/
+			void setThreads(unsigned _threads);
+
+
 			/*
 			 * @brief Procomputation of primitive's centroids and its morton codes
 			 * @param _start - iterator to first primitive
@@ -9,13 +9,19 @@
 */
 
 #include "GeneralGPUBVH.h"
-//#define GPU_BVH_MEASURE
 
 void ge::sg::GeneralGPUBVH::setGeometry(std::shared_ptr<float> data, size_t size){
 
-	inputData.shrink_to_fit();
-	inputData.resize(size);
-	std::memcpy(inputData.data(), data.get(), size * sizeof(float));
+	// Data are shared, no copy is needed
+	sharedData = data;
+	setGeometry(ge::sg::GeometryView(data.get(), size / 3));
+
+}
+
+void ge::sg::GeneralGPUBVH::setGeometry(const ge::sg::GeometryView & view){
+
+	geometry = view;
+	triangleCount = static_cast<unsigned>(view.triangleCount());
 
 }
 
@@ -26,24 +32,38 @@ void ge::sg::GeneralGPUBVH::setGeometry(ge::sg::IndexedTriangleIterator & _start
 	inputData.resize(count * 9);
 	std::memcpy(inputData.data(), _start->v0, 9 * count * sizeof(float));
 
+	setGeometry(ge::sg::GeometryView(inputData.data(), inputData.size() / 3));
+
 }
 
 void ge::sg::GeneralGPUBVH::setGeometry(ge::sg::Mesh & _geometry){
 
-	auto _start = ge::sg::MeshPositionIteratorBegin(&_geometry);
-	auto _end = ge::sg::MeshPositionIteratorEnd(&_geometry);
+	const float* positions = nullptr;
+	const unsigned* indices = nullptr;
+	size_t vertexCount = 0, indexCount = 0;
 
-	unsigned count = _end - _start;
-	inputData.shrink_to_fit();
-	inputData.resize(count * 9);
-	std::memcpy(inputData.data(), _start->v0, 9 * count * sizeof(float));
+	// Mesh attributes are viewed directly
+	for (auto attr : _geometry.attributes) {
+
+		if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::position) {
+			positions = static_cast<const float*>(attr->data.get());
+			vertexCount = attr->size / (sizeof(float) * attr->numComponents);
+		}
+
+		else if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::indices) {
+			indices = static_cast<const unsigned*>(attr->data.get());
+			indexCount = attr->size / sizeof(unsigned);
+		}
+	}
+
+	setGeometry(ge::sg::GeometryView(positions, vertexCount, indices, indexCount));
 
 }
 
 void ge::sg::GeneralGPUBVH::setGeometry(ge::sg::Model & _geometry){
 
 	unsigned offset = 0;
-	inputData.shrink_to_fit();
+	inputData.clear();
 
 	for (auto mesh : _geometry.meshes) {
 
@@ -58,12 +78,14 @@ void ge::sg::GeneralGPUBVH::setGeometry(ge::sg::Model & _geometry){
 		offset += 9 * count;
 	}
 
+	setGeometry(ge::sg::GeometryView(inputData.data(), inputData.size() / 3));
+
 }
 
 void ge::sg::GeneralGPUBVH::setGeometry(ge::sg::Scene & _geometry){
 
 	unsigned offset = 0;
-	inputData.shrink_to_fit();
+	inputData.clear();
 
 	for(auto model : _geometry.models){
 		for (auto mesh : model->meshes) {
@@ -80,45 +102,122 @@ void ge::sg::GeneralGPUBVH::setGeometry(ge::sg::Scene & _geometry){
 		}
 	}
 
+	setGeometry(ge::sg::GeometryView(inputData.data(), inputData.size() / 3));
+
+}
+
+void ge::sg::GeneralGPUBVH::setTimer(std::shared_ptr<GPUTimer> gpuTimer){
+	timer = gpuTimer;
+}
+
+void ge::sg::GeneralGPUBVH::setSortValidation(bool enable){
+	sortValidation = enable;
+}
+
+bool ge::sg::GeneralGPUBVH::isBuilt(){
+	return built;
+}
+
+bool ge::sg::GeneralGPUBVH::isSortValid(){
+	return sortValid;
+}
+
+void ge::sg::GeneralGPUBVH::setMortonCodeBits(unsigned bits){
+	mortonCodeBits = bits > MORTON_CODE_BITS ? MORTON_CODE_BITS_64 : MORTON_CODE_BITS;
+}
+
+std::string ge::sg::GeneralGPUBVH::kernelDefines(){
+	return mortonCodeBits > MORTON_CODE_BITS ? "#define MORTON_CODE_64\n" : "";
+}
+
+unsigned ge::sg::GeneralGPUBVH::growCapacity(unsigned capacity, unsigned required){
+
+	// Geometric growth - repeated builds of growing scenes reallocate rarely
+	capacity = std::max(capacity, 1024u);
+
+	while (capacity < required)
+		capacity *= 2;
+
+	return capacity;
+}
+
+std::vector<uint64_t> ge::sg::GeneralGPUBVH::readMortonCodes(unsigned offset){
+
+	unsigned words = mortonCodeBits > MORTON_CODE_BITS ? 2 : 1;
+	std::vector<unsigned> data(words * triangleCount);
+	std::vector<uint64_t> codes(triangleCount);
+
+	mortonCodes->getData(data.data(), data.size() * sizeof(unsigned), words * offset * sizeof(unsigned));
+
+	for (unsigned i = 0; i < triangleCount; i++)
+		codes[i] = words == 2 ? (static_cast<uint64_t>(data[2 * i + 1]) << 32 | data[2 * i]) : data[i];
+
+	return codes;
 }
 
 std::shared_ptr<ge::gl::Buffer> ge::sg::GeneralGPUBVH::getIndices(){
 	return indicesBuffer;
 }
 
-void ge::sg::GeneralGPUBVH::initGPUObjects(){
+bool ge::sg::GeneralGPUBVH::initGPUObjects(){
 
-	verticesBuffer = std::make_shared<ge::gl::Buffer>(sizeof(float) * inputData.size());
-	verticesBuffer->setData(inputData.data(), inputData.size() * sizeof(float), 0);
+	// Buffers are kept between builds, they are reallocated only for more triangles (or longer codes)
+	if (triangleCount > capacity || mortonCodeBits != kernelBits || verticesBuffer == nullptr) {
 
-	verticesBuffer->setData(inputData.data(), inputData.size() * sizeof(float), 0);
+		capacity = growCapacity(capacity, triangleCount);
+		unsigned words = mortonCodeBits > MORTON_CODE_BITS ? 2 : 1;
 
-	// Buffer with indices of triangles
-	std::vector<unsigned> indices(inputData.size() / 9);
+		// Triangles gathered from viewed geometry (the only copy)
+		verticesBuffer = GPUMemory::createBuffer(AllocationCounter::BVH, sizeof(float) * 9 * capacity);
 
-	for (unsigned i = 0; i < inputData.size() / 9; i++)
-		indices[i] = i;
+		// Buffer with indices of triangles (2 halves for sorting)
+		indicesBuffer = GPUMemory::createBuffer(AllocationCounter::BVH, 2 * sizeof(unsigned) * capacity);
+
+		// Buffer for morton codes of triangles centroids
+		mortonCodes = GPUMemory::createBuffer(AllocationCounter::BVH, 2 * words * sizeof(unsigned) * capacity);
+
+		// Buffer for parallel radix sort (histograms of blocks scanned into global offsets of digits, followed by sums of scan tiles)
+		unsigned blocks = ge::sg::RadixSort::blocks(capacity);
+		radixBucket = GPUMemory::createBuffer(AllocationCounter::BVH, (RADIX_SORT_SIZE * blocks + ge::sg::RadixSort::scanTiles(blocks)) * sizeof(unsigned));
+	}
+
+	// Triangles are gathered from viewed geometry directly into vertex buffer
+	GLsizeiptr verticesSize = sizeof(float) * 9 * std::max(triangleCount, 1u);
+	float* vertices = static_cast<float*>(verticesBuffer->map(0, verticesSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+
+	minCoord = glm::vec3(std::numeric_limits<float>::max());
+	maxCoord = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (unsigned i = 0; i < triangleCount; i++) {
+		for (unsigned c = 0; c < 3; c++) {
 
-	//auto indices = generateIndices(inputData.size() / 9);
-	indicesBuffer = std::make_shared<ge::gl::Buffer>(2 * sizeof(unsigned) * indices.size());
-	indicesBuffer->setData(indices.data(), indices.size() * sizeof(unsigned), 0);
-	indicesBuffer->setData(indices.data(), indices.size() * sizeof(unsigned), indices.size() * sizeof(unsigned));
+			const float* v = geometry.vertex(i, c);
+			std::memcpy(vertices + 9 * i + 3 * c, v, 3 * sizeof(float));
 
-	// Buffer for morton codes of triangles centroids
-	mortonCodes = std::make_shared<ge::gl::Buffer>(2 * sizeof(unsigned) * (inputData.size() / 9));
-	mortonCodes->setData(nullptr);
+			minCoord = glm::min(minCoord, glm::vec3(v[0], v[1], v[2]));
+			maxCoord = glm::max(maxCoord, glm::vec3(v[0], v[1], v[2]));
+		}
+	}
 
-	// Buffer for parallel radix sort (histogram computing, reordering elements)
-	radixBucket = std::make_shared<ge::gl::Buffer>(4 * sizeof(unsigned) * (inputData.size() / 9));
-	radixBucket->setData(nullptr);
+	verticesBuffer->unmap();
 
+	// Initial indices of triangles
+	std::vector<unsigned> indices = generateIndices(triangleCount);
 
-	auto mortonShader = std::make_shared<ge::gl::Shader>(GL_COMPUTE_SHADER, ge::core::loadTextFile("../src/BVH/kernels/mortonCodeComputation.cs"));
-	mortonKernel = std::make_shared<ge::gl::Program>(mortonShader);
+	if (triangleCount > 0) {
+		indicesBuffer->setData(indices.data(), indices.size() * sizeof(unsigned), 0);
+		indicesBuffer->setData(indices.data(), indices.size() * sizeof(unsigned), indices.size() * sizeof(unsigned));
+	}
 
-	auto sortShader = std::make_shared<ge::gl::Shader>(GL_COMPUTE_SHADER, ge::core::loadTextFile("../src/BVH/kernels/parallelRadixSort.cs"));
-	sortKernel = std::make_shared<ge::gl::Program>(sortShader);
+	// Kernels are compiled once (program binaries are cached on disk)
+	if (mortonKernel == nullptr || sortKernel == nullptr || mortonCodeBits != kernelBits) {
+		mortonKernel = ge::sg::KernelCache::load(MORTON_KERNEL, kernelDefines());
+		sortKernel = ge::sg::KernelCache::load(RADIX_SORT_KERNEL, kernelDefines());
+		kernelBits = mortonCodeBits;
+	}
 
+	// Missing or broken kernel (errors are printed by KernelCache), kernels are loaded again by next build
+	return mortonKernel != nullptr && sortKernel != nullptr;
 }
 
 std::vector<unsigned> ge::sg::GeneralGPUBVH::generateIndices(size_t numberOfTriangles){
@@ -133,43 +232,26 @@ std::vector<unsigned> ge::sg::GeneralGPUBVH::generateIndices(size_t numberOfTria
 
 std::pair<glm::vec3, glm::vec3> ge::sg::GeneralGPUBVH::findMinMaxCoords(){
 
-	glm::vec3 minCoord = glm::vec3(std::numeric_limits<float>::max());
-	glm::vec3 maxCoord = glm::vec3(-std::numeric_limits<float>::max());
-
-	for (int i = 0; i < inputData.size(); i += 3) {
-		minCoord.x = std::min(minCoord.x, inputData.at(i));
-		minCoord.y = std::min(minCoord.y, inputData.at(i+1));
-		minCoord.z = std::min(minCoord.z, inputData.at(i+2));
-
-		maxCoord.x = std::max(maxCoord.x, inputData.at(i));
-		maxCoord.y = std::max(maxCoord.y, inputData.at(i+1));
-		maxCoord.z = std::max(maxCoord.z, inputData.at(i+2));
-	}
-
+	// Bounds are computed during gather of triangles (initGPUObjects)
 	return std::pair<glm::vec3, glm::vec3>(minCoord, maxCoord);
 }
 
 void ge::sg::GeneralGPUBVH::computeMortonCodes(){
 
-	unsigned count = inputData.size() / 9;
+	unsigned count = triangleCount;
 	auto minMax = findMinMaxCoords();
 
-#ifdef GPU_BVH_MEASURE
-	GLuint query;
-	int done = 0;
-	GLuint64 elapsed_time;
-	ge::gl::glGenQueries(1, &query);
-	ge::gl::glBeginQuery(GL_TIME_ELAPSED, query);
-#endif // GPU_BVH_MEASURE
+	if (timer != nullptr)
+		timer->begin("Morton codes");
 
 	// --- Phase 1 - Morton code calculation ---
 	mortonKernel->use();
 	verticesBuffer->bindBase(GL_SHADER_STORAGE_BUFFER, 10);
 	mortonCodes->bindBase(GL_SHADER_STORAGE_BUFFER, 11);
 
-	mortonKernel->set3f("minCoord", minMax.first.x, minMax.first.y, minMax.first.z);
-	mortonKernel->set3f("maxCoord", minMax.second.x, minMax.second.y, minMax.second.z);
-	mortonKernel->set1i("numberOfTriangles", count);
+	ge::sg::KernelCache::set(mortonKernel, "minCoord", minMax.first);
+	ge::sg::KernelCache::set(mortonKernel, "maxCoord", minMax.second);
+	ge::sg::KernelCache::set(mortonKernel, "numberOfTriangles", count);
 
 	GLint wgs[3];
 	mortonKernel->getComputeWorkGroupSize(wgs);
@@ -180,100 +262,105 @@ void ge::sg::GeneralGPUBVH::computeMortonCodes(){
 	mortonCodes->unbindBase(GL_SHADER_STORAGE_BUFFER, 11);
 	// --- Phase 1 - Morton code calculation ---
 
-#ifdef GPU_BVH_MEASURE
-	ge::gl::glEndQuery(GL_TIME_ELAPSED);
-
-	while (!done)
-		ge::gl::glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &done);
-
-	done = 0;
-	ge::gl::glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
-	std::cout << "Morton codes computuation " << (elapsed_time / 1000000) << "ms" << std::endl;
-#endif // GPU_BVH_MEASURE
+	if (timer != nullptr)
+		timer->end();
 
 
 }
 
 void ge::sg::GeneralGPUBVH::sortMortonCodes(){
 
-	unsigned count = inputData.size() / 9;
+	unsigned count = triangleCount;
 
-#ifdef GPU_BVH_MEASURE
-	GLuint query;
-	int done = 0;
-	GLuint64 elapsed_time;
-	ge::gl::glGenQueries(1, &query);
-	ge::gl::glBeginQuery(GL_TIME_ELAPSED, query);
-#endif // GPU_BVH_MEASURE
+	if (timer != nullptr)
+		timer->begin("Radix sort");
 
 	// --- Phase 2 - Morton code sort ---
 
-	int scan_steps = ceil(log2f(2 * count));
-	int offsetTable[] = { 0, count };
+	int numBlocks = ge::sg::RadixSort::blocks(count);
+	int scanTiles = ge::sg::RadixSort::scanTiles(numBlocks);
+	int passes = ge::sg::RadixSort::passes(mortonCodeBits);
+	int offsetTable[] = { 0, static_cast<int>(count) };
 	int activeIn = 0;
 
+	// Input of sort for validation on CPU
+	std::vector<uint64_t> cpuKeys;
+	std::vector<unsigned> cpuValues;
+
+	if (sortValidation) {
+		cpuKeys = readMortonCodes(0);
+		cpuValues.resize(count);
+		indicesBuffer->getData(cpuValues.data(), count * sizeof(unsigned), 0);
+	}
+
 	sortKernel->use();
-	sortKernel->set1i("size", count);
+	ge::sg::KernelCache::set(sortKernel, "size", count);
+	ge::sg::KernelCache::set(sortKernel, "numBlocks", numBlocks);
 
 	radixBucket->bindBase(GL_SHADER_STORAGE_BUFFER, 13);
 	mortonCodes->bindBase(GL_SHADER_STORAGE_BUFFER, 11);
 	indicesBuffer->bindBase(GL_SHADER_STORAGE_BUFFER, 12);
 
-	GLint wgs[3];
-	sortKernel->getComputeWorkGroupSize(wgs);
+	// Parallel Radix sort with 4-bit digits (8 or 16 iterations for 30 or 63 bit morton codes, even count - result stays in first half)
+	for (int i = 0; i < passes; i++) {
 
-	// Parallel Radix sort with 30 iterations (30 bit morton codes)
-	for (int i = 0; i < 30; i++) {
+		ge::sg::KernelCache::set(sortKernel, "shift", i * RADIX_SORT_BITS);
+		ge::sg::KernelCache::set(sortKernel, "inOffset", offsetTable[activeIn]);
+		ge::sg::KernelCache::set(sortKernel, "outOffset", offsetTable[1 - activeIn]);
 
-		// --Histogram--
-		sortKernel->set1i("phase", 0);
-		sortKernel->set1i("base", 0x1 << i);
-		sortKernel->set1i("inOffset", offsetTable[activeIn]);
-		sortKernel->set1i("outOffset", offsetTable[1 - activeIn]);
+		// --Histogram-- (one workgroup per block)
+		ge::sg::KernelCache::set(sortKernel, "phase", 0);
 
-		ge::gl::glDispatchCompute((int)ceil(count / static_cast<float>(wgs[0])), 1, 1);
+		ge::gl::glDispatchCompute(numBlocks, 1, 1);
 		ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 		// --Histogram--
 
-		// --Prefix sum--
-		sortKernel->set1i("size", 2 * count);
-		sortKernel->set1i("phase", 1);
+		// --Prefix sum-- (sums of tiles, scan of tile sums in single workgroup, scan of tiles)
+		ge::sg::KernelCache::set(sortKernel, "phase", 1);
 
-		for (int j = 0; j < scan_steps; j++) {
-			sortKernel->set1i("delta", 0x1 << j);
-			sortKernel->set1i("inBucket", (j % 2) * 2 * count);
-			sortKernel->set1i("outBucket", ((j + 1) % 2) * 2 * count);
+		ge::gl::glDispatchCompute(scanTiles, 1, 1);
+		ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-			ge::gl::glDispatchCompute((int)ceil((2 * count) / static_cast<float>(wgs[0])), 1, 1);
-			ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-		}
+		ge::sg::KernelCache::set(sortKernel, "phase", 2);
+
+		ge::gl::glDispatchCompute(1, 1, 1);
+		ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		ge::sg::KernelCache::set(sortKernel, "phase", 3);
+
+		ge::gl::glDispatchCompute(scanTiles, 1, 1);
+		ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 		// --Prefix sum--
 
 		// --Reorder--
-		sortKernel->set1i("size", count);
-		sortKernel->set1i("phase", 2);
+		ge::sg::KernelCache::set(sortKernel, "phase", 4);
 
-		ge::gl::glDispatchCompute(ceil(count / static_cast<float>(wgs[0])), 1, 1);
+		ge::gl::glDispatchCompute(numBlocks, 1, 1);
 		ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 		// --Reorder--
 
 		activeIn = 1 - activeIn;
 	}
 
+	// Sort on CPU by the same algorithm, both results have to be identical (also on software GL implementations)
+	if (sortValidation) {
+
+		ge::sg::RadixSort::sort(cpuKeys, cpuValues, mortonCodeBits);
+
+		std::vector<uint64_t> gpuKeys = readMortonCodes(offsetTable[activeIn]);
+		std::vector<unsigned> gpuValues(count);
+		indicesBuffer->getData(gpuValues.data(), count * sizeof(unsigned), offsetTable[activeIn] * sizeof(unsigned));
+
+		sortValid = gpuKeys == cpuKeys && gpuValues == cpuValues;
+		std::cout << "Radix sort validation " << (sortValid ? "passed" : "failed") << std::endl;
+	}
+
 	radixBucket->unbindBase(GL_SHADER_STORAGE_BUFFER, 13);
 	mortonCodes->unbindBase(GL_SHADER_STORAGE_BUFFER, 11);
 	indicesBuffer->unbindBase(GL_SHADER_STORAGE_BUFFER, 12);
 	// --- Phase 2 - Morton code sort ---
 
-#ifdef GPU_BVH_MEASURE
-	ge::gl::glEndQuery(GL_TIME_ELAPSED);
-
-	while (!done)
-		ge::gl::glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &done);
-
-	done = 0;
-	ge::gl::glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
-	std::cout << "Radix sort " << (elapsed_time / 1000000) << "ms" << std::endl;
-#endif // GPU_BVH_MEASURE
+	if (timer != nullptr)
+		timer->end();
 
 }
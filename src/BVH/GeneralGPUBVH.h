@@ -21,10 +21,18 @@
 
 #include <geCore/Text.h>
 
+#include <GeometryView.h>
+#include <RadixSort.h>
+#include <MortonCode.h>
+#include <KernelCache.h>
+#include <GPUTimer.h>
+#include <GPUMemory.h>
+
 #include <memory>
 #include <vector>
 #include <string>
 #include <limits>
+#include <iostream>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -54,6 +62,12 @@ namespace ge {
 			*/
 			void setGeometry(std::shared_ptr<float> data, size_t size);
 
+			/**
+			* @brief Sets geometry without copy, triangles are gathered directly into vertex buffer during build
+			* @param view non-owning view of positions and indices
+			*/
+			void setGeometry(const ge::sg::GeometryView& view);
+
 			/**
 			* @brief 
 			* @param _start first primitive
@@ -103,12 +117,64 @@ namespace ge {
 			*/
 			std::shared_ptr<ge::gl::Buffer> getIndices();
 
+			/**
+			* @brief Sets length of morton codes
+			* @param bits MORTON_CODE_BITS (10 bits per axis) or MORTON_CODE_BITS_64 (21 bits per axis, better quality of BVH on large scenes)
+			*/
+			void setMortonCodeBits(unsigned bits);
+
+			/**
+			* @brief Sets timer, which measures build phases on GPU
+			* @param gpuTimer Timer shared with renderer (nullptr - no measurement)
+			*/
+			void setTimer(std::shared_ptr<GPUTimer> gpuTimer);
+
+			/**
+			* @brief Enables validation of GPU radix sort - sorted codes are read back and compared with ge::sg::RadixSort on CPU (slow)
+			* @param enable true for validation of every build
+			*/
+			void setSortValidation(bool enable);
+
+			/**
+			* @brief Result of validation of the last sort
+			* @return false if sort on GPU differs from sort on CPU (true without validation)
+			*/
+			bool isSortValid();
+
+			/**
+			* @brief Checks result of the last build
+			* @return false if build failed (kernel could not be loaded or compiled), buffers of BVH are not valid
+			*/
+			bool isBuilt();
+
 		//protected:
 
 			/**
 			* @brief Initialization of GPU objects
+			* @return false if kernels could not be loaded
+			*/
+			bool initGPUObjects();
+
+			/**
+			* @brief Defines of current settings injected into kernels
+			* @return Define directives
+			*/
+			std::string kernelDefines();
+
+			/**
+			* @brief Computes new capacity of buffers (geometric growth)
+			* @param capacity Current capacity in triangles
+			* @param required Required number of triangles
+			* @return New capacity in triangles
+			*/
+			static unsigned growCapacity(unsigned capacity, unsigned required);
+
+			/**
+			* @brief Reads morton codes from GPU
+			* @param offset Index of first code (0 - first half, triangleCount - second half of buffer)
+			* @return Codes extended to 64 bits
 			*/
-			void initGPUObjects();
+			std::vector<uint64_t> readMortonCodes(unsigned offset);
 
 			/**
 			* @brief Generates vector for given amount of triangles
@@ -132,14 +198,26 @@ namespace ge {
 
 			/**
 			* @brief Sort morton codes on GPU using parallel radix sort
-			* @note 
+			* @note 4-bit digits, block histograms and stable scatter, matches ge::sg::RadixSort on CPU
+			* @note Prefix sum of block histograms is reduce-then-scan over tiles of 4096 entries (one workgroup per tile)
 			*/
 			void sortMortonCodes();
 
 			// Common attributes (index & vertex buffers, helper buffers for BVH build)
 			std::shared_ptr<ge::gl::Buffer> verticesBuffer, indicesBuffer, mortonCodes, radixBucket;	// Buffers
 			std::shared_ptr<ge::gl::Program> mortonKernel, sortKernel;									// Kernels (compute shaders respectivelly)
-			std::vector<float> inputData = std::vector<float>();										// Vector of input geometry data 
+			ge::sg::GeometryView geometry;																// View of input geometry data
+			std::vector<float> inputData = std::vector<float>();										// Gathered geometry of iterators, models and scenes
+			std::shared_ptr<float> sharedData;															// Shared geometry data kept alive until build
+			unsigned triangleCount = 0;																	// Number of triangles
+			unsigned mortonCodeBits = MORTON_CODE_BITS;													// Length of morton codes
+			unsigned kernelBits = 0;																	// Length of morton codes of compiled kernels
+			unsigned capacity = 0;																		// Number of triangles fitting into buffers
+			glm::vec3 minCoord, maxCoord;																// Bounds of geometry
+			std::shared_ptr<GPUTimer> timer;															// Timer of build phases
+			bool sortValidation = false;																// Comparison of GPU sort with CPU sort
+			bool sortValid = true;																		// Result of the last validation
+			bool built = false;																			// Result of the last build
 
 		};
 
@@ -0,0 +1,77 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* GeometryView.h
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace ge {
+	namespace sg {
+
+		/**
+		* @brief Non-owning view of triangle geometry (positions + optional indices)
+		* @note Viewed data have to stay valid until BVH build is finished
+		*/
+		struct GeometryView {
+
+			/**
+			* @brief Constructor of empty view
+			*/
+			GeometryView() {}
+
+			/**
+			* @brief Constructor
+			* @param _positions pointer to first vertex position (3 floats)
+			* @param _vertexCount number of vertices
+			* @param _indices pointer to triangle indices (nullptr - every 3 consecutive vertices form triangle)
+			* @param _indexCount number of indices
+			* @param _stride number of floats between consecutive vertices
+			*/
+			GeometryView(const float* _positions, size_t _vertexCount, const unsigned* _indices = nullptr, size_t _indexCount = 0, unsigned _stride = 3)
+				: positions(_positions), indices(_indices), vertexCount(_vertexCount), indexCount(_indexCount), stride(_stride) {}
+
+			/**
+			* @brief Getter for number of triangles in view
+			* @return Number of triangles
+			*/
+			size_t triangleCount() const {
+				return (indices != nullptr ? indexCount : vertexCount) / 3;
+			}
+
+			/**
+			* @brief Getter for vertex index of triangle corner
+			* @param triangle index of triangle
+			* @param corner corner of triangle (0 - 2)
+			* @return Index of vertex
+			*/
+			unsigned index(size_t triangle, unsigned corner) const {
+				return indices != nullptr ? indices[3 * triangle + corner] : static_cast<unsigned>(3 * triangle + corner);
+			}
+
+			/**
+			* @brief Getter for vertex position of triangle corner
+			* @param triangle index of triangle
+			* @param corner corner of triangle (0 - 2)
+			* @return Pointer to position (3 floats)
+			*/
+			const float* vertex(size_t triangle, unsigned corner) const {
+				return positions + static_cast<size_t>(index(triangle, corner)) * stride;
+			}
+
+			const float* positions = nullptr;		// Vertex positions
+			const unsigned* indices = nullptr;		// Triangle indices (optional)
+			size_t vertexCount = 0;					// Number of vertices
+			size_t indexCount = 0;					// Number of indices
+			unsigned stride = 3;					// Floats between consecutive vertices
+
+		};
+
+	}
+}
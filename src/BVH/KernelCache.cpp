@@ -0,0 +1,174 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* KernelCache.cpp
+*/
+
+#include "KernelCache.h"
+
+#include <geCore/Text.h>
+
+#include <fstream>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+std::shared_ptr<ge::gl::Program> ge::sg::KernelCache::load(std::string file, std::string defines){
+
+	std::string source = ge::core::loadTextFile(file);
+
+	if (source.empty()) {
+		std::cerr << "Kernel " << file << " not found" << std::endl;
+		return nullptr;
+	}
+
+	// Defines have to follow version directive
+	size_t version = source.find("#version");
+	size_t line = version != std::string::npos ? source.find('\n', version) : std::string::npos;
+
+	if (!defines.empty() && line != std::string::npos)
+		source.insert(line + 1, defines);
+
+	// Binary is bound to source and driver
+	std::string driver;
+
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		const GLubyte* s = ge::gl::glGetString(name);
+		driver += s != nullptr ? reinterpret_cast<const char*>(s) : "";
+	}
+
+	uint64_t key = std::hash<std::string>()(source + driver);
+	std::string path = file + "." + std::to_string(std::hash<std::string>()(defines) & 0xFFFF) + KERNEL_CACHE_EXTENSION;
+
+	std::shared_ptr<ge::gl::Program> program;
+
+	if (readBinary(path, key, program))
+		return program;
+
+	// Compilation from source, binary has to be retrievable before linking
+	auto shader = std::make_shared<ge::gl::Shader>(GL_COMPUTE_SHADER, source);
+	program = std::make_shared<ge::gl::Program>();
+
+	ge::gl::glProgramParameteri(program->getId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	ge::gl::glAttachShader(program->getId(), shader->getId());
+	ge::gl::glLinkProgram(program->getId());
+
+	// Compilation errors are reported by shader log, linking errors by program log
+	if (!linked(program)) {
+		std::cerr << "Kernel " << file << " linking failed" << std::endl;
+		std::cerr << infoLog(shader->getId(), false) << infoLog(program->getId(), true) << std::endl;
+		return nullptr;
+	}
+
+	writeBinary(path, key, program);
+
+	return program;
+}
+
+void ge::sg::KernelCache::set(const std::shared_ptr<ge::gl::Program>& program, const char * name, int value){
+	ge::gl::glProgramUniform1i(program->getId(), ge::gl::glGetUniformLocation(program->getId(), name), value);
+}
+
+void ge::sg::KernelCache::set(const std::shared_ptr<ge::gl::Program>& program, const char * name, glm::vec3 value){
+	ge::gl::glProgramUniform3f(program->getId(), ge::gl::glGetUniformLocation(program->getId(), name), value.x, value.y, value.z);
+}
+
+bool ge::sg::KernelCache::readBinary(std::string path, uint64_t key, std::shared_ptr<ge::gl::Program>& program){
+
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open())
+		return false;
+
+	char magic[4];
+	uint32_t version, format;
+	uint64_t storedKey, size;
+
+	file.read(magic, 4);
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	file.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+	// Outdated binary or binary of other source or driver
+	if (!file || std::memcmp(magic, "RTKB", 4) != 0 || version != KERNEL_CACHE_VERSION || storedKey != key)
+		return false;
+
+	std::vector<char> binary(static_cast<size_t>(size));
+	file.read(binary.data(), size);
+
+	if (!file)
+		return false;
+
+	program = std::make_shared<ge::gl::Program>();
+	ge::gl::glProgramBinary(program->getId(), format, binary.data(), static_cast<GLsizei>(size));
+
+	// Driver can reject binary (e.g. after update)
+	return linked(program);
+}
+
+void ge::sg::KernelCache::writeBinary(std::string path, uint64_t key, const std::shared_ptr<ge::gl::Program>& program){
+
+	GLint length = 0;
+	ge::gl::glGetProgramiv(program->getId(), GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	ge::gl::glGetProgramBinary(program->getId(), length, nullptr, &format, binary.data());
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	// Cache is optional (e.g. read-only directory)
+	if (!file.is_open())
+		return;
+
+	uint32_t version = KERNEL_CACHE_VERSION;
+	uint32_t storedFormat = format;
+	uint64_t size = binary.size();
+
+	file.write("RTKB", 4);
+	file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+	file.write(reinterpret_cast<const char*>(&storedFormat), sizeof(storedFormat));
+	file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	file.write(binary.data(), size);
+
+}
+
+bool ge::sg::KernelCache::linked(const std::shared_ptr<ge::gl::Program>& program){
+
+	GLint status = GL_FALSE;
+	ge::gl::glGetProgramiv(program->getId(), GL_LINK_STATUS, &status);
+
+	return status == GL_TRUE;
+}
+
+std::string ge::sg::KernelCache::infoLog(GLuint id, bool program){
+
+	GLint length = 0;
+
+	if (program)
+		ge::gl::glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length);
+	else
+		ge::gl::glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+
+	if (length <= 1)
+		return "";
+
+	std::vector<char> log(length, '\0');
+
+	if (program)
+		ge::gl::glGetProgramInfoLog(id, length, nullptr, log.data());
+	else
+		ge::gl::glGetShaderInfoLog(id, length, nullptr, log.data());
+
+	return std::string(log.data());
+}
@@ -0,0 +1,100 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* KernelCache.h
+*/
+
+#pragma once
+
+#include <geGL/geGL.h>
+#include <geGL/StaticCalls.h>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Extension of files with program binaries (stored next to kernel sources)
+#define KERNEL_CACHE_EXTENSION ".rtkb"
+
+// Version of binary file format, older files are rebuilt
+#define KERNEL_CACHE_VERSION 1
+
+namespace ge {
+	namespace sg {
+
+		/**
+		* @brief Compiles compute kernels and caches their program binaries on disk (glGetProgramBinary)
+		* @note Binary is valid only for the same source, defines and driver, otherwise kernel is compiled again
+		*/
+		class KernelCache {
+
+		public:
+
+			/**
+			* @brief Loads compute program - from binary file if it is valid, else from source
+			* @param file Path to kernel source
+			* @param defines Defines inserted after version directive
+			* @return Linked program, nullptr if compilation failed
+			*/
+			static std::shared_ptr<ge::gl::Program> load(std::string file, std::string defines);
+
+			/**
+			* @brief Sets integer uniform of program (program does not have to be bound)
+			* @param program Compute program
+			* @param name Name of uniform
+			* @param value New value
+			*/
+			static void set(const std::shared_ptr<ge::gl::Program>& program, const char* name, int value);
+
+			/**
+			* @brief Sets vector uniform of program (program does not have to be bound)
+			* @param program Compute program
+			* @param name Name of uniform
+			* @param value New value
+			*/
+			static void set(const std::shared_ptr<ge::gl::Program>& program, const char* name, glm::vec3 value);
+
+		private:
+
+			/**
+			* @brief Reads program binary and links program from it
+			* @param path Path to binary file
+			* @param key Hash of source and driver
+			* @param program Output program
+			* @return true if binary is valid and program was linked
+			*/
+			static bool readBinary(std::string path, uint64_t key, std::shared_ptr<ge::gl::Program>& program);
+
+			/**
+			* @brief Writes binary of linked program
+			* @param path Path to binary file
+			* @param key Hash of source and driver
+			* @param program Linked program
+			*/
+			static void writeBinary(std::string path, uint64_t key, const std::shared_ptr<ge::gl::Program>& program);
+
+			/**
+			* @brief Checks link status of program
+			* @param program Program
+			* @return true if program is linked
+			*/
+			static bool linked(const std::shared_ptr<ge::gl::Program>& program);
+
+			/**
+			* @brief Reads info log of shader or program (compiler and linker messages)
+			* @param id GL name of shader or program
+			* @param program true if id is program
+			* @return Info log, empty if there are no messages
+			*/
+			static std::string infoLog(GLuint id, bool program);
+
+		};
+
+	}
+}
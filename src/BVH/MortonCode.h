@@ -0,0 +1,77 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* MortonCode.h
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <algorithm>
+
+// Supported lengths of morton codes (10 and 21 bits per axis)
+#define MORTON_CODE_BITS 30
+#define MORTON_CODE_BITS_64 63
+
+namespace ge {
+	namespace sg {
+
+		/**
+		* @brief Morton codes on CPU (bit interleaving of the same codes as GPU kernels)
+		*/
+		namespace MortonCode {
+
+			/**
+			* @brief Inserts two zero bits after each of 10 low bits
+			* @param x Value to expand
+			* @return Expanded value
+			*/
+			inline uint32_t expandBits(uint32_t x) {
+
+				x = (x * 0x00010001u) & 0xFF0000FFu;
+				x = (x * 0x00000101u) & 0x0F00F00Fu;
+				x = (x * 0x00000011u) & 0xC30C30C3u;
+				x = (x * 0x00000005u) & 0x49249249u;
+
+				return x;
+			}
+
+			/**
+			* @brief Inserts two zero bits after each of 21 low bits
+			* @param x Value to expand
+			* @return Expanded value
+			*/
+			inline uint64_t expandBits64(uint64_t x) {
+
+				x &= 0x1FFFFFull;
+				x = (x | x << 32) & 0x1F00000000FFFFull;
+				x = (x | x << 16) & 0x1F0000FF0000FFull;
+				x = (x | x << 8) & 0x100F00F00F00F00Full;
+				x = (x | x << 4) & 0x10C30C30C30C30C3ull;
+				x = (x | x << 2) & 0x1249249249249249ull;
+
+				return x;
+			}
+
+			/**
+			* @brief 63 bit morton code (21 bits per axis)
+			* @param coord Normalized coordinates (0 - 1)
+			* @return Morton code
+			*/
+			inline uint64_t code63(glm::vec3 coord) {
+
+				coord = glm::clamp(coord * 2097152.0f, glm::vec3(0.0f), glm::vec3(2097151.0f));
+
+				return expandBits64(static_cast<uint64_t>(coord.x)) << 2 | expandBits64(static_cast<uint64_t>(coord.y)) << 1 | expandBits64(static_cast<uint64_t>(coord.z));
+			}
+
+		}
+
+	}
+}
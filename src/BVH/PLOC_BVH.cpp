@@ -0,0 +1,266 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* PLOC_BVH.cpp
+*/
+
+#include <PLOC_BVH.h>
+#include <MortonCode.h>
+#include <RadixSort.h>
+#include <ThreadPool.h>
+#include <Profiler.h>
+
+#include <limits>
+#include <cstring>
+#include <utility>
+
+using BVHNode = ge::sg::BVH_Node<ge::sg::AABB>;
+
+/**
+* @brief Surface area of box
+*/
+static float area(const glm::vec3& min, const glm::vec3& max){
+
+	glm::vec3 d = max - min;
+
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+void ge::sg::PLOC_BVH::build() {
+
+	PROFILE_ZONE("PLOC build");
+
+	unsigned count = static_cast<unsigned>(_lastPrimitive - _firstPrimitive);
+
+	clusters.clear();
+	rootNode = nullptr;
+
+	if (count == 0) {
+		ge::sg::AABB bvol;
+		rootNode = std::make_shared<BVHNode>(bvol, _firstPrimitive, _firstPrimitive);
+		return;
+	}
+
+	// Leaf clusters with one triangle
+	clusters.resize(count);
+	glm::vec3 centerMin(std::numeric_limits<float>::max()), centerMax(-std::numeric_limits<float>::max());
+
+	{
+		PROFILE_ZONE("Leaf clusters");
+
+		for (unsigned i = 0; i < count; i++) {
+
+			auto t = _firstPrimitive + static_cast<int>(i);
+			cluster& c = clusters[i];
+
+			c.min = glm::min(glm::make_vec3(t->v0), glm::min(glm::make_vec3(t->v1), glm::make_vec3(t->v2)));
+			c.max = glm::max(glm::make_vec3(t->v0), glm::max(glm::make_vec3(t->v1), glm::make_vec3(t->v2)));
+			c.left = c.right = -1;
+			c.triangle = i;
+			c.count = 1;
+
+			centerMin = glm::min(centerMin, (c.min + c.max) * 0.5f);
+			centerMax = glm::max(centerMax, (c.min + c.max) * 0.5f);
+		}
+	}
+
+	// Morton order of clusters
+	std::vector<uint64_t> codes(count);
+	std::vector<unsigned> sorted(count);
+	glm::vec3 extent = glm::max(centerMax - centerMin, glm::vec3(1e-6f));
+
+	{
+		PROFILE_ZONE("Morton order");
+
+		for (unsigned i = 0; i < count; i++) {
+			codes[i] = ge::sg::MortonCode::code63(((clusters[i].min + clusters[i].max) * 0.5f - centerMin) / extent);
+			sorted[i] = i;
+		}
+
+		ge::sg::RadixSort::sort(codes, sorted, MORTON_CODE_BITS_64);
+	}
+
+	std::vector<int> active(sorted.begin(), sorted.end()), next, nearest(count);
+	clusters.reserve(2 * count - 1);
+
+	ThreadPool pool(threads);
+
+	// Merging of mutual nearest neighbours until one cluster remains
+	{
+		PROFILE_ZONE("Merge clusters");
+
+		while (active.size() > 1) {
+
+			std::vector<std::future<void>> tasks;
+
+			for (size_t begin = 0; begin < active.size(); begin += PLOC_TASK_SIZE)
+				tasks.push_back(pool.submit([this, &active, &nearest, begin]() {
+					findNearest(active, nearest, begin, std::min(begin + PLOC_TASK_SIZE, active.size()));
+				}));
+
+			for (auto& t : tasks)
+				t.wait();
+
+			// Merged cluster replaces the first cluster of pair, order of clusters is kept
+			next.clear();
+
+			for (size_t i = 0; i < active.size(); i++) {
+
+				int n = nearest[i];
+
+				if (nearest[n] != static_cast<int>(i)) {
+					next.push_back(active[i]);
+					continue;
+				}
+
+				if (static_cast<int>(i) > n)
+					continue;
+
+				cluster c;
+				const cluster& a = clusters[active[i]];
+				const cluster& b = clusters[active[n]];
+
+				c.min = glm::min(a.min, b.min);
+				c.max = glm::max(a.max, b.max);
+				c.left = active[i];
+				c.right = active[n];
+				c.triangle = 0;
+				c.count = a.count + b.count;
+
+				clusters.push_back(c);
+				next.push_back(static_cast<int>(clusters.size()) - 1);
+			}
+
+			active.swap(next);
+		}
+	}
+
+	// BVH nodes and primitives in order of leaves
+	PROFILE_ZONE("Create nodes");
+
+	std::vector<unsigned> order;
+	order.reserve(count);
+
+	rootNode = createNodes(active[0], 0, order);
+	reorderPrimitives(order);
+
+}
+
+void ge::sg::PLOC_BVH::setSearchRadius(unsigned radius) {
+	searchRadius = std::max(1u, radius);
+}
+
+std::shared_ptr<BVHNode> ge::sg::PLOC_BVH::getRoot() {
+	return rootNode;
+}
+
+void ge::sg::PLOC_BVH::findNearest(const std::vector<int>& active, std::vector<int>& nearest, size_t begin, size_t end) {
+
+	int size = static_cast<int>(active.size());
+	int radius = static_cast<int>(searchRadius);
+
+	for (size_t i = begin; i < end; i++) {
+
+		int self = static_cast<int>(i);
+		const cluster& a = clusters[active[i]];
+
+		float best = std::numeric_limits<float>::max();
+		int bestIndex = -1;
+
+		// Ties are resolved by position, so the globally nearest pair is always mutual
+		for (int j = std::max(0, self - radius); j <= std::min(size - 1, self + radius); j++) {
+
+			if (j == self)
+				continue;
+
+			const cluster& b = clusters[active[j]];
+			float d = area(glm::min(a.min, b.min), glm::max(a.max, b.max));
+
+			if (d < best || (d == best && std::make_pair(std::min(self, j), std::max(self, j)) < std::make_pair(std::min(self, bestIndex), std::max(self, bestIndex)))) {
+				best = d;
+				bestIndex = j;
+			}
+		}
+
+		nearest[i] = bestIndex;
+	}
+
+}
+
+std::shared_ptr<BVHNode> ge::sg::PLOC_BVH::createNodes(int c, unsigned offset, std::vector<unsigned>& order) {
+
+	std::shared_ptr<BVHNode> root;
+
+	// Left child is on top of stack, leaves are visited in order of primitives
+	std::vector<pendingCluster> stack = { { c, offset, &root } };
+
+	while (!stack.empty()) {
+
+		pendingCluster p = stack.back();
+		stack.pop_back();
+
+		const cluster& cl = clusters[p.cluster];
+
+		ge::sg::AABB bvol;
+		bvol.min = cl.min;
+		bvol.max = cl.max;
+
+		auto node = std::make_shared<BVHNode>(bvol, _firstPrimitive + static_cast<int>(p.offset), _firstPrimitive + static_cast<int>(p.offset + cl.count));
+		node->left = nullptr, node->right = nullptr;
+		*p.slot = node;
+
+		// Leaf - triangles of whole cluster
+		if (cl.left == -1 || cl.count < minVolumePrimitives) {
+
+			std::vector<int> triangles = { p.cluster };
+
+			while (!triangles.empty()) {
+				const cluster& s = clusters[triangles.back()];
+				triangles.pop_back();
+
+				if (s.left == -1)
+					order.push_back(s.triangle);
+				else {
+					triangles.push_back(s.right);
+					triangles.push_back(s.left);
+				}
+			}
+
+			continue;
+		}
+
+		stack.push_back({ cl.right, p.offset + clusters[cl.left].count, &node->right });
+		stack.push_back({ cl.left, p.offset, &node->left });
+	}
+
+	return root;
+}
+
+void ge::sg::PLOC_BVH::reorderPrimitives(const std::vector<unsigned>& order) {
+
+	// Indexed geometry - indices of triangles are reordered
+	if (_firstPrimitive.getIndices() != nullptr) {
+
+		unsigned* indices = _firstPrimitive.getIndices();
+		std::vector<unsigned> temp(indices, indices + 3 * order.size());
+
+		for (size_t i = 0; i < order.size(); i++)
+			std::memcpy(indices + 3 * i, temp.data() + 3 * order[i], 3 * sizeof(unsigned));
+	}
+
+	// Continuous geometry - coordinates are reordered
+	else {
+
+		size_t stride = 3 * _firstPrimitive.getN();
+		float* data = _firstPrimitive->v0;
+		std::vector<float> temp(data, data + stride * order.size());
+
+		for (size_t i = 0; i < order.size(); i++)
+			std::memcpy(data + stride * i, temp.data() + stride * order[i], stride * sizeof(float));
+	}
+
+}
@@ -0,0 +1,113 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* PLOC_BVH.h
+*/
+
+#pragma once
+
+#include <GeneralCPUBVH.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <geSG/AABB.h>
+
+#include <BVH_Node.h>
+
+#include <memory>
+#include <vector>
+
+// Number of clusters searched on each side of cluster for its nearest neighbour
+#define PLOC_SEARCH_RADIUS 16
+
+// Number of clusters processed by one task of nearest neighbour search
+#define PLOC_TASK_SIZE 4096
+
+namespace ge {
+	namespace sg {
+
+		/*
+		* BVH structure built by parallel locally-ordered clustering (PLOC) with AABB bounding volumes
+		* Primitives are sorted by morton codes of centroids, then nearest neighbours within search radius are merged bottom-up
+		*/
+		class PLOC_BVH : public GeneralCPUBVH {
+
+		public:
+
+			// AABB node
+			using BVHNode = ge::sg::BVH_Node<ge::sg::AABB>;
+
+			/*
+			* Function, which start hierarchy build
+			*/
+			void build() override;
+
+			/*
+			* Set number of clusters searched on each side for nearest neighbour
+			*/
+			void setSearchRadius(unsigned radius);
+
+			/*
+			* Returns pointer to root node of BVH
+			*/
+			std::shared_ptr<BVHNode> getRoot();
+
+			// Root node of BVH
+			std::shared_ptr<BVHNode> rootNode;
+
+			// Search radius of nearest neighbour
+			unsigned searchRadius = PLOC_SEARCH_RADIUS;
+
+			/*
+			* Cluster of primitives (leaf with one triangle or merged pair of clusters)
+			*/
+			typedef struct {
+				glm::vec3 min, max;
+				int left, right;
+				unsigned triangle;
+				unsigned count;
+			} cluster;
+
+			/*
+			* Cluster waiting for creation of its node (slot is left or right pointer of parent node)
+			*/
+			typedef struct {
+				int cluster;
+				unsigned offset;
+				std::shared_ptr<BVHNode>* slot;
+			} pendingCluster;
+
+			// All clusters created during build (leaves first)
+			std::vector<cluster> clusters;
+
+			/*
+			* Finds nearest neighbour (the smallest merged surface area) of every cluster in range
+			* active - indices of active clusters
+			* nearest - output positions of nearest neighbours in active clusters
+			* begin, end - range of processed clusters
+			*/
+			void findNearest(const std::vector<int>& active, std::vector<int>& nearest, size_t begin, size_t end);
+
+			/*
+			* Creates BVH nodes of cluster hierarchy, clusters with less than minimum primitives become leaves (iterative, hierarchy can be deep)
+			* c - index of cluster
+			* offset - position of first primitive of cluster in reordered primitives
+			* order - output triangles in order of leaves
+			*/
+			std::shared_ptr<BVHNode> createNodes(int c, unsigned offset, std::vector<unsigned>& order);
+
+			/*
+			* Reorders primitives into order of leaves
+			* order - triangles in order of leaves
+			*/
+			void reorderPrimitives(const std::vector<unsigned>& order);
+
+		};
+
+	}
+}
@@ -0,0 +1,79 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* RadixSort.cpp
+*/
+
+#include "RadixSort.h"
+
+#include <algorithm>
+
+unsigned ge::sg::RadixSort::passes(unsigned keyBits){
+	return (keyBits + RADIX_SORT_BITS - 1) / RADIX_SORT_BITS;
+}
+
+unsigned ge::sg::RadixSort::blocks(unsigned count){
+	return (count + RADIX_SORT_BLOCK - 1) / RADIX_SORT_BLOCK;
+}
+
+unsigned ge::sg::RadixSort::scanTiles(unsigned blocks){
+	return (RADIX_SORT_SIZE * blocks + RADIX_SORT_SCAN_TILE - 1) / RADIX_SORT_SCAN_TILE;
+}
+
+void ge::sg::RadixSort::sort(std::vector<uint64_t>& keys, std::vector<unsigned>& values, unsigned keyBits){
+
+	std::vector<uint64_t> tmpKeys(keys.size());
+	std::vector<unsigned> tmpValues(values.size());
+	std::vector<unsigned> offsets(RADIX_SORT_SIZE * blocks(static_cast<unsigned>(keys.size())));
+
+	unsigned count = passes(keyBits);
+
+	// Ping-pong between input and temporary vectors
+	for (unsigned i = 0; i < count; i++) {
+		if (i % 2 == 0)
+			pass(keys, values, tmpKeys, tmpValues, i * RADIX_SORT_BITS, offsets);
+		else
+			pass(tmpKeys, tmpValues, keys, values, i * RADIX_SORT_BITS, offsets);
+	}
+
+	if (count % 2 == 1) {
+		keys.swap(tmpKeys);
+		values.swap(tmpValues);
+	}
+
+}
+
+void ge::sg::RadixSort::pass(const std::vector<uint64_t>& inKeys, const std::vector<unsigned>& inValues, std::vector<uint64_t>& outKeys, std::vector<unsigned>& outValues, unsigned shift, std::vector<unsigned>& offsets){
+
+	unsigned size = static_cast<unsigned>(inKeys.size());
+	unsigned numBlocks = blocks(size);
+
+	// --Histogram-- (digit-major order, same as on GPU)
+	std::fill(offsets.begin(), offsets.end(), 0);
+
+	for (unsigned i = 0; i < size; i++)
+		offsets[((inKeys[i] >> shift) & (RADIX_SORT_SIZE - 1)) * numBlocks + i / RADIX_SORT_BLOCK]++;
+
+	// --Prefix sum--
+	unsigned sum = 0;
+
+	for (auto& o : offsets) {
+		unsigned value = o;
+		o = sum;
+		sum += value;
+	}
+
+	// --Reorder-- (elements of block are visited in order, offset of digit is rank in block)
+	for (unsigned i = 0; i < size; i++) {
+		unsigned& offset = offsets[((inKeys[i] >> shift) & (RADIX_SORT_SIZE - 1)) * numBlocks + i / RADIX_SORT_BLOCK];
+
+		outKeys[offset] = inKeys[i];
+		outValues[offset] = inValues[i];
+		offset++;
+	}
+
+}
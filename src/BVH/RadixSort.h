@@ -0,0 +1,82 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* RadixSort.h
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Number of bits of one digit (has to match parallelRadixSort.cs)
+#define RADIX_SORT_BITS 4
+#define RADIX_SORT_SIZE (1 << RADIX_SORT_BITS)
+
+// Number of elements processed by one block (workgroup size of parallelRadixSort.cs)
+#define RADIX_SORT_BLOCK 256
+
+// Number of histogram entries scanned by one workgroup in prefix sum (SCAN_TILE of parallelRadixSort.cs)
+#define RADIX_SORT_SCAN_TILE 4096
+
+namespace ge {
+	namespace sg {
+
+		/**
+		* @brief CPU implementation of block radix sort used on GPU (block histograms, digit-major prefix sum, stable scatter)
+		* @note Serves as reference for validation of GPU sort, results of both implementations have to be identical
+		*/
+		class RadixSort {
+
+		public:
+
+			/**
+			* @brief Getter for number of passes needed for sorting of keys
+			* @param keyBits Number of valid bits of keys
+			* @return Number of passes (one digit per pass)
+			*/
+			static unsigned passes(unsigned keyBits);
+
+			/**
+			* @brief Getter for number of blocks of given amount of elements
+			* @param count Number of elements
+			* @return Number of blocks (workgroups)
+			*/
+			static unsigned blocks(unsigned count);
+
+			/**
+			* @brief Getter for number of scan tiles of block histograms (workgroups of prefix sum on GPU)
+			* @param blocks Number of blocks
+			* @return Number of tiles
+			*/
+			static unsigned scanTiles(unsigned blocks);
+
+			/**
+			* @brief Sorts keys and values by keys
+			* @param keys Keys (morton codes, 30 or 63 bits)
+			* @param values Values moved with keys (triangle indices)
+			* @param keyBits Number of valid bits of keys
+			*/
+			static void sort(std::vector<uint64_t>& keys, std::vector<unsigned>& values, unsigned keyBits);
+
+		private:
+
+			/**
+			* @brief One pass of sort (one digit)
+			* @param inKeys Input keys
+			* @param inValues Input values
+			* @param outKeys Output keys
+			* @param outValues Output values
+			* @param shift Position of digit in keys
+			* @param offsets Helper vector for histograms of blocks
+			*/
+			static void pass(const std::vector<uint64_t>& inKeys, const std::vector<unsigned>& inValues, std::vector<uint64_t>& outKeys, std::vector<unsigned>& outValues, unsigned shift, std::vector<unsigned>& offsets);
+
+		};
+
+	}
+}
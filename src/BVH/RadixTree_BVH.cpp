@@ -9,49 +9,86 @@
 */
 
 #include <RadixTree_BVH.h>
-//#define GPU_BVH_MEASURE
+#include <TreeletOptimizer.h>
 
 void ge::sg::RadixTree_BVH::build(){
 
+	built = false;
+
 	// Initialization
-	initGPUObjects();
-	init();
+	if (!initGPUObjects() || !init()) {
+		std::cout << "GPU BVH cannot be built without kernels" << std::endl;
+		return;
+	}
 
 	// An building of BVH
 	computeMortonCodes();	// compute morton codes
 	sortMortonCodes();		// sort morton codes
 	buildRadixTree();		// build radix tree based on sorted morton codes
 
+	nodeFormat = BVH_NODES_RADIX_TREE;
+	nodeCount = triangleCount > 1 ? triangleCount - 1 : 0;
+
+	if (treeletOptimization)
+		optimizeTreelets();	// optimize tree on CPU
+
+	built = true;
 }
 
 std::shared_ptr<ge::gl::Buffer> ge::sg::RadixTree_BVH::getNodes(){
 	return bvhNodes;
 }
 
-void ge::sg::RadixTree_BVH::init(){
+int ge::sg::RadixTree_BVH::getNodeFormat(){
+	return nodeFormat;
+}
+
+void ge::sg::RadixTree_BVH::readNodes(std::vector<bvh_node>& nodes, std::vector<unsigned>& indices){
+
+	nodes.resize(nodeCount);
+	indices.resize(triangleCount);
+
+	if (!nodes.empty())
+		bvhNodes->getData(nodes.data(), nodes.size() * sizeof(bvh_node), 0);
 
-	// Buffer containing BVH nodes
-	bvhNodes = std::make_shared<ge::gl::Buffer>(sizeof(bvh_node) * ((inputData.size() / 9) - 1));
-	bvhNodes->setData(nullptr);
+	if (!indices.empty())
+		indicesBuffer->getData(indices.data(), indices.size() * sizeof(unsigned), 0);
 
-	// Shader for BVH build
-	auto treeShader = std::make_shared<ge::gl::Shader>(GL_COMPUTE_SHADER, ge::core::loadTextFile(TREE_KERNEL));
-	bvhKernel = std::make_shared<ge::gl::Program>(treeShader);
+}
+
+void ge::sg::RadixTree_BVH::setTreeletOptimization(bool enable){
+	treeletOptimization = enable;
+}
 
+void ge::sg::RadixTree_BVH::setThreadPool(std::shared_ptr<ThreadPool> threads){
+	pool = threads;
+}
+
+bool ge::sg::RadixTree_BVH::init(){
+
+	// Buffer containing BVH nodes (kept between builds, grows with buffers of triangles)
+	GLsizeiptr nodesSize = sizeof(bvh_node) * (std::max(capacity, 2u) - 1);
+
+	if (bvhNodes == nullptr || bvhNodes->getSize() < nodesSize) {
+		bvhNodes = GPUMemory::createBuffer(AllocationCounter::BVH, nodesSize);
+		bvhNodes->setData(nullptr);
+	}
+
+	// Shader for BVH build (compiled once, program binary is cached on disk)
+	if (bvhKernel == nullptr || treeKernelBits != mortonCodeBits) {
+		bvhKernel = ge::sg::KernelCache::load(TREE_KERNEL, kernelDefines());
+		treeKernelBits = mortonCodeBits;
+	}
+
+	return bvhKernel != nullptr;
 }
 
 void ge::sg::RadixTree_BVH::buildRadixTree(){
 
-	unsigned count = inputData.size() / 9;
+	unsigned count = triangleCount;
 
-#ifdef GPU_BVH_MEASURE
-	GLuint query;
-	int done = 0;
-	GLuint64 elapsed_time;
-	
-	ge::gl::glGenQueries(1, &query);
-	ge::gl::glBeginQuery(GL_TIME_ELAPSED, query);
-#endif // GPU_BVH_MEASURE
+	if (timer != nullptr)
+		timer->begin("BVH build");
 
 	// --- Phase 3 - Structure build ---
 
@@ -65,13 +102,13 @@ void ge::sg::RadixTree_BVH::buildRadixTree(){
 	GLint wgs[3];
 	bvhKernel->getComputeWorkGroupSize(wgs);
 
-	bvhKernel->set1i("size", count - 1);
-	bvhKernel->set1i("phase", 0);
+	ge::sg::KernelCache::set(bvhKernel, "size", count - 1);
+	ge::sg::KernelCache::set(bvhKernel, "phase", 0);
 
 	ge::gl::glDispatchCompute((int)ceil((count) / static_cast<float>(wgs[0])), 1, 1);
 	ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-	bvhKernel->set1i("phase", 1);
+	ge::sg::KernelCache::set(bvhKernel, "phase", 1);
 	
 	ge::gl::glDispatchCompute((int)ceil((count) / static_cast<float>(wgs[0])), 1, 1);
 	ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
@@ -83,16 +120,41 @@ void ge::sg::RadixTree_BVH::buildRadixTree(){
 	indicesBuffer->unbindBase(GL_SHADER_STORAGE_BUFFER, 12);
 	verticesBuffer->unbindBase(GL_SHADER_STORAGE_BUFFER, 10);
 
-#ifdef GPU_BVH_MEASURE
-	ge::gl::glEndQuery(GL_TIME_ELAPSED);
+	if (timer != nullptr)
+		timer->end();
+
+}
+
+void ge::sg::RadixTree_BVH::optimizeTreelets(){
+
+	// Radix tree and sorted indices from GPU
+	std::vector<bvh_node> nodes(triangleCount > 1 ? triangleCount - 1 : 0);
+	std::vector<unsigned> indices(triangleCount);
+
+	bvhNodes->getData(nodes.data(), nodes.size() * sizeof(bvh_node), 0);
+	indicesBuffer->getData(indices.data(), indices.size() * sizeof(unsigned), 0);
+
+	if (pool == nullptr)
+		pool = std::make_shared<ThreadPool>();
+
+	TreeletOptimizer optimizer(geometry);
+	optimizer.optimize(nodes, indices, *pool);
+
+	std::cout << "Treelet optimization SAH " << optimizer.getInitialSAH() << " -> " << optimizer.getOptimizedSAH() << std::endl;
+
+	// Optimized tree has explicit leaves, buffer of nodes grows only if they do not fit
+	GLsizeiptr nodesSize = nodes.size() * sizeof(bvh_node);
+
+	if (bvhNodes->getSize() < nodesSize)
+		bvhNodes = GPUMemory::createBuffer(AllocationCounter::BVH, sizeof(bvh_node) * (2 * std::max(capacity, 1u) - 1));
 
-	while (!done)
-		ge::gl::glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &done);
+	// Indices in order of leaves replace sorted indices
+	bvhNodes->setData(nodes.data(), nodesSize, 0);
 
-	done = 0;
-	ge::gl::glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
+	if (!indices.empty())
+		indicesBuffer->setData(indices.data(), indices.size() * sizeof(unsigned), 0);
 
-	std::cout << "BVH build " << (elapsed_time / 1000000) << "ms" << std::endl;
-#endif // GPU_BVH_MEASURE
+	nodeFormat = BVH_NODES_INDEXED_RANGES;
+	nodeCount = nodes.size();
 
 }
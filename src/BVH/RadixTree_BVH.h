@@ -11,6 +11,12 @@
 #pragma once
 
 #include <GeneralGPUBVH.h>
+#include <ThreadPool.h>
+
+// Formats of BVH nodes (nodeFormat of trace shader, independent of BVH_TYPE_* of UI)
+#define BVH_NODES_RANGES 0				// Nodes of CPU BVH and clusters, leaves reference ranges of sorted triangles
+#define BVH_NODES_RADIX_TREE 1			// Nodes of radix tree, triangleA/triangleB index sorted triangle indices
+#define BVH_NODES_INDEXED_RANGES 2		// Leaves reference ranges of triangle indices, inner nodes store bounds of children (optimized radix tree)
 
 namespace ge{
 	namespace sg {
@@ -33,7 +39,7 @@ namespace ge{
 				int right;
 				int triangleA;
 				int triangleB;
-				glm::ivec4 ad;
+				glm::ivec4 ad;		// Parent, sibling, build counter (bounds of children on z axis in ranges format), split axis
 			} bvh_node;
 
 			/*
@@ -47,12 +53,38 @@ namespace ge{
 			*/
 			std::shared_ptr<ge::gl::Buffer> getNodes();
 
+			/*
+			* @brief Getter for format of BVH nodes
+			* @return BVH_NODES_RADIX_TREE or BVH_NODES_INDEXED_RANGES (treelet optimization)
+			*/
+			int getNodeFormat();
+
+			/*
+			* @brief Reads BVH nodes and indices of triangles back from GPU (blocking, for analysis of built tree)
+			* @param nodes Output vector of nodes
+			* @param indices Output vector of triangle indices in order of leaves
+			*/
+			void readNodes(std::vector<bvh_node>& nodes, std::vector<unsigned>& indices);
+
+			/*
+			* @brief Enables treelet optimization of built radix tree (on CPU)
+			* @param enable true if tree is optimized after build
+			*/
+			void setTreeletOptimization(bool enable);
+
+			/*
+			* @brief Sets worker threads for treelet optimization (pool of BVH is created on first use otherwise)
+			* @param threads Pool shared with application, it is reused by every build
+			*/
+			void setThreadPool(std::shared_ptr<ThreadPool> threads);
+
 		//private:
 
 			/*
 			* @brief Initialization of build objects
+			* @return false if kernel could not be loaded
 			*/
-			void init();
+			bool init();
 
 			/*
 			* @brief Implementation of radix tree building process, in first phase it builds radix tree structure on sorted morton codes
@@ -60,8 +92,18 @@ namespace ge{
 			*/
 			void buildRadixTree();
 
+			/*
+			* @brief Reads radix tree back, restructures treelets and collapses leaves by SAH, uploads optimized tree
+			*/
+			void optimizeTreelets();
+
 			std::shared_ptr<ge::gl::Buffer> bvhNodes;	// Buffer with BVH nodes
 			std::shared_ptr<ge::gl::Program> bvhKernel;	// Shader for BVH build
+			unsigned treeKernelBits = 0;				// Length of morton codes of compiled shader
+			int nodeFormat = BVH_NODES_RADIX_TREE;		// Format of nodes in buffer
+			size_t nodeCount = 0;						// Number of valid nodes in buffer
+			bool treeletOptimization = false;			// Optimization of built tree
+			std::shared_ptr<ThreadPool> pool;			// Worker threads of treelet optimization
 
 		};
 
@@ -0,0 +1,464 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TreeletOptimizer.cpp
+*/
+
+#include "TreeletOptimizer.h"
+
+#include <bvhPreprocessor.h>
+
+#include <algorithm>
+#include <limits>
+
+void ge::sg::TreeletOptimizer::optimize(std::vector<RadixTree_BVH::bvh_node>& radixNodes, std::vector<unsigned>& indices, ThreadPool& pool){
+
+	convert(radixNodes, indices);
+	computeCosts();
+	initialSAH = sah();
+
+	for (int iteration = 0; iteration < TREELET_ITERATIONS && !nodes.empty(); iteration++) {
+
+		// Split tree into independent subtrees (treelets never cross their roots)
+		std::vector<char> top(nodes.size(), 0);
+		std::vector<int> cut = { root };
+
+		while (cut.size() < 4 * std::max(1u, std::thread::hardware_concurrency())) {
+
+			auto largest = std::max_element(cut.begin(), cut.end(), [&](int a, int b) { return nodes[a].count < nodes[b].count; });
+
+			if (nodes[*largest].count < TREELET_TASK_SIZE || nodes[*largest].left == -1)
+				break;
+
+			int n = *largest;
+			top[n] = 1;
+			*largest = nodes[n].left;
+			cut.push_back(nodes[n].right);
+		}
+
+		std::vector<std::future<void>> tasks;
+
+		for (int n : cut)
+			tasks.push_back(pool.submit([this, n]() { optimizeSubtree(n, nullptr); }));
+
+		for (auto& t : tasks)
+			t.wait();
+
+		// Nodes above subtrees
+		std::vector<char> stop(nodes.size(), 0);
+
+		for (int n : cut)
+			stop[n] = 1;
+
+		if (top[root])
+			optimizeSubtree(root, &stop);
+	}
+
+	collapse();
+	optimizedSAH = sah();
+
+	flatten(radixNodes, indices);
+
+}
+
+float ge::sg::TreeletOptimizer::getInitialSAH(){
+	return initialSAH;
+}
+
+float ge::sg::TreeletOptimizer::getOptimizedSAH(){
+	return optimizedSAH;
+}
+
+void ge::sg::TreeletOptimizer::convert(const std::vector<RadixTree_BVH::bvh_node>& radixNodes, const std::vector<unsigned>& indices){
+
+	int count = static_cast<int>(indices.size());
+	int inner = count > 1 ? count - 1 : 0;
+
+	nodes.assign(inner + count, node());
+
+	// Leaves with one triangle (after inner nodes, in order of sorted indices)
+	for (int i = 0; i < count; i++) {
+		node& n = nodes[inner + i];
+		n.left = n.right = n.parent = -1;
+		n.triangle = indices[i];
+	}
+
+	// Inner nodes, children are nodes or triangles of radix tree
+	for (int i = 0; i < inner; i++) {
+		node& n = nodes[i];
+		const RadixTree_BVH::bvh_node& r = radixNodes[i];
+
+		n.left = r.left != -1 ? r.left : inner + r.triangleA;
+		n.right = r.right != -1 ? r.right : inner + r.triangleB;
+		n.triangle = -1;
+	}
+
+	for (int i = 0; i < inner; i++) {
+		nodes[nodes[i].left].parent = i;
+		nodes[nodes[i].right].parent = i;
+	}
+
+	root = count > 0 ? 0 : -1;
+
+	if (root != -1)
+		nodes[root].parent = -1;
+
+}
+
+void ge::sg::TreeletOptimizer::computeCosts(){
+
+	if (root == -1)
+		return;
+
+	std::vector<int> order;
+	postOrder(root, nullptr, order);
+
+	for (int i : order) {
+		node& n = nodes[i];
+		n.collapsed = false;
+
+		if (n.left == -1) {
+			n.min = n.max = glm::vec3(geometry.vertex(n.triangle, 0)[0], geometry.vertex(n.triangle, 0)[1], geometry.vertex(n.triangle, 0)[2]);
+
+			for (unsigned c = 1; c < 3; c++) {
+				const float* v = geometry.vertex(n.triangle, c);
+				n.min = glm::min(n.min, glm::vec3(v[0], v[1], v[2]));
+				n.max = glm::max(n.max, glm::vec3(v[0], v[1], v[2]));
+			}
+
+			n.count = 1;
+			n.cost = TREELET_COST_TRIANGLE * area(n.min, n.max);
+		}
+		else {
+			const node& l = nodes[n.left];
+			const node& r = nodes[n.right];
+
+			n.min = glm::min(l.min, r.min);
+			n.max = glm::max(l.max, r.max);
+			n.count = l.count + r.count;
+			n.cost = TREELET_COST_NODE * area(n.min, n.max) + l.cost + r.cost;
+		}
+	}
+
+}
+
+void ge::sg::TreeletOptimizer::postOrder(int root, const std::vector<char>* stop, std::vector<int>& order){
+
+	std::vector<std::pair<int, bool>> stack = { { root, false } };
+
+	while (!stack.empty()) {
+
+		auto top = stack.back();
+		stack.pop_back();
+
+		if (top.second || nodes[top.first].left == -1) {
+			order.push_back(top.first);
+			continue;
+		}
+
+		stack.push_back({ top.first, true });
+
+		for (int child : { nodes[top.first].right, nodes[top.first].left })
+			if (stop == nullptr || !(*stop)[child])
+				stack.push_back({ child, false });
+	}
+
+}
+
+void ge::sg::TreeletOptimizer::optimizeSubtree(int root, const std::vector<char>* stop){
+
+	std::vector<int> order;
+	postOrder(root, stop, order);
+
+	// Children are optimized before their parents
+	for (int i : order) {
+		if (nodes[i].count >= TREELET_LEAVES)
+			optimizeTreelet(i);
+	}
+
+}
+
+void ge::sg::TreeletOptimizer::optimizeTreelet(int root){
+
+	int leaves[TREELET_LEAVES], internals[TREELET_LEAVES - 1];
+	int leafCount = 2, internalCount = 1;
+
+	leaves[0] = nodes[root].left;
+	leaves[1] = nodes[root].right;
+	internals[0] = root;
+
+	// Treelet formation - leaf with the largest surface area is expanded
+	while (leafCount < TREELET_LEAVES) {
+
+		int best = -1;
+		float bestArea = -1.0f;
+
+		for (int i = 0; i < leafCount; i++) {
+			const node& n = nodes[leaves[i]];
+			float a = area(n.min, n.max);
+
+			if (n.left != -1 && a > bestArea) {
+				bestArea = a;
+				best = i;
+			}
+		}
+
+		if (best == -1)
+			break;
+
+		int expanded = leaves[best];
+		internals[internalCount++] = expanded;
+		leaves[best] = nodes[expanded].left;
+		leaves[leafCount++] = nodes[expanded].right;
+	}
+
+	if (leafCount < 3)
+		return;
+
+	// Surface areas and optimal costs of all subsets of leaves
+	const unsigned subsets = 1u << leafCount;
+	glm::vec3 subsetMin[1 << TREELET_LEAVES], subsetMax[1 << TREELET_LEAVES];
+	float cost[1 << TREELET_LEAVES];
+	unsigned partition[1 << TREELET_LEAVES];
+
+	for (unsigned s = 1; s < subsets; s++) {
+
+		subsetMin[s] = glm::vec3(std::numeric_limits<float>::max());
+		subsetMax[s] = glm::vec3(-std::numeric_limits<float>::max());
+
+		for (int i = 0; i < leafCount; i++) {
+			if (s & (1u << i)) {
+				subsetMin[s] = glm::min(subsetMin[s], nodes[leaves[i]].min);
+				subsetMax[s] = glm::max(subsetMax[s], nodes[leaves[i]].max);
+			}
+		}
+	}
+
+	for (int i = 0; i < leafCount; i++)
+		cost[1u << i] = nodes[leaves[i]].cost;
+
+	// Subsets of a set have lower value, they are solved first
+	for (unsigned s = 1; s < subsets; s++) {
+
+		if ((s & (s - 1)) == 0)
+			continue;
+
+		float best = std::numeric_limits<float>::max();
+
+		for (unsigned p = (s - 1) & s; p > 0; p = (p - 1) & s) {
+			float c = cost[p] + cost[s ^ p];
+
+			if (c < best) {
+				best = c;
+				partition[s] = p;
+			}
+		}
+
+		cost[s] = TREELET_COST_NODE * area(subsetMin[s], subsetMax[s]) + best;
+	}
+
+	if (cost[subsets - 1] >= nodes[root].cost)
+		return;
+
+	// Reconstruction of treelet, internal nodes are reused (root stays in place)
+	int nextInternal = 1;
+	std::vector<std::pair<unsigned, int>> stack = { { subsets - 1, root } };
+	std::vector<std::pair<unsigned, int>> built;
+
+	while (!stack.empty()) {
+
+		auto top = stack.back();
+		stack.pop_back();
+		built.push_back(top);
+
+		unsigned parts[2] = { partition[top.first], top.first ^ partition[top.first] };
+		int children[2];
+
+		for (int c = 0; c < 2; c++) {
+
+			if ((parts[c] & (parts[c] - 1)) == 0) {
+				int bit = 0;
+				while (!(parts[c] & (1u << bit)))
+					bit++;
+				children[c] = leaves[bit];
+			}
+			else {
+				children[c] = internals[nextInternal++];
+				stack.push_back({ parts[c], children[c] });
+			}
+
+			nodes[children[c]].parent = top.second;
+		}
+
+		nodes[top.second].left = children[0];
+		nodes[top.second].right = children[1];
+	}
+
+	// Internal nodes in reverse order of construction - children before parents
+	for (auto it = built.rbegin(); it != built.rend(); ++it) {
+		node& n = nodes[it->second];
+
+		n.min = subsetMin[it->first];
+		n.max = subsetMax[it->first];
+		n.count = nodes[n.left].count + nodes[n.right].count;
+		n.cost = cost[it->first];
+	}
+
+}
+
+void ge::sg::TreeletOptimizer::collapse(){
+
+	if (root == -1)
+		return;
+
+	std::vector<int> order;
+	postOrder(root, nullptr, order);
+
+	for (int i : order) {
+		node& n = nodes[i];
+
+		if (n.left == -1)
+			continue;
+
+		// Children could collapse, cost of inner node includes their lower costs (root cost gives SAH after collapse)
+		n.cost = TREELET_COST_NODE * area(n.min, n.max) + nodes[n.left].cost + nodes[n.right].cost;
+
+		if (n.count > TREELET_MAX_LEAF_SIZE)
+			continue;
+
+		float leafCost = TREELET_COST_TRIANGLE * area(n.min, n.max) * n.count;
+
+		if (leafCost <= n.cost) {
+			n.cost = leafCost;
+			n.collapsed = true;
+		}
+	}
+
+}
+
+void ge::sg::TreeletOptimizer::flatten(std::vector<RadixTree_BVH::bvh_node>& radixNodes, std::vector<unsigned>& indices){
+
+	radixNodes.clear();
+	indices.clear();
+
+	RadixTree_BVH::bvh_node out;
+
+	// Empty geometry - one empty leaf
+	if (root == -1) {
+		out._min = out._max = glm::vec4(0.0f);
+		out.left = out.right = -1;
+		out.triangleA = 0;
+		out.triangleB = -1;
+		out.ad = glm::ivec4(-1, -1, 0, -1);
+		radixNodes.push_back(out);
+		return;
+	}
+
+	// Depth-first order, pairs of node and its parent in output (negative parent - right child)
+	std::vector<std::pair<int, int>> stack = { { root, 0 } };
+	std::vector<int> leafStack;
+
+	while (!stack.empty()) {
+
+		int i = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		const node& n = nodes[i];
+		int index = static_cast<int>(radixNodes.size());
+
+		out._min = glm::vec4(n.min, 0.0f);
+		out._max = glm::vec4(n.max, 0.0f);
+		out.left = out.right = -1;
+		out.triangleA = out.triangleB = -1;
+		out.ad = glm::ivec4(index == 0 ? -1 : std::abs(parent) - 1, -1, 0, -1);
+
+		if (index != 0) {
+			if (parent > 0)
+				radixNodes[parent - 1].left = index;
+			else
+				radixNodes[-parent - 1].right = index;
+		}
+
+		// Leaf - range of triangles of subtree
+		if (n.left == -1 || n.collapsed) {
+
+			out.triangleA = static_cast<int>(indices.size());
+			leafStack.push_back(i);
+
+			while (!leafStack.empty()) {
+				int l = leafStack.back();
+				leafStack.pop_back();
+
+				if (nodes[l].left == -1)
+					indices.push_back(nodes[l].triangle);
+				else {
+					leafStack.push_back(nodes[l].right);
+					leafStack.push_back(nodes[l].left);
+				}
+			}
+
+			out.triangleB = static_cast<int>(indices.size()) - 1;
+		}
+		else {
+			stack.push_back({ n.right, -(index + 1) });
+			stack.push_back({ n.left, index + 1 });
+		}
+
+		radixNodes.push_back(out);
+	}
+
+	// Siblings
+	for (auto& n : radixNodes) {
+		if (n.left != -1) {
+			radixNodes[n.left].ad.y = n.right;
+			radixNodes[n.right].ad.y = n.left;
+		}
+	}
+
+	// Split axis and bounds of children in inner nodes (the same encoding as bvhPreprocessor)
+	for (auto& n : radixNodes) {
+
+		if (n.left == -1)
+			continue;
+
+		glm::vec3 childMin[2] = { glm::vec3(radixNodes[n.left]._min), glm::vec3(radixNodes[n.right]._min) };
+		glm::vec3 childMax[2] = { glm::vec3(radixNodes[n.left]._max), glm::vec3(radixNodes[n.right]._max) };
+
+		int axis = bvhPreprocessor::splitAxis(childMin[0], childMax[0], childMin[1], childMax[1]);
+
+		if (childMin[0][axis] + childMax[0][axis] > childMin[1][axis] + childMax[1][axis]) {
+			std::swap(n.left, n.right);
+			std::swap(childMin[0], childMin[1]);
+			std::swap(childMax[0], childMax[1]);
+		}
+
+		glm::ivec3 planes = bvhPreprocessor::quantizeChildren(glm::vec3(n._min), glm::vec3(n._max), childMin, childMax);
+		n.triangleA = planes.x;
+		n.triangleB = planes.y;
+		n.ad.z = planes.z;
+		n.ad.w = axis;
+	}
+
+}
+
+float ge::sg::TreeletOptimizer::area(const glm::vec3& min, const glm::vec3& max){
+
+	glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+float ge::sg::TreeletOptimizer::sah(){
+
+	if (root == -1)
+		return 0.0f;
+
+	float a = area(nodes[root].min, nodes[root].max);
+
+	return a > 0.0f ? nodes[root].cost / a : nodes[root].cost;
+}
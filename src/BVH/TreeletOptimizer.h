@@ -0,0 +1,151 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TreeletOptimizer.h
+*/
+
+#pragma once
+
+#include <RadixTree_BVH.h>
+#include <GeometryView.h>
+#include <ThreadPool.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Number of leaves of optimized treelet (2^n subsets are evaluated for every treelet)
+#define TREELET_LEAVES 7
+
+// Number of optimization passes over whole tree
+#define TREELET_ITERATIONS 3
+
+// Maximum number of triangles in leaf created by collapsing
+#define TREELET_MAX_LEAF_SIZE 8
+
+// SAH costs of node traversal and triangle intersection
+#define TREELET_COST_NODE 1.2f
+#define TREELET_COST_TRIANGLE 1.0f
+
+// Minimum number of triangles of subtree optimized by separate task
+#define TREELET_TASK_SIZE 1024
+
+namespace ge {
+	namespace sg {
+
+		/**
+		* @brief Treelet restructuring of radix tree BVH (optimal topology of small treelets by SAH), runs on CPU in parallel
+		* @note Result is BVH with leaves referencing ranges of reordered triangle indices (BVH_NODES_INDEXED_RANGES)
+		*/
+		class TreeletOptimizer {
+
+		public:
+
+			/**
+			* @brief Constructor
+			* @param view Geometry of BVH (triangle bounds)
+			*/
+			TreeletOptimizer(const ge::sg::GeometryView& view) : geometry(view) {}
+
+			/**
+			* @brief Optimizes BVH built by radix tree and collapses leaves by SAH
+			* @param radixNodes Nodes of radix tree, replaced by optimized nodes
+			* @param indices Sorted triangle indices, replaced by indices in order of leaves
+			* @param pool Worker threads for optimization of independent subtrees
+			*/
+			void optimize(std::vector<RadixTree_BVH::bvh_node>& radixNodes, std::vector<unsigned>& indices, ThreadPool& pool);
+
+			/**
+			* @brief Getter for SAH cost of input tree (normalized by surface area of root)
+			* @return SAH cost
+			*/
+			float getInitialSAH();
+
+			/**
+			* @brief Getter for SAH cost of optimized tree (normalized by surface area of root)
+			* @return SAH cost
+			*/
+			float getOptimizedSAH();
+
+		private:
+
+			/**
+			* @brief Structure of binary tree node (triangle is valid in leaves only)
+			*/
+			typedef struct {
+				glm::vec3 min, max;
+				int left, right, parent;
+				int triangle;
+				unsigned count;
+				float cost;
+				bool collapsed;
+			} node;
+
+			/**
+			* @brief Converts radix tree into binary tree with one triangle in every leaf
+			* @param radixNodes Nodes of radix tree
+			* @param indices Sorted triangle indices
+			*/
+			void convert(const std::vector<RadixTree_BVH::bvh_node>& radixNodes, const std::vector<unsigned>& indices);
+
+			/**
+			* @brief Computes bounds, triangle counts and SAH costs of all nodes bottom-up
+			*/
+			void computeCosts();
+
+			/**
+			* @brief Collects nodes of subtree in post-order
+			* @param root Root of subtree
+			* @param stop Marks of nodes, which are not visited (nullptr - whole subtree)
+			* @param order Output nodes
+			*/
+			void postOrder(int root, const std::vector<char>* stop, std::vector<int>& order);
+
+			/**
+			* @brief Optimizes treelets rooted in all nodes of subtree (bottom-up)
+			* @param root Root of subtree
+			* @param stop Marks of nodes, which are not visited (nullptr - whole subtree)
+			*/
+			void optimizeSubtree(int root, const std::vector<char>* stop);
+
+			/**
+			* @brief Finds optimal topology of treelet by dynamic programming over subsets of its leaves
+			* @param root Root of treelet
+			*/
+			void optimizeTreelet(int root);
+
+			/**
+			* @brief Collapses subtrees into leaves where leaf has lower SAH cost
+			*/
+			void collapse();
+
+			/**
+			* @brief Converts binary tree into output nodes (depth-first order)
+			* @param radixNodes Output nodes
+			* @param indices Output triangle indices in order of leaves
+			*/
+			void flatten(std::vector<RadixTree_BVH::bvh_node>& radixNodes, std::vector<unsigned>& indices);
+
+			/**
+			* @brief Surface area of bounding box
+			*/
+			static float area(const glm::vec3& min, const glm::vec3& max);
+
+			/**
+			* @brief Normalized SAH cost of current tree
+			*/
+			float sah();
+
+			ge::sg::GeometryView geometry;
+			std::vector<node> nodes;
+			int root = -1;
+			float initialSAH = 0.0f, optimizedSAH = 0.0f;
+
+		};
+
+	}
+}
@@ -10,6 +10,13 @@
 
 #version 450
 
+// MORTON_CODE_64 (injected by host) selects 63 bit codes stored as two words (low, high)
+#ifdef MORTON_CODE_64
+#define MORTON_WORDS 2
+#else
+#define MORTON_WORDS 1
+#endif
+
 // Setup size of workgroup
 layout(local_size_x = 256, local_size_y = 1) in;
 
@@ -87,6 +94,27 @@ uint mortonCode(vec3 coord) {
 	return x * 4 + y * 2 + z;
 }
 
+/*
+* Computation of 63 bit moton code (21 bits per axis)
+*
+* coord - input coordinate (triangle centroid)
+* return low and high word of morton code of point coord
+*/
+uvec2 mortonCode64(vec3 coord) {
+
+	uvec3 c = uvec3(clamp(coord * 2097152.0f, vec3(0.0f), vec3(2097151.0f)));
+
+	// Bits 0 - 9 of axes fill bits 0 - 29 of code, bit 10 of axes is split between words
+	uvec3 low = c & 1023u;
+	uvec3 mid = (c >> 10) & 1u;
+	uvec3 high = c >> 11;
+
+	uint lo = (expandBits(low.x) * 4 + expandBits(low.y) * 2 + expandBits(low.z)) | (mid.y << 31) | (mid.z << 30);
+	uint hi = ((expandBits(high.x) * 4 + expandBits(high.y) * 2 + expandBits(high.z)) << 1) | mid.x;
+
+	return uvec2(lo, hi);
+}
+
 void main() {
 
 	uint threadID = gl_GlobalInvocationID.x;
@@ -102,10 +130,20 @@ void main() {
 
 	// Get center and compute morton code
 	vec3 center = normalizeCoord(computeCentroid(a, b, c));
-	uint mortonCode = mortonCode(center);
 
 	// Save morton code into input buffer (2 copies)
+#ifdef MORTON_CODE_64
+	uvec2 mortonCode = mortonCode64(center);
+
+	outMorton[2 * threadID] = mortonCode.x;
+	outMorton[2 * threadID + 1] = mortonCode.y;
+	outMorton[2 * (threadID + numberOfTriangles)] = mortonCode.x;
+	outMorton[2 * (threadID + numberOfTriangles) + 1] = mortonCode.y;
+#else
+	uint mortonCode = mortonCode(center);
+
 	outMorton[threadID] = mortonCode;
 	outMorton[threadID + numberOfTriangles] = mortonCode;
+#endif
 
 }
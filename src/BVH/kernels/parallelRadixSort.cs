@@ -11,17 +11,39 @@
 
 #version 450
 
-// Algorithm phases
+// Algorithm phases (prefix sum of histograms is reduce-then-scan over tiles of histogram entries)
 #define HISTOGRAM_PHASE 0
-#define SCAN_PHASE 1
-#define REORDER_PHASE 2
+#define SCAN_REDUCE_PHASE 1
+#define SCAN_TILE_SUMS_PHASE 2
+#define SCAN_DOWNSWEEP_PHASE 3
+#define REORDER_PHASE 4
+
+// Radix sort with 4-bit digits, every workgroup processes one block of elements
+#define BLOCK_SIZE 256
+#define RADIX_BITS 4
+#define RADIX_SIZE 16
+
+// Histogram entries scanned by one thread, one workgroup scans tile of BLOCK_SIZE * SCAN_ITEMS entries
+#define SCAN_ITEMS 16
+#define SCAN_TILE (BLOCK_SIZE * SCAN_ITEMS)
+
+// MORTON_CODE_64 (injected by host) selects 63 bit codes stored as two words (low, high)
+#ifdef MORTON_CODE_64
+#define MORTON_WORDS 2
+#else
+#define MORTON_WORDS 1
+#endif
+
+// Counters of 16 digits packed by two into 16-bit halves
+#define PACKED_COUNTERS 8
 
 // Setup workgroup size
-layout(local_size_x = 256, local_size_y = 1) in;
+layout(local_size_x = BLOCK_SIZE, local_size_y = 1) in;
 
-// Helper bucket for radix sort algorithm
+// Histograms of blocks (digit-major order - digit * numBlocks + block), scanned into global offsets
+// Sums of scan tiles follow histograms (RADIX_SIZE * numBlocks + tile)
 layout(std430, binding = 13) buffer histBuffer{
-    int bucket[];
+    uint bucket[];
 };
 
 // Input morton codes
@@ -34,76 +56,208 @@ layout(std430, binding = 12) buffer indexInBuffer{
     uint inIndices[];
 };
 
-uniform int base;
 uniform int phase;
 uniform int size;
+uniform int shift;
+uniform int numBlocks;
 uniform int inOffset;
 uniform int outOffset;
-uniform int delta;
-uniform int inBucket;
-uniform int outBucket;
+
+// Shared memory of workgroup
+shared uint histogram[RADIX_SIZE];
+shared uint counters[PACKED_COUNTERS][BLOCK_SIZE];
+shared uint scan[BLOCK_SIZE];
 
 /*
-* Find out, what bit is on current position and save into helper buffer
+* Digit of morton code in current pass
 *
-* index - index of processed morton code
+* index - index of morton code
 */
-void computeHistogram(int index){
-  bucket[(size * int((inMortons[inOffset + index] & base) == base)) + index] = 1;
+uint digit(int index){
+  return (inMortons[(inOffset + index) * MORTON_WORDS + (shift >> 5)] >> (shift & 31)) & (RADIX_SIZE - 1);
 }
 
 /*
-* Computes prefix sum of items in radix bucket
+* Counts digits of block in shared memory and stores histogram of block
 *
-* index - index of element for sum
+* index - index of element
+* local - index of element in block
 */
-void prefixSum(int index){
+void computeHistogram(int index, uint local){
 
-  if(index < delta){
-	bucket[outBucket + index] = bucket[inBucket + index];
-    return;
-	}
+  if(local < RADIX_SIZE)
+    histogram[local] = 0;
+
+  barrier();
+
+  if(index < size)
+    atomicAdd(histogram[digit(index)], 1);
+
+  barrier();
+
+  if(local < RADIX_SIZE)
+    bucket[local * numBlocks + gl_WorkGroupID.x] = histogram[local];
+
+}
+
+/*
+* Sum of one tile of histogram entries (reduce phase, one workgroup per tile)
+*
+* local - index of thread
+*/
+void reduceTile(uint local){
+
+  int count = RADIX_SIZE * numBlocks;
+  int first = int(gl_WorkGroupID.x) * SCAN_TILE + int(local) * SCAN_ITEMS;
+  uint total = 0;
+
+  for(int i = first; i < min(first + SCAN_ITEMS, count); i++)
+    total += bucket[i];
+
+  scan[local] = total;
+  barrier();
 
-  bucket[outBucket + index] = bucket[inBucket + index] + bucket[inBucket + index - delta];
+  for(uint stride = BLOCK_SIZE / 2; stride > 0; stride >>= 1){
+    if(local < stride)
+      scan[local] += scan[local + stride];
+    barrier();
+  }
+
+  if(local == 0)
+    bucket[count + gl_WorkGroupID.x] = scan[0];
 
 }
 
 /*
-* Reorder items on appropriate positions
+* Exclusive prefix sum of one tile in place, every thread scans SCAN_ITEMS consecutive entries
+*
+* first - index of first entry of tile
+* end - index behind last valid entry
+* offset - value added to all prefix sums (sum of previous tiles)
+* local - index of thread
 *
-* index - index of element for reorder
+* return sum of tile
 */
-void reorderElements(int index){
+uint scanTile(int first, int end, uint offset, uint local){
+
+  int begin = first + int(local) * SCAN_ITEMS;
+  uint values[SCAN_ITEMS];
+  uint total = 0;
+
+  for(int i = 0; i < SCAN_ITEMS; i++){
+    values[i] = begin + i < end ? bucket[begin + i] : 0;
+    total += values[i];
+  }
+
+  scan[local] = total;
+  barrier();
+
+  // Inclusive scan of sums of threads in shared memory
+  for(uint delta = 1; delta < BLOCK_SIZE; delta <<= 1){
+    uint sum = scan[local] + (local >= delta ? scan[local - delta] : 0);
+    barrier();
+    scan[local] = sum;
+    barrier();
+  }
+
+  uint prefix = offset + scan[local] - total;
+
+  for(int i = 0; i < SCAN_ITEMS && begin + i < end; i++){
+    bucket[begin + i] = prefix;
+    prefix += values[i];
+  }
+
+  uint sum = scan[BLOCK_SIZE - 1];
+  barrier();
+
+  return sum;
+}
+
+/*
+* Exclusive prefix sum of tile sums (one workgroup, tiles of sums with carry - one step for 16M histogram entries)
+*
+* local - index of thread
+*/
+void scanTileSums(uint local){
+
+  int count = RADIX_SIZE * numBlocks;
+  int end = count + (count + SCAN_TILE - 1) / SCAN_TILE;
+  uint carry = 0;
+
+  for(int first = count; first < end; first += SCAN_TILE)
+    carry += scanTile(first, end, carry, local);
+
+}
+
+/*
+* Stable scatter of elements into position given by global offset of digit and rank in block
+*
+* index - index of element
+* local - index of element in block
+*/
+void reorderElements(int index, uint local){
+
+  bool valid = index < size;
+  uint d = valid ? digit(index) : 0;
+
+  // One-hot counter of element digit
+  for(uint c = 0; c < PACKED_COUNTERS; c++)
+    counters[c][local] = (valid && (d >> 1) == c) ? (1u << (16 * (d & 1))) : 0;
+
+  barrier();
+
+  // Inclusive scan of packed counters - rank of element among elements with the same digit
+  for(uint delta = 1; delta < BLOCK_SIZE; delta <<= 1){
+
+    uint sums[PACKED_COUNTERS];
+
+    for(uint c = 0; c < PACKED_COUNTERS; c++)
+      sums[c] = counters[c][local] + (local >= delta ? counters[c][local - delta] : 0);
+
+    barrier();
+
+    for(uint c = 0; c < PACKED_COUNTERS; c++)
+      counters[c][local] = sums[c];
+
+    barrier();
+  }
+
+  if(!valid)
+    return;
+
+  uint rank = ((counters[d >> 1][local] >> (16 * (d & 1))) & 0xFFFF) - 1;
 
-  // Get in and out indices
   int inIndex = inOffset + index;
-  int outIndex = outOffset + bucket[(size * int((inMortons[inIndex] & base) == base)) + index + outBucket] - 1;
+  int outIndex = outOffset + int(bucket[d * numBlocks + gl_WorkGroupID.x] + rank);
 
   // Move morton code and trinagle index on appropriate position
-  inMortons[outIndex] = inMortons[inIndex];
+  for(int w = 0; w < MORTON_WORDS; w++)
+    inMortons[outIndex * MORTON_WORDS + w] = inMortons[inIndex * MORTON_WORDS + w];
+
   inIndices[outIndex] = inIndices[inIndex];
 
-  // Set values in bucket to zero
-  bucket[index] = 0;
-  bucket[size + index] = 0;
-  bucket[2 * size + index] = 0;
-  bucket[3 * size + index] = 0;
 }
 
 void main(){
 
   int threadID = int(gl_GlobalInvocationID.x);
+  uint local = gl_LocalInvocationID.x;
 
-  if(threadID >= size)
-    return;
-
+  // All threads of workgroup take part in barriers, elements out of range are skipped inside phases
   if(phase == HISTOGRAM_PHASE)
-    computeHistogram(threadID);
+    computeHistogram(threadID, local);
+
+  else if(phase == SCAN_REDUCE_PHASE)
+    reduceTile(local);
+
+  else if(phase == SCAN_TILE_SUMS_PHASE)
+    scanTileSums(local);
 
-  else if(phase == SCAN_PHASE)
-    prefixSum(threadID);
+  // Tile is scanned from sum of previous tiles
+  else if(phase == SCAN_DOWNSWEEP_PHASE)
+    scanTile(int(gl_WorkGroupID.x) * SCAN_TILE, RADIX_SIZE * numBlocks, bucket[RADIX_SIZE * numBlocks + gl_WorkGroupID.x], local);
 
   else if(phase == REORDER_PHASE)
-    reorderElements(threadID);
+    reorderElements(threadID, local);
 
 }
@@ -25,9 +25,11 @@ struct node{
 	int parent;
 	int sibling;
 	int tmp;
-	int gap;
+	int axis;
 };
 
+// MORTON_CODE_64 (injected by host) selects 63 bit codes stored as two words (low, high)
+
 // Algorithm phases
 #define BUILD_PHASE 0
 #define AABB_PHASE 1
@@ -81,41 +83,39 @@ int sgn(int x){
 * val - input value
 * return number of leading zeros in val (in binary representation)
 */
-int clz(int val){
-
-  int count = 0;
-  while(val != 0){
-
-    val >>= 1;
-    count++;
-  }
-
-  return 32 - count;
+int clz(uint val){
+  return 31 - findMSB(val);
 }
 
 /*
 * Delta of 2 morton codes (length of longest prefix)
 *
 * a, b - indices of input morton codes
-* return length of longest common prefix of 2 morton codes
+* return length of longest common prefix of 2 morton codes, equal codes are extended by triangle indices
 */
 int delta(int a, int b){
 	if(a < 0 || a > size || b < 0 || b > size)
   	return -1;
 
-  int res, dres;
+#ifdef MORTON_CODE_64
+	uint hi = inMortons[2 * a + 1] ^ inMortons[2 * b + 1];
+	uint lo = inMortons[2 * a] ^ inMortons[2 * b];
 
-	if(inMortons[a] == inMortons[b]){
-		res = int(inMortons[a]) ^ int(inMortons[b]);
-		dres = int(indices[a]) ^ int(indices[b]);
-		res = clz(res) + clz(dres);
-	}
-	else{
-  	res = int(inMortons[a]) ^ int(inMortons[b]);
-		res = clz(res);
-	}
+	if(hi != 0)
+		return clz(hi);
+
+	if(lo != 0)
+		return 32 + clz(lo);
 
-	return res;
+	return 64 + clz(indices[a] ^ indices[b]);
+#else
+	uint res = inMortons[a] ^ inMortons[b];
+
+	if(res != 0)
+		return clz(res);
+
+	return 32 + clz(indices[a] ^ indices[b]);
+#endif
 }
 
 /*
@@ -283,11 +283,29 @@ void processNode(int index){
 			nodes[y + 1].parent = 0;
   }
 
-	if(index == 0)
+	// Sibling links of child nodes (stackless traversal), child with triangle sibling has none
+	if(index != size){
+
+		if(nodes[index].left != -1)
+			nodes[y].sibling = nodes[index].right;
+
+		if(nodes[index].right != -1)
+			nodes[y + 1].sibling = nodes[index].left;
+	}
+
+	if(index == 0){
 		nodes[index].parent = -1;
+		nodes[index].sibling = -1;
+	}
+
+	// Split axis - the first different bit of morton codes in node (bits of x, y, z are interleaved from the top)
+#ifdef MORTON_CODE_64
+	int bit = 63 - d_node;
+#else
+	int bit = 31 - d_node;
+#endif
 
-	nodes[index].sibling = y;
-	nodes[index].gap = j;
+	nodes[index].axis = bit >= 0 ? 2 - bit % 3 : 0;
 
 }
 
@@ -312,7 +330,6 @@ void findAABB(int index){
 
 		// Node with one triangles + one child node
 		else if(nodes[index].left != -1 && nodes[index].right != -1){
-			nodes[index].gap = index;
 			atomicAdd(nodes[index].tmp, 1);
 			if(atomicCompSwap(nodes[index].tmp, 2, 3) != 2)	return;
 
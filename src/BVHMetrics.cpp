@@ -0,0 +1,447 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* BVHMetrics.cpp
+*/
+
+#include <BVHMetrics.h>
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <future>
+
+// Number of leaves in one task of EPO computation
+#define BVH_METRICS_TASK_SIZE 256
+
+std::vector<BVHMetrics::node> BVHMetrics::fromNodes(const std::vector<bvhPreprocessor::gpuNode>& nodes, bool lastInclusive){
+
+	std::vector<node> result(nodes.size());
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+
+		const bvhPreprocessor::gpuNode& n = nodes[i];
+		node& r = result[i];
+
+		r.min = glm::vec3(n._min);
+		r.max = glm::vec3(n._max);
+		r.left = n.left;
+		r.right = n.right;
+		r.first = -1;
+		r.count = 0;
+
+		if (n.left == -1 && n.right == -1) {
+			r.first = n.first;
+			r.count = std::max(0, n.last - n.first + (lastInclusive ? 1 : 0));
+		}
+	}
+
+	return result;
+}
+
+std::vector<BVHMetrics::node> BVHMetrics::fromRadixTree(const std::vector<ge::sg::RadixTree_BVH::bvh_node>& nodes, int format, const std::vector<unsigned>& order, const ge::sg::GeometryView & geometry){
+
+	std::vector<node> result;
+	glm::vec3 v[3];
+
+	// Bounds of triangle on primitive position
+	auto leaf = [&](int position) {
+		node l;
+		triangle(geometry, order[position], v);
+		l.min = glm::min(glm::min(v[0], v[1]), v[2]);
+		l.max = glm::max(glm::max(v[0], v[1]), v[2]);
+		l.left = l.right = -1;
+		l.first = position;
+		l.count = 1;
+		return l;
+	};
+
+	// Radix tree of single triangle has no inner node
+	if (format == BVH_NODES_RADIX_TREE && order.size() < 2) {
+		if (!order.empty())
+			result.push_back(leaf(0));
+		return result;
+	}
+
+	for (auto& n : nodes) {
+
+		node r;
+		r.min = glm::vec3(n._min);
+		r.max = glm::vec3(n._max);
+		r.left = n.left;
+		r.right = n.right;
+		r.first = -1;
+		r.count = 0;
+
+		// Explicit leaves with inclusive range of positions
+		if (format == BVH_NODES_INDEXED_RANGES && n.left == -1 && n.right == -1) {
+			r.first = n.triangleA;
+			r.count = std::max(0, n.triangleB - n.triangleA + 1);
+		}
+
+		result.push_back(r);
+	}
+
+	// Implicit leaves of radix tree are appended behind inner nodes
+	if (format == BVH_NODES_RADIX_TREE) {
+		for (size_t i = 0; i < nodes.size(); i++) {
+
+			if (nodes[i].left == -1 && nodes[i].triangleA >= 0 && nodes[i].triangleA < static_cast<int>(order.size())) {
+				result[i].left = static_cast<int>(result.size());
+				result.push_back(leaf(nodes[i].triangleA));
+			}
+
+			if (nodes[i].right == -1 && nodes[i].triangleB >= 0 && nodes[i].triangleB < static_cast<int>(order.size())) {
+				result[i].right = static_cast<int>(result.size());
+				result.push_back(leaf(nodes[i].triangleB));
+			}
+		}
+	}
+
+	return result;
+}
+
+BVHMetrics::report BVHMetrics::compute(const std::vector<node>& nodes, const std::vector<unsigned>& order, const ge::sg::GeometryView & geometry, size_t memory){
+
+	report r;
+	r.nodes = nodes.size();
+	r.leaves = 0;
+	r.primitives = order.size();
+	r.sah = r.epo = r.siblingOverlap = 0.0f;
+	r.maxDepth = 0;
+	r.averageLeafSize = 0.0f;
+	r.memory = memory;
+	r.valid = true;
+	r.errorCount = 0;
+
+	if (nodes.empty()) {
+		if (!order.empty())
+			error(r, "BVH without nodes references no primitive");
+		return r;
+	}
+
+	glm::vec3 extent = nodes[0].max - nodes[0].min;
+	float eps = BVH_METRICS_EPSILON * std::max(1.0f, std::max(extent.x, std::max(extent.y, extent.z)));
+	float rootArea = std::max(area(nodes[0].min, nodes[0].max), 1e-20f);
+
+	auto contains = [eps](glm::vec3 outerMin, glm::vec3 outerMax, glm::vec3 innerMin, glm::vec3 innerMax) {
+		return glm::all(glm::lessThanEqual(outerMin - eps, innerMin)) && glm::all(glm::lessThanEqual(innerMax, outerMax + eps));
+	};
+
+	// Depth-first traversal with order of entering and leaving (subtree test of EPO)
+	std::vector<int> depth(nodes.size(), -1);
+	std::vector<unsigned> enter(nodes.size(), 0), leave(nodes.size(), 0);
+	std::vector<unsigned> references(order.size(), 0);
+	std::vector<int> leaves;
+	std::vector<std::pair<int, bool>> stack = { { 0, false } };
+	unsigned time = 0, overlaps = 0;
+	glm::vec3 v[3];
+
+	depth[0] = 0;
+
+	while (!stack.empty()) {
+
+		int i = stack.back().first;
+		bool finished = stack.back().second;
+		stack.pop_back();
+
+		if (finished) {
+			leave[i] = time++;
+			continue;
+		}
+
+		enter[i] = time++;
+		stack.push_back({ i, true });
+
+		const node& n = nodes[i];
+		float nodeArea = area(n.min, n.max);
+
+		// Leaf - primitives have to be inside of leaf bounds
+		if (n.left == -1 && n.right == -1) {
+
+			r.leaves++;
+			leaves.push_back(i);
+			r.sah += BVH_METRICS_COST_TRIANGLE * n.count * nodeArea / rootArea;
+
+			r.maxDepth = std::max(r.maxDepth, static_cast<unsigned>(depth[i]));
+
+			if (r.depthHistogram.size() <= static_cast<size_t>(depth[i]))
+				r.depthHistogram.resize(depth[i] + 1, 0);
+			r.depthHistogram[depth[i]]++;
+
+			if (r.leafSizeHistogram.size() <= static_cast<size_t>(n.count))
+				r.leafSizeHistogram.resize(n.count + 1, 0);
+			r.leafSizeHistogram[n.count]++;
+
+			if (n.first < 0 || n.first + n.count > static_cast<int>(order.size())) {
+				error(r, "Leaf " + std::to_string(i) + " references primitives out of range");
+				continue;
+			}
+
+			for (int p = n.first; p < n.first + n.count; p++) {
+
+				references[p]++;
+
+				if (order[p] >= geometry.triangleCount())
+					continue;
+
+				triangle(geometry, order[p], v);
+
+				if (!contains(n.min, n.max, glm::min(glm::min(v[0], v[1]), v[2]), glm::max(glm::max(v[0], v[1]), v[2])))
+					error(r, "Triangle " + std::to_string(order[p]) + " is not inside of leaf " + std::to_string(i));
+			}
+
+			continue;
+		}
+
+		r.sah += BVH_METRICS_COST_NODE * nodeArea / rootArea;
+
+		// Children have to be inside of parent, every node is referenced once
+		for (int c : { n.right, n.left }) {
+
+			if (c == -1)
+				continue;
+
+			if (c < 0 || c >= static_cast<int>(nodes.size())) {
+				error(r, "Node " + std::to_string(i) + " has child out of range");
+				continue;
+			}
+
+			if (depth[c] != -1) {
+				error(r, "Node " + std::to_string(c) + " is referenced more than once");
+				continue;
+			}
+
+			if (!contains(n.min, n.max, nodes[c].min, nodes[c].max))
+				error(r, "Bounds of node " + std::to_string(c) + " are not inside of parent " + std::to_string(i));
+
+			depth[c] = depth[i] + 1;
+			stack.push_back({ c, false });
+		}
+
+		// Overlap of siblings relative to parent
+		if (n.left >= 0 && n.right >= 0 && n.left < static_cast<int>(nodes.size()) && n.right < static_cast<int>(nodes.size()) && nodeArea > 0.0f) {
+			glm::vec3 overlapMin = glm::max(nodes[n.left].min, nodes[n.right].min);
+			glm::vec3 overlapMax = glm::min(nodes[n.left].max, nodes[n.right].max);
+
+			// Flat boxes (planar geometry) have overlap with zero volume
+			if (glm::all(glm::lessThanEqual(overlapMin, overlapMax)))
+				r.siblingOverlap += area(overlapMin, overlapMax) / nodeArea;
+
+			overlaps++;
+		}
+	}
+
+	r.siblingOverlap = overlaps > 0 ? r.siblingOverlap / overlaps : 0.0f;
+	r.averageLeafSize = r.leaves > 0 ? static_cast<float>(order.size()) / r.leaves : 0.0f;
+
+	size_t unreached = std::count(depth.begin(), depth.end(), -1);
+
+	if (unreached > 0)
+		error(r, std::to_string(unreached) + " nodes are not reachable from root");
+
+	// Every primitive position in exactly one leaf, every triangle on exactly one position
+	size_t wrongReferences = std::count_if(references.begin(), references.end(), [](unsigned c) { return c != 1; });
+
+	if (wrongReferences > 0)
+		error(r, std::to_string(wrongReferences) + " primitives are not referenced exactly once");
+
+	std::vector<unsigned> triangles(geometry.triangleCount(), 0);
+
+	for (unsigned t : order)
+		if (t < triangles.size())
+			triangles[t]++;
+
+	size_t wrongTriangles = std::count_if(triangles.begin(), triangles.end(), [](unsigned c) { return c != 1; });
+
+	if (wrongTriangles > 0 || order.size() != triangles.size())
+		error(r, std::to_string(wrongTriangles) + " triangles are not referenced exactly once");
+
+	// EPO - area of triangles inside of nodes, which do not contain them in subtree
+	float totalArea = 0.0f;
+
+	for (unsigned t = 0; t < geometry.triangleCount(); t++) {
+		triangle(geometry, t, v);
+		totalArea += 0.5f * glm::length(glm::cross(v[1] - v[0], v[2] - v[0]));
+	}
+
+	ThreadPool pool;
+	std::vector<std::future<float>> tasks;
+
+	for (size_t start = 0; start < leaves.size(); start += BVH_METRICS_TASK_SIZE) {
+
+		size_t end = std::min(leaves.size(), start + BVH_METRICS_TASK_SIZE);
+
+		tasks.push_back(pool.submit([&, start, end]() {
+
+			float sum = 0.0f;
+			glm::vec3 tri[3];
+			std::vector<int> visit;
+
+			for (size_t l = start; l < end; l++) {
+
+				int leafIndex = leaves[l];
+				const node& leafNode = nodes[leafIndex];
+
+				for (int p = leafNode.first; p >= 0 && p < leafNode.first + leafNode.count && p < static_cast<int>(order.size()); p++) {
+
+					if (order[p] >= geometry.triangleCount())
+						continue;
+
+					triangle(geometry, order[p], tri);
+					glm::vec3 triMin = glm::min(glm::min(tri[0], tri[1]), tri[2]);
+					glm::vec3 triMax = glm::max(glm::max(tri[0], tri[1]), tri[2]);
+
+					visit.assign(1, 0);
+
+					while (!visit.empty()) {
+
+						int m = visit.back();
+						visit.pop_back();
+
+						const node& n = nodes[m];
+
+						if (glm::any(glm::lessThan(n.max, triMin)) || glm::any(glm::lessThan(triMax, n.min)))
+							continue;
+
+						// Nodes on path to leaf of triangle contain it in subtree
+						bool ancestor = enter[m] <= enter[leafIndex] && leave[leafIndex] <= leave[m];
+
+						if (!ancestor) {
+							float cost = (n.left == -1 && n.right == -1) ? BVH_METRICS_COST_TRIANGLE * n.count : BVH_METRICS_COST_NODE;
+							sum += cost * clippedArea(tri, n.min, n.max);
+						}
+
+						for (int c : { n.left, n.right })
+							if (c >= 0 && c < static_cast<int>(nodes.size()) && depth[c] == depth[m] + 1)
+								visit.push_back(c);
+					}
+				}
+			}
+
+			return sum;
+		}));
+	}
+
+	for (auto& t : tasks)
+		r.epo += t.get();
+
+	r.epo = totalArea > 0.0f ? r.epo / totalArea : 0.0f;
+
+	return r;
+}
+
+bool BVHMetrics::writeJson(const report & r, std::string name, std::string file){
+
+	std::ofstream output(file);
+
+	if (!output.is_open())
+		return false;
+
+	auto list = [&output](const std::vector<unsigned>& values) {
+		output << "[";
+		for (size_t i = 0; i < values.size(); i++)
+			output << (i > 0 ? ", " : "") << values[i];
+		output << "]";
+	};
+
+	output << "{" << std::endl;
+	output << "\t\"bvh\": \"" << name << "\"," << std::endl;
+	output << "\t\"nodes\": " << r.nodes << "," << std::endl;
+	output << "\t\"leaves\": " << r.leaves << "," << std::endl;
+	output << "\t\"primitives\": " << r.primitives << "," << std::endl;
+	output << "\t\"sah\": " << r.sah << "," << std::endl;
+	output << "\t\"epo\": " << r.epo << "," << std::endl;
+	output << "\t\"sibling_overlap\": " << r.siblingOverlap << "," << std::endl;
+	output << "\t\"max_depth\": " << r.maxDepth << "," << std::endl;
+	output << "\t\"average_leaf_size\": " << r.averageLeafSize << "," << std::endl;
+	output << "\t\"depth_histogram\": ";
+	list(r.depthHistogram);
+	output << "," << std::endl << "\t\"leaf_size_histogram\": ";
+	list(r.leafSizeHistogram);
+	output << "," << std::endl;
+	output << "\t\"memory_bytes\": " << r.memory << "," << std::endl;
+	output << "\t\"valid\": " << (r.valid ? "true" : "false") << "," << std::endl;
+	output << "\t\"error_count\": " << r.errorCount << "," << std::endl;
+	output << "\t\"errors\": [";
+
+	for (size_t i = 0; i < r.errors.size(); i++)
+		output << (i > 0 ? ", " : "") << "\"" << r.errors[i] << "\"";
+
+	output << "]" << std::endl << "}" << std::endl;
+
+	return static_cast<bool>(output);
+}
+
+float BVHMetrics::area(glm::vec3 min, glm::vec3 max){
+	glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+float BVHMetrics::clippedArea(const glm::vec3 * triangle, glm::vec3 min, glm::vec3 max){
+
+	// Triangle clipped by 6 planes has at most 9 vertices
+	glm::vec3 polygon[16], clipped[16];
+	int count = 3;
+
+	for (int i = 0; i < 3; i++)
+		polygon[i] = triangle[i];
+
+	for (int plane = 0; plane < 6 && count > 0; plane++) {
+
+		int axis = plane / 2;
+		bool lower = plane % 2 == 0;
+		float bound = lower ? min[axis] : max[axis];
+		int clippedCount = 0;
+
+		// Signed distance inside of box is positive
+		auto distance = [&](const glm::vec3& p) { return lower ? p[axis] - bound : bound - p[axis]; };
+
+		for (int i = 0; i < count; i++) {
+
+			const glm::vec3& a = polygon[i];
+			const glm::vec3& b = polygon[(i + 1) % count];
+			float da = distance(a), db = distance(b);
+
+			if (da >= 0.0f)
+				clipped[clippedCount++] = a;
+
+			if ((da >= 0.0f) != (db >= 0.0f))
+				clipped[clippedCount++] = a + (b - a) * (da / (da - db));
+		}
+
+		count = clippedCount;
+		std::copy(clipped, clipped + count, polygon);
+	}
+
+	glm::vec3 sum(0.0f);
+
+	for (int i = 1; i + 1 < count; i++)
+		sum += glm::cross(polygon[i] - polygon[0], polygon[i + 1] - polygon[0]);
+
+	return 0.5f * glm::length(sum);
+}
+
+void BVHMetrics::triangle(const ge::sg::GeometryView & geometry, unsigned index, glm::vec3 * vertices){
+
+	for (unsigned c = 0; c < 3; c++) {
+		const float* p = geometry.vertex(index, c);
+		vertices[c] = glm::vec3(p[0], p[1], p[2]);
+	}
+
+}
+
+void BVHMetrics::error(report & r, std::string message){
+
+	r.valid = false;
+	r.errorCount++;
+
+	if (r.errors.size() < BVH_METRICS_MAX_ERRORS)
+		r.errors.push_back(message);
+
+}
@@ -0,0 +1,132 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* BVHMetrics.h
+*/
+
+#pragma once
+
+#include <bvhPreprocessor.h>
+#include <RadixTree_BVH.h>
+#include <GeometryView.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Costs of SAH and EPO (traversal step and ray-triangle test)
+#define BVH_METRICS_COST_NODE 1.2f
+#define BVH_METRICS_COST_TRIANGLE 1.0f
+
+// Tolerance of containment of bounds (relative to size of scene)
+#define BVH_METRICS_EPSILON 1e-5f
+
+// Maximum number of stored validation errors
+#define BVH_METRICS_MAX_ERRORS 10
+
+// Default file of metrics report
+#define BVH_METRICS_FILE "bvh_metrics.json"
+
+/**
+* @brief Quality metrics and structural validation of flattened BVH
+*/
+class BVHMetrics {
+
+public:
+
+	/**
+	* @brief Structure of node in common form (leaf - left and right are -1, range of primitive positions)
+	*/
+	typedef struct {
+		glm::vec3 min, max;
+		int left, right;
+		int first, count;
+	} node;
+
+	/**
+	* @brief Structure of metrics report
+	*/
+	typedef struct {
+		size_t nodes, leaves, primitives;
+		float sah;								// SAH cost normalized by surface area of root
+		float epo;								// End-point overlap normalized by surface area of triangles
+		float siblingOverlap;					// Average ratio of surface area of children intersection to surface area of parent
+		unsigned maxDepth;
+		float averageLeafSize;
+		std::vector<unsigned> depthHistogram;	// Number of leaves in depth
+		std::vector<unsigned> leafSizeHistogram;	// Number of leaves with given number of primitives
+		size_t memory;							// Size of nodes and indices in bytes
+		bool valid;
+		size_t errorCount;
+		std::vector<std::string> errors;		// The first validation errors
+	} report;
+
+	/**
+	* @brief Converts nodes of CPU BVH (and clusters) into common form
+	* @param nodes Flattened nodes
+	* @param lastInclusive true if last primitive of leaf is inclusive, false for CPU BVH (iterator difference)
+	* @return Nodes in common form
+	*/
+	static std::vector<node> fromNodes(const std::vector<bvhPreprocessor::gpuNode>& nodes, bool lastInclusive);
+
+	/**
+	* @brief Converts nodes of GPU BVH into common form
+	* @param nodes Nodes read back from GPU
+	* @param format BVH_NODES_RADIX_TREE (implicit leaves with one triangle) or BVH_NODES_INDEXED_RANGES
+	* @param order Triangle of every primitive position (sorted indices)
+	* @param geometry Geometry of scene (bounds of implicit leaves)
+	* @return Nodes in common form
+	*/
+	static std::vector<node> fromRadixTree(const std::vector<ge::sg::RadixTree_BVH::bvh_node>& nodes, int format, const std::vector<unsigned>& order, const ge::sg::GeometryView& geometry);
+
+	/**
+	* @brief Computes metrics and validates structure
+	* @param nodes Nodes in common form, root is the first node
+	* @param order Triangle of every primitive position
+	* @param geometry Geometry of scene
+	* @param memory Size of nodes and indices in bytes
+	* @return Metrics report
+	*/
+	static report compute(const std::vector<node>& nodes, const std::vector<unsigned>& order, const ge::sg::GeometryView& geometry, size_t memory);
+
+	/**
+	* @brief Writes report into JSON file
+	* @param r Metrics report
+	* @param name Name of BVH (builder)
+	* @param file Path to file
+	* @return true if success
+	*/
+	static bool writeJson(const report& r, std::string name, std::string file);
+
+private:
+
+	/**
+	* @brief Surface area of box
+	*/
+	static float area(glm::vec3 min, glm::vec3 max);
+
+	/**
+	* @brief Area of part of triangle inside box (triangle clipped by planes of box)
+	* @param triangle Vertices of triangle
+	* @param min Minimal corner of box
+	* @param max Maximal corner of box
+	* @return Clipped area
+	*/
+	static float clippedArea(const glm::vec3* triangle, glm::vec3 min, glm::vec3 max);
+
+	/**
+	* @brief Reads vertices of triangle
+	*/
+	static void triangle(const ge::sg::GeometryView& geometry, unsigned index, glm::vec3* vertices);
+
+	/**
+	* @brief Records validation error
+	*/
+	static void error(report& r, std::string message);
+
+};
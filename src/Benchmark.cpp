@@ -0,0 +1,86 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* Benchmark.cpp
+*/
+
+#include <Benchmark.h>
+
+#include <sstream>
+#include <memory>
+
+#include <assimp/postprocess.h>
+#include <AssimpModelLoader.h>
+#include <geSG/AttributeDescriptor.h>
+#include <geSG/Model.h>
+#include <geSG/Mesh.h>
+
+std::vector<unsigned> parseList(std::string list){
+
+	std::vector<unsigned> values;
+	std::stringstream stream(list);
+	std::string value;
+
+	while (std::getline(stream, value, ','))
+		if (!value.empty())
+			values.push_back(static_cast<unsigned>(std::stoul(value)));
+
+	return values;
+}
+
+std::vector<std::string> parseNames(std::string list){
+
+	std::vector<std::string> values;
+	std::stringstream stream(list);
+	std::string value;
+
+	while (std::getline(stream, value, ','))
+		if (!value.empty())
+			values.push_back(value);
+
+	return values;
+}
+
+bool collectGeometry(const ge::sg::Scene& loaded, std::string name, benchmarkScene& scene){
+
+	scene.name = name;
+	scene.positions.clear();
+	scene.indices.clear();
+
+	for (auto model : loaded.models) {
+		for (auto mesh : model->meshes) {
+
+			unsigned offset = static_cast<unsigned>(scene.positions.size() / 3);
+
+			for (auto attr : mesh->attributes) {
+
+				if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::position) {
+					float* data = static_cast<float*>(attr->data.get());
+					scene.positions.insert(scene.positions.end(), data, data + attr->size / sizeof(float));
+				}
+				else if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::indices) {
+					unsigned* data = static_cast<unsigned*>(attr->data.get());
+
+					for (size_t i = 0; i < attr->size / sizeof(unsigned); i++)
+						scene.indices.push_back(data[i] + offset);
+				}
+			}
+		}
+	}
+
+	return !scene.indices.empty();
+}
+
+bool loadScene(std::string file, benchmarkScene& scene){
+
+	std::unique_ptr<ge::sg::Scene> loaded(AssimpModelLoader::loadScene(file.c_str(), aiProcess_Triangulate));
+
+	if (loaded == nullptr)
+		return false;
+
+	return collectGeometry(*loaded, file.substr(file.find_last_of("/\\") + 1), scene);
+}
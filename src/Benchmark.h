@@ -0,0 +1,62 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* Benchmark.h
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <geSG/Scene.h>
+
+#define BENCHMARK_SUCCESS 0
+#define BENCHMARK_FAIL 1
+
+// Default procedural scenes of benchmarks
+#define BENCHMARK_DISTRIBUTIONS "uniform,spheres,stadium,thin,grid"
+
+/**
+* @brief Triangles of benchmarked scene (indexed geometry, positions are viewed by builders)
+*/
+typedef struct {
+	std::string name;
+	std::vector<float> positions;
+	std::vector<unsigned> indices;
+} benchmarkScene;
+
+/**
+* @brief Parses list of numbers separated by commas
+* @param list String with list
+* @return Vector of numbers
+*/
+std::vector<unsigned> parseList(std::string list);
+
+/**
+* @brief Parses list of names separated by commas
+* @param list String with list
+* @return Vector of names
+*/
+std::vector<std::string> parseNames(std::string list);
+
+/**
+* @brief Collects positions and indices of all meshes of scene graph
+* @param loaded Loaded or generated scene
+* @param name Name of scene in results
+* @param scene Output scene
+* @return true if scene has triangles
+*/
+bool collectGeometry(const ge::sg::Scene& loaded, std::string name, benchmarkScene& scene);
+
+/**
+* @brief Loads positions and indices of all meshes of scene file
+* @param file Path to scene file
+* @param scene Output scene
+* @return true if success
+*/
+bool loadScene(std::string file, benchmarkScene& scene);
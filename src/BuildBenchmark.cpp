@@ -0,0 +1,253 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* BuildBenchmark.cpp
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+
+#include <BVH.h>
+#include <AABB_SAH_BVH.h>
+#include <PLOC_BVH.h>
+#include <GeometryView.h>
+#include <BVHMetrics.h>
+#include <bvhPreprocessor.h>
+#include <AllocationCounter.h>
+#include <SceneGenerator.h>
+#include <Benchmark.h>
+
+// Default parameters of benchmark (sizes of procedural scenes, thread counts of parallel builders)
+#define BENCHMARK_SIZES "1000,10000,100000,1000000"
+#define BENCHMARK_THREADS "1,2,4,8"
+#define BENCHMARK_REPEATS 3
+
+/**
+* @brief Measured build of one configuration
+*/
+typedef struct {
+	double time;			// Median of build times in ms
+	double minTime;			// The fastest build in ms
+	size_t peakMemory;		// Peak of memory allocated during build in bytes
+	float sah;				// SAH cost of built BVH normalized by surface area of root
+	double flattenTime;		// Median of times of flattening into GPU nodes in ms
+} buildResult;
+
+/**
+* @brief SAH cost of BVH normalized by surface area of root (same costs as BVHMetrics)
+* @param root Root node of BVH
+* @return SAH cost
+*/
+float sahCost(ge::sg::BVH_Node<ge::sg::AABB>* root){
+
+	auto area = [](const ge::sg::AABB& box) {
+		glm::vec3 d = glm::max(box.max - box.min, glm::vec3(0.0f));
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	};
+
+	float rootArea = std::max(area(root->volume), 1e-20f);
+	float cost = 0.0f;
+	std::vector<ge::sg::BVH_Node<ge::sg::AABB>*> stack = { root };
+
+	while (!stack.empty()) {
+
+		auto node = stack.back();
+		stack.pop_back();
+
+		if (node->left == nullptr && node->right == nullptr) {
+			cost += BVH_METRICS_COST_TRIANGLE * (node->last - node->first) * area(node->volume) / rootArea;
+			continue;
+		}
+
+		cost += BVH_METRICS_COST_NODE * area(node->volume) / rootArea;
+
+		if (node->left != nullptr)
+			stack.push_back(node->left.get());
+
+		if (node->right != nullptr)
+			stack.push_back(node->right.get());
+	}
+
+	return cost;
+}
+
+/**
+* @brief Builds BVH repeatedly and measures builds
+* @param scene Benchmarked scene
+* @param threads Number of worker threads of builder
+* @param repeats Number of builds
+* @return Measured results
+*/
+template<typename BuildPolicy>
+buildResult measureBuild(const benchmarkScene& scene, unsigned threads, unsigned repeats){
+
+	buildResult result = { 0.0, 0.0, 0, 0.0f, 0.0 };
+	std::vector<double> times, flattenTimes;
+
+	ge::sg::GeometryView view(scene.positions.data(), scene.positions.size() / 3, scene.indices.data(), scene.indices.size());
+
+	for (unsigned r = 0; r < repeats; r++) {
+
+		size_t before = AllocationCounter::bytes();
+		AllocationCounter::resetPeak();
+
+		auto bvh = std::make_shared<ge::sg::BVH<BuildPolicy>>();
+		bvh->setGeometryData(view);
+		bvh->setThreads(threads);
+
+		// Same parameters as builds of application
+		if (std::is_same<BuildPolicy, ge::sg::AABB_SAH_BVH>::value) {
+			bvh->setDepth(35);
+			bvh->setMinimumPrimitivesInNode(25);
+		}
+		else
+			bvh->setMinimumPrimitivesInNode(4);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		bvh->buildBVH();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		result.peakMemory = std::max(result.peakMemory, AllocationCounter::peakBytes() - before);
+
+		if (r == 0)
+			result.sah = sahCost(bvh->getRoot().get());
+
+		// Flattening uploaded on GPU, it uses the same threads as builder
+		auto root = bvh->getRoot();
+		bvhPreprocessor bp;
+		bp.setThreads(threads);
+
+		start = std::chrono::high_resolution_clock::now();
+		bp.transformBVH(root.get(), root->first);
+		end = std::chrono::high_resolution_clock::now();
+
+		flattenTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	std::sort(times.begin(), times.end());
+	result.time = times[times.size() / 2];
+	result.minTime = times.front();
+
+	std::sort(flattenTimes.begin(), flattenTimes.end());
+	result.flattenTime = flattenTimes[flattenTimes.size() / 2];
+
+	return result;
+}
+
+/**
+* @brief Runs builders over scene and writes one row per configuration
+* @param scene Benchmarked scene
+* @param threadCounts Thread counts of parallel builders
+* @param repeats Number of builds of every configuration
+* @param output Output CSV stream
+*/
+void runScene(const benchmarkScene& scene, const std::vector<unsigned>& threadCounts, unsigned repeats, std::ostream& output){
+
+	size_t triangles = scene.indices.size() / 3;
+
+	auto write = [&](std::string builder, unsigned threads, const buildResult& r) {
+		output << builder << "," << scene.name << "," << triangles << "," << threads << "," << repeats << ","
+			   << r.time << "," << r.minTime << "," << (r.time > 0.0 ? triangles / (r.time * 1000.0) : 0.0) << ","
+			   << r.peakMemory << "," << r.sah << "," << r.flattenTime << std::endl;
+	};
+
+	// SAH builder is sequential, it is measured once
+	std::cerr << "AABB_SAH_BVH " << scene.name << " " << triangles << std::endl;
+	write("AABB_SAH_BVH", 1, measureBuild<ge::sg::AABB_SAH_BVH>(scene, 1, repeats));
+
+	for (unsigned threads : threadCounts) {
+		std::cerr << "PLOC_BVH " << scene.name << " " << triangles << " threads " << threads << std::endl;
+		write("PLOC_BVH", threads, measureBuild<ge::sg::PLOC_BVH>(scene, threads, repeats));
+	}
+
+}
+
+/**
+* @brief Benchmark of CPU BVH builders
+* BuildBenchmark [--generate uniform,spheres] [--sizes 1000,10000] [--threads 1,2,4] [--repeats 3] [--scene file]... [--output results.csv]
+*/
+int main(int argc, char** argv){
+
+	std::vector<std::string> distributions = parseNames(BENCHMARK_DISTRIBUTIONS);
+	std::vector<unsigned> sizes = parseList(BENCHMARK_SIZES);
+	std::vector<unsigned> threadCounts = parseList(BENCHMARK_THREADS);
+	std::vector<std::string> files;
+	std::string outputFile;
+	unsigned repeats = BENCHMARK_REPEATS;
+
+	for (int i = 1; i + 1 < argc; i++) {
+		std::string arg = argv[i];
+
+		if (arg == "--generate")
+			distributions = parseNames(argv[++i]);
+		else if (arg == "--sizes")
+			sizes = parseList(argv[++i]);
+		else if (arg == "--threads")
+			threadCounts = parseList(argv[++i]);
+		else if (arg == "--repeats")
+			repeats = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+		else if (arg == "--scene")
+			files.push_back(argv[++i]);
+		else if (arg == "--output")
+			outputFile = argv[++i];
+	}
+
+	std::ofstream file;
+
+	if (!outputFile.empty()) {
+		file.open(outputFile);
+
+		if (!file.is_open()) {
+			std::cout << "Output file " << outputFile << " could not be created" << std::endl;
+			return BENCHMARK_FAIL;
+		}
+	}
+
+	std::ostream& output = outputFile.empty() ? std::cout : file;
+
+	if (AllocationCounter::count() == 0)
+		std::cerr << "Allocation counting is disabled, peak memory is not measured" << std::endl;
+
+	output << "builder,scene,triangles,threads,repeats,time_ms,min_time_ms,mtris_per_s,peak_memory_bytes,sah,flatten_ms" << std::endl;
+
+	benchmarkScene scene;
+
+	for (auto& name : distributions) {
+
+		SceneGenerator::distribution d;
+
+		if (!SceneGenerator::parseDistribution(name, d)) {
+			std::cout << "Unknown distribution " << name << std::endl;
+			continue;
+		}
+
+		for (unsigned size : sizes) {
+			collectGeometry(*SceneGenerator::generate(d, size), name, scene);
+			runScene(scene, threadCounts, repeats, output);
+		}
+	}
+
+	for (auto& f : files) {
+
+		if (!loadScene(f, scene)) {
+			std::cout << "Scene " << f << " could not be loaded" << std::endl;
+			continue;
+		}
+
+		runScene(scene, threadCounts, repeats, output);
+	}
+
+	return BENCHMARK_SUCCESS;
+}
@@ -0,0 +1,538 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* CPUTracer.cpp
+*/
+
+#include <CPUTracer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <future>
+#include <utility>
+
+namespace {
+
+	/**
+	* @brief Random number in range 0 - 1 from hash of sample index (reproducible, no generator state)
+	*/
+	float random(uint32_t index, uint32_t dimension){
+
+		uint32_t x = index * 0x9E3779B9u + dimension * 0x85EBCA6Bu;
+		x ^= x >> 16;
+		x *= 0x7FEB352Du;
+		x ^= x >> 15;
+		x *= 0x846CA68Bu;
+		x ^= x >> 16;
+
+		return (x >> 8) * (1.0f / 16777216.0f);
+	}
+
+	/**
+	* @brief Cosine weighted direction in hemisphere around normal
+	*/
+	glm::vec3 hemisphere(glm::vec3 n, float u, float v){
+
+		glm::vec3 t = std::abs(n.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 b = glm::normalize(glm::cross(n, t));
+		t = glm::cross(b, n);
+
+		float r = std::sqrt(u), phi = 6.2831853f * v;
+
+		return r * std::cos(phi) * t + r * std::sin(phi) * b + std::sqrt(std::max(0.0f, 1.0f - u)) * n;
+	}
+
+}
+
+void CPUTracer::setScene(const std::vector<bvhPreprocessor::gpuNode>& bvhNodes, const ge::sg::GeometryView & geometry, const std::vector<unsigned>& order, bool lastInclusive){
+
+	nodes = bvhNodes;
+	leafEnd = lastInclusive ? 1 : 0;
+	cacheEpoch++;
+
+	// Triangles in order of leaves (as data buffer of trace.cs)
+	vertices.resize(3 * order.size());
+
+	for (size_t i = 0; i < order.size(); i++) {
+		for (unsigned c = 0; c < 3; c++) {
+			const float* p = geometry.vertex(order[i], c);
+			vertices[3 * i + c] = glm::vec3(p[0], p[1], p[2]);
+		}
+	}
+
+	// Lanes behind the last triangle are never tested
+	packets.assign((order.size() + 3) / 4, TriangleIntersection::triangle4());
+
+	for (size_t i = 0; i < order.size(); i++)
+		TriangleIntersection::store(packets[i / 4], static_cast<int>(i % 4), vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+
+}
+
+bool CPUTracer::intersect(const ray & r, hit & h, traversal & counters) const{
+	return traverse(r, h, false, counters);
+}
+
+bool CPUTracer::occluded(const ray & r, traversal & counters) const{
+	hit h;
+	return traverse(r, h, true, counters);
+}
+
+std::vector<CPUTracer::rayStats> CPUTracer::run(glm::vec3 eye, glm::vec3 target, glm::vec3 light, unsigned width, unsigned height, unsigned samples){
+
+	std::vector<rayStats> results;
+
+	if (nodes.empty())
+		return results;
+
+	// Every run starts with cold simulated caches
+	cacheEpoch++;
+
+	float extent = glm::length(getMax() - getMin());
+	float eps = CPU_TRACER_EPSILON * extent;
+
+	// Camera with vertical field of view 60 degrees
+	glm::vec3 forward = glm::normalize(target - eye);
+	glm::vec3 right = glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f));
+	right = glm::dot(right, right) > 1e-8f ? glm::normalize(right) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 up = glm::cross(right, forward);
+	float scale = std::tan(0.5236f), aspect = width / static_cast<float>(height);
+
+	// Primary rays
+	std::vector<hit> primary(static_cast<size_t>(width) * height);
+	std::vector<glm::vec3> directions(primary.size());
+
+	results.push_back(traceSet("primary", primary.size(), [&](size_t i, traversal& counters) {
+		float x = (2.0f * ((i % width) + 0.5f) / width - 1.0f) * scale * aspect;
+		float y = (1.0f - 2.0f * ((i / width) + 0.5f) / height) * scale;
+
+		directions[i] = glm::normalize(forward + x * right + y * up);
+		return intersect({ eye, directions[i], std::numeric_limits<float>::max() }, primary[i], counters);
+	}));
+
+	// Hit points with normals facing the camera
+	std::vector<glm::vec3> points, normals;
+
+	for (size_t i = 0; i < primary.size(); i++) {
+
+		if (primary[i].triangle < 0)
+			continue;
+
+		const glm::vec3* v = &vertices[3 * primary[i].triangle];
+		glm::vec3 n = glm::cross(v[1] - v[0], v[2] - v[0]);
+		n = glm::dot(n, n) > 0.0f ? glm::normalize(n) : -directions[i];
+
+		if (glm::dot(n, directions[i]) > 0.0f)
+			n = -n;
+
+		points.push_back(eye + primary[i].t * directions[i] + eps * n);
+		normals.push_back(n);
+	}
+
+	size_t secondary = points.size() * samples;
+
+	// Shadow rays towards point light (area of light is 1 % of scene)
+	results.push_back(traceSet("shadow", secondary, [&](size_t i, traversal& counters) {
+		glm::vec3 p = points[i / samples];
+		glm::vec3 jitter = 0.01f * extent * (glm::vec3(random(static_cast<uint32_t>(i), 0), random(static_cast<uint32_t>(i), 1), random(static_cast<uint32_t>(i), 2)) - 0.5f);
+		glm::vec3 d = light + jitter - p;
+		float distance = glm::length(d);
+
+		return occluded({ p, d / distance, distance }, counters);
+	}));
+
+	// Ambient occlusion rays (short, any hit)
+	results.push_back(traceSet("ao", secondary, [&](size_t i, traversal& counters) {
+		glm::vec3 d = hemisphere(normals[i / samples], random(static_cast<uint32_t>(i), 3), random(static_cast<uint32_t>(i), 4));
+		return occluded({ points[i / samples], d, CPU_TRACER_AO_RADIUS * extent }, counters);
+	}));
+
+	// Diffuse bounce rays (closest hit)
+	results.push_back(traceSet("diffuse", secondary, [&](size_t i, traversal& counters) {
+		glm::vec3 d = hemisphere(normals[i / samples], random(static_cast<uint32_t>(i), 5), random(static_cast<uint32_t>(i), 6));
+		hit h;
+		return intersect({ points[i / samples], d, std::numeric_limits<float>::max() }, h, counters);
+	}));
+
+	return results;
+}
+
+std::vector<uint32_t> CPUTracer::sampleAccesses(glm::vec3 eye, glm::vec3 target, glm::vec3 light, unsigned width, unsigned height, unsigned samples){
+
+	accesses.reset(new std::atomic<uint32_t>[nodes.size()]);
+
+	for (size_t i = 0; i < nodes.size(); i++)
+		accesses[i] = 0;
+
+	run(eye, target, light, width, height, samples);
+
+	std::vector<uint32_t> result(nodes.size());
+
+	for (size_t i = 0; i < nodes.size(); i++)
+		result[i] = accesses[i];
+
+	accesses.reset();
+
+	return result;
+}
+
+void CPUTracer::setCacheSimulation(bool enable){
+	simulateCache = enable;
+}
+
+void CPUTracer::setStackless(bool enable){
+	stackless = enable;
+}
+
+void CPUTracer::setIntersection(intersection i){
+	kernel = i;
+}
+
+std::string CPUTracer::getIntersectionName(intersection i){
+
+	switch (i) {
+	case MOLLER_TRUMBORE: return "moller";
+	case WATERTIGHT: return "watertight";
+	case WATERTIGHT_SIMD: return "simd";
+	}
+
+	return "";
+}
+
+bool CPUTracer::parseIntersection(std::string name, intersection & i){
+
+	for (intersection candidate : { MOLLER_TRUMBORE, WATERTIGHT, WATERTIGHT_SIMD }) {
+		if (getIntersectionName(candidate) == name) {
+			i = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+glm::vec3 CPUTracer::getMin(){
+	return nodes.empty() ? glm::vec3(0.0f) : glm::vec3(nodes[0]._min);
+}
+
+glm::vec3 CPUTracer::getMax(){
+	return nodes.empty() ? glm::vec3(0.0f) : glm::vec3(nodes[0]._max);
+}
+
+bool CPUTracer::traverse(const ray & r, hit & h, bool anyHit, traversal & counters) const{
+
+	h.t = r.tmax;
+	h.triangle = -1;
+
+	if (nodes.empty())
+		return false;
+
+	traversalRay tr = { r.origin, r.direction, 1.0f / r.direction, TriangleIntersection::setup(r.origin, r.direction) };
+
+	if (stackless)
+		return traverseStackless(tr, h, anyHit, counters);
+
+	// Stack of far children with their entry distances (reused by thread)
+	thread_local std::vector<std::pair<int, float>> stack;
+	stack.clear();
+
+	unsigned depth = 0;
+	int node = 0;
+
+	if (boxTest(tr, glm::vec3(nodes[0]._min), glm::vec3(nodes[0]._max), h.t) < 0.0f) {
+		touch(0, counters);
+		node = -1;
+	}
+
+	while (node != -1) {
+
+		const bvhPreprocessor::gpuNode& n = nodes[node];
+		touch(node, counters);
+		counters.nodes++;
+
+		// Leaf - triangles in range of leaf
+		if (n.left == -1 && n.right == -1) {
+			if (testLeaf(tr, n, h, anyHit, counters))
+				stack.clear();
+		}
+
+		// Inner node - the nearer child by split axis first, the farther one is stored
+		else {
+
+			// Bounds of children are stored in node
+			float tl = n.left != -1 ? childTest(tr, n, false, h.t) : -1.0f;
+			float tr2 = n.right != -1 ? childTest(tr, n, true, h.t) : -1.0f;
+
+			if (tl >= 0.0f && tr2 >= 0.0f) {
+				bool leftFirst = tr.direction[n.axis] >= 0.0f;
+				stack.push_back(leftFirst ? std::make_pair(n.right, tr2) : std::make_pair(n.left, tl));
+				depth = std::max(depth, static_cast<unsigned>(stack.size()));
+				node = leftFirst ? n.left : n.right;
+				continue;
+			}
+
+			if (tl >= 0.0f || tr2 >= 0.0f) {
+				node = tl >= 0.0f ? n.left : n.right;
+				continue;
+			}
+		}
+
+		// Stored nodes farther than the closest hit are skipped
+		node = -1;
+
+		while (!stack.empty()) {
+			std::pair<int, float> next = stack.back();
+			stack.pop_back();
+
+			if (next.second <= h.t) {
+				node = next.first;
+				break;
+			}
+		}
+	}
+
+	counters.stack += depth;
+	counters.maxStack = std::max(counters.maxStack, depth);
+
+	return h.triangle != -1;
+}
+
+bool CPUTracer::traverseStackless(const traversalRay & r, hit & h, bool anyHit, traversal & counters) const{
+
+	if (boxTest(r, glm::vec3(nodes[0]._min), glm::vec3(nodes[0]._max), h.t) < 0.0f) {
+		touch(0, counters);
+		return false;
+	}
+
+	// Child, from which traversal returned to current node (-1 - current node is entered)
+	int current = 0, from = -1;
+
+	while (true) {
+
+		const bvhPreprocessor::gpuNode& n = nodes[current];
+		touch(current, counters);
+		counters.nodes++;
+
+		// Order of children by split axis (the only child is near)
+		int nearChild = n.left, farChild = n.right;
+
+		if (n.axis >= 0 && r.direction[n.axis] < 0.0f)
+			std::swap(nearChild, farChild);
+
+		if (nearChild == -1)
+			std::swap(nearChild, farChild);
+
+		if (from == -1) {
+
+			if (n.left == -1 && n.right == -1) {
+				if (testLeaf(r, n, h, anyHit, counters))
+					break;
+			}
+
+			else if (childTest(r, n, nearChild == n.right, h.t) >= 0.0f) {
+				current = nearChild;
+				continue;
+			}
+
+			else if (farChild != -1 && childTest(r, n, farChild == n.right, h.t) >= 0.0f) {
+				current = farChild;
+				continue;
+			}
+		}
+
+		// Far child is tested again after subtree of near child (with the closer hit)
+		else if (from == nearChild && farChild != -1 && childTest(r, n, farChild == n.right, h.t) >= 0.0f) {
+			current = farChild;
+			from = -1;
+			continue;
+		}
+
+		// Subtree of node is finished
+		if (current == 0)
+			break;
+
+		from = current;
+		current = n.parent;
+	}
+
+	return h.triangle != -1;
+}
+
+bool CPUTracer::testLeaf(const traversalRay & r, const bvhPreprocessor::gpuNode & leaf, hit & h, bool anyHit, traversal & counters) const{
+
+	int end = leaf.last + leafEnd;
+
+	if (kernel == WATERTIGHT_SIMD) {
+
+		// Packets overlapping leaf, lanes outside of leaf are masked
+		for (int p = leaf.first & ~3; p < end; p += 4) {
+
+			int lanes = 0;
+
+			for (int l = 0; l < 4; l++) {
+				if (p + l >= leaf.first && p + l < end) {
+					lanes |= 1 << l;
+					counters.triangles++;
+				}
+			}
+
+			TriangleIntersection::hit4 result;
+			TriangleIntersection::intersect4(r.watertight, packets[p / 4], lanes, h.t, result);
+
+			for (int l = 0; l < 4; l++) {
+				if ((result.mask >> l & 1) && result.t[l] < h.t) {
+					h.t = result.t[l];
+					h.triangle = p + l;
+
+					if (anyHit)
+						return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	for (int i = leaf.first; i < end; i++) {
+
+		counters.triangles++;
+
+		const glm::vec3* v = &vertices[3 * i];
+		float t = -1.0f, u, w;
+
+		if (kernel == MOLLER_TRUMBORE)
+			t = TriangleIntersection::mollerTrumbore(r.origin, r.direction, v[0], v[1], v[2]);
+		else if (!TriangleIntersection::intersect(r.watertight, v[0], v[1], v[2], h.t, t, u, w))
+			t = -1.0f;
+
+		if (t > 0.0f && t < h.t) {
+			h.t = t;
+			h.triangle = i;
+
+			if (anyHit)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+float CPUTracer::childTest(const traversalRay & r, const bvhPreprocessor::gpuNode & node, bool right, float tmax) const{
+
+	glm::vec3 min, max;
+	bvhPreprocessor::childBounds(node, right, min, max);
+
+	return boxTest(r, min, max, tmax);
+}
+
+float CPUTracer::boxTest(const traversalRay & r, const glm::vec3 & min, const glm::vec3 & max, float tmax) const{
+
+	float tnear = 0.0f, tfar = tmax;
+
+	for (int a = 0; a < 3; a++) {
+
+		float t1 = (min[a] - r.origin[a]) * r.invDirection[a];
+		float t2 = (max[a] - r.origin[a]) * r.invDirection[a];
+
+		// NaN (origin on plane of parallel slab) keeps previous bounds
+		tnear = std::max(tnear, std::min(t1, t2));
+		tfar = std::min(tfar, std::max(t1, t2));
+	}
+
+	return tnear <= tfar ? tnear : -1.0f;
+}
+
+void CPUTracer::touch(int node, traversal & counters) const{
+
+	if (accesses)
+		accesses[node].fetch_add(1, std::memory_order_relaxed);
+
+	if (!simulateCache)
+		return;
+
+	// Caches of thread are kept between rays of one run
+	thread_local std::vector<uint64_t> cacheLines, tlbPages;
+	thread_local unsigned epoch = 0;
+
+	const unsigned sets = CPU_TRACER_CACHE_SIZE / (CPU_TRACER_CACHE_LINE * CPU_TRACER_CACHE_WAYS);
+
+	if (epoch != cacheEpoch) {
+		cacheLines.assign(sets * CPU_TRACER_CACHE_WAYS, UINT64_MAX);
+		tlbPages.assign(CPU_TRACER_TLB_ENTRIES, UINT64_MAX);
+		epoch = cacheEpoch;
+	}
+
+	// Addresses relative to the first node (start of buffer is aligned)
+	uint64_t address = static_cast<uint64_t>(node) * sizeof(bvhPreprocessor::gpuNode);
+
+	if (!cacheAccess(cacheLines, address / CPU_TRACER_CACHE_LINE, sets, CPU_TRACER_CACHE_WAYS))
+		counters.cacheMisses++;
+
+	if (!cacheAccess(tlbPages, address / CPU_TRACER_PAGE_SIZE, 1, CPU_TRACER_TLB_ENTRIES))
+		counters.tlbMisses++;
+
+}
+
+bool CPUTracer::cacheAccess(std::vector<uint64_t>& lines, uint64_t tag, unsigned sets, unsigned ways){
+
+	uint64_t* set = &lines[(tag % sets) * ways];
+	unsigned way = 0;
+
+	while (way < ways && set[way] != tag)
+		way++;
+
+	bool hit = way < ways;
+
+	// Accessed line moves to front, the least recent one is evicted on miss
+	for (unsigned i = std::min(way, ways - 1); i > 0; i--)
+		set[i] = set[i - 1];
+
+	set[0] = tag;
+
+	return hit;
+}
+
+template<typename Trace>
+CPUTracer::rayStats CPUTracer::traceSet(std::string type, size_t count, Trace trace){
+
+	rayStats stats = { type, count, 0, 0.0, { 0, 0, 0, 0, 0, 0 } };
+	std::vector<std::future<std::pair<size_t, traversal>>> tasks;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (size_t begin = 0; begin < count; begin += CPU_TRACER_TASK_SIZE) {
+
+		size_t end = std::min(count, begin + CPU_TRACER_TASK_SIZE);
+
+		tasks.push_back(pool.submit([&trace, begin, end]() {
+			traversal counters = { 0, 0, 0, 0, 0, 0 };
+			size_t hits = 0;
+
+			for (size_t i = begin; i < end; i++)
+				if (trace(i, counters))
+					hits++;
+
+			return std::make_pair(hits, counters);
+		}));
+	}
+
+	for (auto& t : tasks) {
+		std::pair<size_t, traversal> r = t.get();
+		stats.hits += r.first;
+		stats.counters.nodes += r.second.nodes;
+		stats.counters.triangles += r.second.triangles;
+		stats.counters.stack += r.second.stack;
+		stats.counters.maxStack = std::max(stats.counters.maxStack, r.second.maxStack);
+		stats.counters.cacheMisses += r.second.cacheMisses;
+		stats.counters.tlbMisses += r.second.tlbMisses;
+	}
+
+	stats.time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	return stats;
+}
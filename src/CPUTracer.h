@@ -0,0 +1,280 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* CPUTracer.h
+*/
+
+#pragma once
+
+#include <bvhPreprocessor.h>
+#include <GeometryView.h>
+#include <ThreadPool.h>
+#include <TriangleIntersection.h>
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Number of rays traced by one task
+#define CPU_TRACER_TASK_SIZE 4096
+
+// Length of ambient occlusion rays relative to size of scene
+#define CPU_TRACER_AO_RADIUS 0.05f
+
+// Offset of secondary ray origins relative to size of scene
+#define CPU_TRACER_EPSILON 1e-4f
+
+// Simulated cache of node accesses (line pairs are fetched together by adjacent line prefetcher)
+#define CPU_TRACER_CACHE_SIZE 32768
+#define CPU_TRACER_CACHE_LINE 128
+#define CPU_TRACER_CACHE_WAYS 8
+
+// Simulated TLB of node accesses (fully associative)
+#define CPU_TRACER_PAGE_SIZE 4096
+#define CPU_TRACER_TLB_ENTRIES 64
+
+/**
+* @brief Ray tracer on CPU - traverses flattened BVH (GPU nodes) and gathers traversal statistics
+* @note Both traversals read bounds of children from their parent and visit near child by split axis first, stackless traversal is the same as in trace.cs
+* @note Triangles are tested by watertight test (default, as in trace.cs), by its version for four triangles or by previous Moller-Trumbore test
+*/
+class CPUTracer {
+
+public:
+
+	/**
+	* @brief Structure of ray (tmax limits length of ray)
+	*/
+	typedef struct {
+		glm::vec3 origin;
+		glm::vec3 direction;
+		float tmax;
+	} ray;
+
+	/**
+	* @brief Ray-triangle test of leaves
+	*/
+	typedef enum {
+		MOLLER_TRUMBORE,
+		WATERTIGHT,
+		WATERTIGHT_SIMD
+	} intersection;
+
+	/**
+	* @brief Structure of ray hit (triangle is position in order of leaves, -1 if ray missed)
+	*/
+	typedef struct {
+		float t;
+		int triangle;
+	} hit;
+
+	/**
+	* @brief Structure of traversal counters of one or more rays
+	*/
+	typedef struct {
+		uint64_t nodes;			// Visited nodes
+		uint64_t triangles;		// Ray-triangle tests
+		uint64_t stack;			// Sum of maximal stack depths of rays
+		unsigned maxStack;		// Maximal stack depth
+		uint64_t cacheMisses;	// Misses of simulated cache (only with cache simulation)
+		uint64_t tlbMisses;		// Misses of simulated TLB (only with cache simulation)
+	} traversal;
+
+	/**
+	* @brief Structure of results of one ray type
+	*/
+	typedef struct {
+		std::string type;
+		size_t rays;
+		size_t hits;
+		double time;			// Time of tracing in ms
+		traversal counters;
+	} rayStats;
+
+	/**
+	* @brief Constructor
+	* @param threads Number of tracing threads (0 - hardware concurrency)
+	*/
+	CPUTracer(unsigned threads = 0) : pool(threads) {}
+
+	/**
+	* @brief Sets BVH and triangles
+	* @param nodes Flattened BVH, root is the first node
+	* @param geometry Geometry of scene
+	* @param order Triangle of every primitive position of leaves
+	* @param lastInclusive true if last primitive of leaf is inclusive, false for CPU BVH (iterator difference)
+	*/
+	void setScene(const std::vector<bvhPreprocessor::gpuNode>& nodes, const ge::sg::GeometryView& geometry, const std::vector<unsigned>& order, bool lastInclusive);
+
+	/**
+	* @brief Finds the closest hit of ray
+	* @param r Ray
+	* @param h Output hit
+	* @param counters Traversal counters (incremented)
+	* @return true if ray hit some triangle
+	*/
+	bool intersect(const ray& r, hit& h, traversal& counters) const;
+
+	/**
+	* @brief Finds any hit of ray (traversal ends with the first hit)
+	* @param r Ray
+	* @param counters Traversal counters (incremented)
+	* @return true if ray is occluded
+	*/
+	bool occluded(const ray& r, traversal& counters) const;
+
+	/**
+	* @brief Traces primary rays from camera and shadow, ambient occlusion and diffuse rays from their hits
+	* @param eye Position of camera
+	* @param target Point in the center of image
+	* @param light Position of point light
+	* @param width, height Resolution of image
+	* @param samples Number of shadow, ambient occlusion and diffuse rays per primary hit
+	* @return Results of ray types (primary, shadow, ao, diffuse)
+	*/
+	std::vector<rayStats> run(glm::vec3 eye, glm::vec3 target, glm::vec3 light, unsigned width, unsigned height, unsigned samples);
+
+	/**
+	* @brief Sampling pass - traces the same rays as run and counts accesses of every node
+	* @param eye, target, light, width, height, samples Parameters of traced rays (see run)
+	* @return Number of accesses of every node
+	*/
+	std::vector<uint32_t> sampleAccesses(glm::vec3 eye, glm::vec3 target, glm::vec3 light, unsigned width, unsigned height, unsigned samples);
+
+	/**
+	* @brief Enables simulation of cache and TLB over node accesses (slows down tracing)
+	* @param enable true for counting of simulated misses
+	*/
+	void setCacheSimulation(bool enable);
+
+	/**
+	* @brief Selects stackless traversal (parent links, as in trace.cs) instead of traversal with stack
+	* @param enable true for stackless traversal
+	*/
+	void setStackless(bool enable);
+
+	/**
+	* @brief Selects ray-triangle test
+	* @param i Test of triangles of leaves
+	*/
+	void setIntersection(intersection i);
+
+	/**
+	* @brief Name of ray-triangle test (moller, watertight, simd)
+	*/
+	static std::string getIntersectionName(intersection i);
+
+	/**
+	* @brief Parses name of ray-triangle test
+	* @param name Name of test
+	* @param i Output test
+	* @return true if name is valid
+	*/
+	static bool parseIntersection(std::string name, intersection& i);
+
+	/**
+	* @brief Getter for bounds of scene (bounds of root node)
+	*/
+	glm::vec3 getMin();
+	glm::vec3 getMax();
+
+private:
+
+	/**
+	* @brief Structure of ray with precomputed reciprocal direction and ray of watertight test
+	*/
+	typedef struct {
+		glm::vec3 origin;
+		glm::vec3 direction;
+		glm::vec3 invDirection;
+		TriangleIntersection::ray watertight;
+	} traversalRay;
+
+	/**
+	* @brief Traverses BVH
+	* @param r Ray
+	* @param h Hit (t limits traversal)
+	* @param anyHit true if traversal ends with the first hit
+	* @param counters Traversal counters
+	* @return true if ray hit some triangle
+	*/
+	bool traverse(const ray& r, hit& h, bool anyHit, traversal& counters) const;
+
+	/**
+	* @brief Traverses BVH without stack - returns over parent links and enters far child from parent, valid for any depth
+	* @param r Ray
+	* @param h Hit (t limits traversal)
+	* @param anyHit true if traversal ends with the first hit
+	* @param counters Traversal counters
+	* @return true if ray hit some triangle
+	*/
+	bool traverseStackless(const traversalRay& r, hit& h, bool anyHit, traversal& counters) const;
+
+	/**
+	* @brief Tests triangles of leaf and updates hit
+	* @return true if traversal ends (any hit found)
+	*/
+	bool testLeaf(const traversalRay& r, const bvhPreprocessor::gpuNode& leaf, hit& h, bool anyHit, traversal& counters) const;
+
+	/**
+	* @brief Ray-box test of child with bounds stored in parent
+	* @param node Inner node
+	* @param right true for right child
+	* @return Entry distance, negative if box is missed
+	*/
+	float childTest(const traversalRay& r, const bvhPreprocessor::gpuNode& node, bool right, float tmax) const;
+
+	/**
+	* @brief Ray-box test
+	* @return Entry distance, negative if box is missed
+	*/
+	float boxTest(const traversalRay& r, const glm::vec3& min, const glm::vec3& max, float tmax) const;
+
+	/**
+	* @brief Records access of node (access counts, simulated cache and TLB)
+	* @param node Accessed node
+	* @param counters Traversal counters
+	*/
+	void touch(int node, traversal& counters) const;
+
+	/**
+	* @brief Access of set associative cache with LRU replacement
+	* @param lines Tags of cache (sets x ways, the most recent first in set)
+	* @param tag Accessed line or page
+	* @param sets, ways Geometry of cache
+	* @return true for hit
+	*/
+	static bool cacheAccess(std::vector<uint64_t>& lines, uint64_t tag, unsigned sets, unsigned ways);
+
+	/**
+	* @brief Traces ray set in parallel
+	* @param type Name of ray type
+	* @param count Number of rays
+	* @param trace Function tracing ray with index (ray index, counters), returns true for hit
+	* @return Results of ray set
+	*/
+	template<typename Trace> rayStats traceSet(std::string type, size_t count, Trace trace);
+
+	std::vector<bvhPreprocessor::gpuNode> nodes;
+	std::vector<glm::vec3> vertices;	// 3 vertices per primitive position
+	std::vector<TriangleIntersection::triangle4> packets;	// Four consecutive primitive positions per packet
+	int leafEnd = 0;					// Added to last primitive of leaf to get end of range
+
+	// Instrumentation of node accesses
+	bool simulateCache = false;
+	bool stackless = false;
+	intersection kernel = WATERTIGHT;
+	unsigned cacheEpoch = 0;			// Simulated caches of threads are cleared when epoch changes
+	std::unique_ptr<std::atomic<uint32_t>[]> accesses;
+
+	ThreadPool pool;
+
+};
@@ -0,0 +1,85 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* CameraPath.cpp
+*/
+
+#include <CameraPath.h>
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+void CameraPath::record(const Renderer::viewState & view){
+	views.push_back(view);
+}
+
+void CameraPath::clear(){
+	views.clear();
+}
+
+size_t CameraPath::size(){
+	return views.size();
+}
+
+const Renderer::viewState & CameraPath::get(size_t frame){
+	return views[frame];
+}
+
+bool CameraPath::save(std::string file){
+
+	std::ofstream output(file);
+
+	if (!output.is_open())
+		return false;
+
+	// Exact float values - replay renders identical images
+	output.precision(std::numeric_limits<float>::max_digits10);
+	output << "camera_path " << CAMERA_PATH_VERSION << " " << views.size() << std::endl;
+
+	// Position, yaw, pitch, zoom and position of light on every line
+	for (auto& v : views) {
+		output << v.position.x << " " << v.position.y << " " << v.position.z << " " << v.yaw << " " << v.pitch << " " << v.zoom << " "
+			<< v.light.x << " " << v.light.y << " " << v.light.z << std::endl;
+	}
+
+	return static_cast<bool>(output);
+}
+
+bool CameraPath::load(std::string file){
+
+	std::ifstream input(file);
+
+	if (!input.is_open()) {
+		std::cout << "Camera path " << file << " not found" << std::endl;
+		return false;
+	}
+
+	std::string magic;
+	unsigned version;
+	size_t count;
+
+	input >> magic >> version >> count;
+
+	if (!input || magic != "camera_path" || version != CAMERA_PATH_VERSION) {
+		std::cout << "Camera path " << file << " has unknown format" << std::endl;
+		return false;
+	}
+
+	views.resize(count);
+
+	for (auto& v : views)
+		input >> v.position.x >> v.position.y >> v.position.z >> v.yaw >> v.pitch >> v.zoom >> v.light.x >> v.light.y >> v.light.z;
+
+	if (!input) {
+		std::cout << "Camera path " << file << " is incomplete" << std::endl;
+		views.clear();
+		return false;
+	}
+
+	return true;
+}
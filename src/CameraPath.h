@@ -0,0 +1,73 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* CameraPath.h
+*/
+
+#pragma once
+
+#include <Renderer.h>
+
+#include <string>
+#include <vector>
+
+// Default file of recorded camera path
+#define CAMERA_PATH_FILE "camera.path"
+
+// Version of camera path file format
+#define CAMERA_PATH_VERSION 1
+
+/**
+* @brief Recorded views (camera pose and light position) of frames, replayed at fixed timestep (one view per frame)
+*/
+class CameraPath {
+
+public:
+
+	/**
+	* @brief Appends view of next frame
+	* @param view Camera pose and light position
+	*/
+	void record(const Renderer::viewState& view);
+
+	/**
+	* @brief Removes all recorded views
+	*/
+	void clear();
+
+	/**
+	* @brief Getter for number of frames
+	* @return Number of recorded views
+	*/
+	size_t size();
+
+	/**
+	* @brief Getter for view of frame
+	* @param frame Index of frame
+	* @return View of frame
+	*/
+	const Renderer::viewState& get(size_t frame);
+
+	/**
+	* @brief Writes path into text file
+	* @param file Path to file
+	* @return true if success
+	*/
+	bool save(std::string file);
+
+	/**
+	* @brief Reads path from text file
+	* @param file Path to file
+	* @return true if success
+	*/
+	bool load(std::string file);
+
+private:
+
+	std::vector<Renderer::viewState> views;
+
+};
@@ -0,0 +1,462 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* ClusterCache.cpp
+*/
+
+#include <ClusterCache.h>
+#include <MortonCode.h>
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cstdio>
+
+/**
+* @brief Interleaves bits of grid coordinates (Morton order of cells)
+*/
+static unsigned cellCode(unsigned x, unsigned y, unsigned z){
+	return ge::sg::MortonCode::expandBits(x) * 4 + ge::sg::MortonCode::expandBits(y) * 2 + ge::sg::MortonCode::expandBits(z);
+}
+
+/**
+* @brief Centroid of triangle
+*/
+static glm::vec3 centroid(const Scene::gpu_triangle& t){
+	return (glm::vec3(t.coord_a) + glm::vec3(t.coord_b) + glm::vec3(t.coord_c)) / 3.0f;
+}
+
+ClusterCache::~ClusterCache(){
+
+	if (output.is_open())
+		output.close();
+
+	if (!path.empty())
+		std::remove(path.c_str());
+
+}
+
+void ClusterCache::setMemoryBudget(size_t bytes){
+	memoryBudget = bytes;
+}
+
+void ClusterCache::setGpuBudget(size_t bytes){
+	gpuBudget = bytes;
+}
+
+bool ClusterCache::begin(std::string file, glm::vec3 sceneMin, glm::vec3 sceneMax){
+
+	path = file;
+	output.open(path, std::ios::binary | std::ios::trunc);
+
+	if (!output.is_open()) {
+		std::cout << "Cluster file " << path << " cannot be created" << std::endl;
+		path.clear();
+		return false;
+	}
+
+	clusters.clear();
+	cells.clear();
+	fileSize = 0;
+
+	// Scene bounds are divided into 2^bits cells per axis
+	gridMin = sceneMin;
+	gridScale = static_cast<float>(1 << CLUSTER_GRID_BITS) / glm::max(sceneMax - sceneMin, glm::vec3(1e-6f));
+
+	return true;
+}
+
+void ClusterCache::insert(const Scene::gpu_triangle & t){
+
+	glm::vec3 cellPos = glm::clamp((centroid(t) - gridMin) * gridScale, glm::vec3(0.0f), glm::vec3(static_cast<float>((1 << CLUSTER_GRID_BITS) - 1)));
+	cell& c = cells[cellCode(static_cast<unsigned>(cellPos.x), static_cast<unsigned>(cellPos.y), static_cast<unsigned>(cellPos.z))];
+
+	if (c.triangles.empty()) {
+		c.min = glm::vec3(std::numeric_limits<float>::max());
+		c.max = glm::vec3(std::numeric_limits<float>::lowest());
+	}
+
+	c.triangles.push_back(t);
+	c.min = glm::min(c.min, glm::min(glm::vec3(t.coord_a), glm::min(glm::vec3(t.coord_b), glm::vec3(t.coord_c))));
+	c.max = glm::max(c.max, glm::max(glm::vec3(t.coord_a), glm::max(glm::vec3(t.coord_b), glm::vec3(t.coord_c))));
+
+	// Full cluster goes on disk
+	if (c.triangles.size() == CLUSTER_MAX_TRIANGLES)
+		flush(c);
+
+}
+
+bool ClusterCache::finish(){
+
+	// Partially filled cells (in Morton order of cells)
+	for (auto& c : cells) {
+		if (!c.second.triangles.empty())
+			flush(c.second);
+	}
+
+	cells.clear();
+	output.close();
+
+	if (!output)
+		return false;
+
+	// Top of BVH over cluster bounds
+	topNodes.clear();
+	std::vector<int> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	if (!clusters.empty())
+		buildTop(order, 0, static_cast<int>(order.size()), -1);
+
+	// Empty scene - root is empty leaf
+	else {
+		bvhPreprocessor::gpuNode n = {};
+		n.left = n.right = n.parent = n.sibling = -1;
+		n.last = -1;
+		topNodes.push_back(n);
+	}
+
+	bvhPreprocessor::encodeChildren(topNodes);
+
+	// GPU slots
+	size_t slotCount = std::min(std::max(gpuBudget / getSlotSize(), static_cast<size_t>(1)), std::max(clusters.size(), static_cast<size_t>(1)));
+	slots.assign(slotCount, -1);
+	slotNodes.assign(slotCount, std::vector<bvhPreprocessor::gpuNode>());
+
+	nodes = topNodes;
+
+	std::cout << "Scene partitioned into " << clusters.size() << " clusters (" << slotCount << " GPU slots)" << std::endl;
+
+	return true;
+}
+
+bool ClusterCache::update(glm::vec3 viewPos){
+
+	pageIns.clear();
+	frame++;
+
+	// Demand - clusters nearest to viewer, as many as fits into GPU slots
+	distances.resize(clusters.size());
+
+	for (size_t i = 0; i < clusters.size(); i++) {
+		glm::vec3 d = glm::max(glm::max(clusters[i].min - viewPos, viewPos - clusters[i].max), glm::vec3(0.0f));
+		distances[i] = std::make_pair(glm::dot(d, d), static_cast<int>(i));
+	}
+
+	size_t demanded = std::min(slots.size(), distances.size());
+	std::partial_sort(distances.begin(), distances.begin() + demanded, distances.end());
+
+	for (size_t i = 0; i < demanded; i++)
+		clusters[distances[i].second].lastUsed = frame;
+
+	// Clusters read by workers (after demand - requested clusters are pinned in cache)
+	{
+		std::unique_lock<std::mutex> lock(loadedMutex);
+
+		while (!loaded.empty()) {
+			clusters[loaded.front().first].loading = false;
+			cache(loaded.front().first, loaded.front().second);
+			loaded.pop_front();
+		}
+	}
+
+	bool changed = false;
+
+	for (size_t i = 0; i < demanded && pageIns.size() < CLUSTER_UPLOADS_PER_UPDATE; i++) {
+
+		int id = distances[i].second;
+		cluster& c = clusters[id];
+
+		if (c.slot != -1)
+			continue;
+
+		// Cluster is not in main memory - read it from disk
+		auto it = cached.find(id);
+		if (it == cached.end()) {
+			if (!c.loading) {
+				c.loading = true;
+				pool.submit([this, id]() { read(id); });
+			}
+			continue;
+		}
+
+		// Touch in LRU order
+		lru.splice(lru.begin(), lru, it->second);
+
+		// Free slot or slot of least recently used cluster, which is not demanded
+		int slot = -1;
+		uint64_t oldest = frame;
+
+		for (size_t s = 0; s < slots.size(); s++) {
+
+			if (slots[s] == -1) {
+				slot = static_cast<int>(s);
+				break;
+			}
+
+			if (clusters[slots[s]].lastUsed < oldest) {
+				oldest = clusters[slots[s]].lastUsed;
+				slot = static_cast<int>(s);
+			}
+		}
+
+		if (slot == -1)
+			break;
+
+		if (slots[slot] != -1)
+			clusters[slots[slot]].slot = -1;
+
+		slots[slot] = id;
+		slotNodes[slot] = it->second->second->nodes;
+		c.slot = slot;
+
+		pageIns.push_back({ slot, it->second->second });
+		changed = true;
+	}
+
+	if (changed)
+		assemble();
+
+	return changed;
+}
+
+std::vector<ClusterCache::pageIn>& ClusterCache::getPageIns(){
+	return pageIns;
+}
+
+std::vector<bvhPreprocessor::gpuNode>& ClusterCache::getNodes(){
+	return nodes;
+}
+
+size_t ClusterCache::getSlotCount(){
+	return slots.size();
+}
+
+size_t ClusterCache::getSlotSize(){
+	return CLUSTER_MAX_TRIANGLES * sizeof(Scene::gpu_triangle);
+}
+
+size_t ClusterCache::getClusterCount(){
+	return clusters.size();
+}
+
+void ClusterCache::flush(cell & c){
+
+	cluster cl;
+	cl.min = c.min;
+	cl.max = c.max;
+	cl.offset = fileSize;
+	cl.count = static_cast<unsigned>(c.triangles.size());
+	cl.leaf = -1;
+	cl.slot = -1;
+	cl.loading = false;
+	cl.lastUsed = 0;
+
+	size_t size = c.triangles.size() * sizeof(Scene::gpu_triangle);
+	output.write(reinterpret_cast<const char*>(c.triangles.data()), size);
+	fileSize += size;
+
+	clusters.push_back(cl);
+
+	c.triangles.clear();
+
+}
+
+int ClusterCache::buildTop(std::vector<int>& order, int begin, int end, int parent){
+
+	int id = static_cast<int>(topNodes.size());
+
+	bvhPreprocessor::gpuNode n;
+	n._min = glm::vec4(std::numeric_limits<float>::max());
+	n._max = glm::vec4(std::numeric_limits<float>::lowest());
+
+	for (int i = begin; i < end; i++) {
+		n._min = glm::min(n._min, glm::vec4(clusters[order[i]].min, 0.0f));
+		n._max = glm::max(n._max, glm::vec4(clusters[order[i]].max, 0.0f));
+	}
+
+	n.parent = parent;
+	n.sibling = -1;
+	n.bounds = 0;
+	n.axis = -1;
+	topNodes.push_back(n);
+
+	// Leaf - cluster, which is not resident yet (empty range)
+	if (end - begin == 1) {
+		topNodes[id].left = topNodes[id].right = -1;
+		topNodes[id].first = 0;
+		topNodes[id].last = -1;
+		clusters[order[begin]].leaf = id;
+		return id;
+	}
+
+	// Median split of cluster centroids on the longest axis
+	glm::vec3 extent = glm::vec3(n._max - n._min);
+	int axis = extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2;
+	int middle = (begin + end) / 2;
+
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [this, axis](int a, int b) {
+		return clusters[a].min[axis] + clusters[a].max[axis] < clusters[b].min[axis] + clusters[b].max[axis];
+	});
+
+	int left = buildTop(order, begin, middle, id);
+	int right = buildTop(order, middle, end, id);
+
+	topNodes[id].left = left;
+	topNodes[id].right = right;
+	topNodes[id].first = topNodes[id].last = -1;
+	topNodes[id].axis = axis;
+	topNodes[left].sibling = right;
+	topNodes[right].sibling = left;
+
+	return id;
+}
+
+void ClusterCache::read(int id){
+
+	auto data = std::make_shared<clusterData>();
+	data->triangles.resize(clusters[id].count);
+
+	std::ifstream input(path, std::ios::binary);
+	input.seekg(static_cast<std::streamoff>(clusters[id].offset));
+	input.read(reinterpret_cast<char*>(data->triangles.data()), data->triangles.size() * sizeof(Scene::gpu_triangle));
+
+	if (!input) {
+		std::cout << "Cluster " << id << " reading failed" << std::endl;
+		data->triangles.clear();
+	}
+
+	if (!data->triangles.empty()) {
+		buildCluster(*data, 0, static_cast<int>(data->triangles.size()), -1);
+		bvhPreprocessor::encodeChildren(data->nodes);
+	}
+
+	std::unique_lock<std::mutex> lock(loadedMutex);
+	loaded.push_back(std::make_pair(id, data));
+
+}
+
+int ClusterCache::buildCluster(clusterData & data, int begin, int end, int parent){
+
+	int id = static_cast<int>(data.nodes.size());
+
+	bvhPreprocessor::gpuNode n;
+	n._min = glm::vec4(std::numeric_limits<float>::max());
+	n._max = glm::vec4(std::numeric_limits<float>::lowest());
+
+	for (int i = begin; i < end; i++) {
+		auto& t = data.triangles[i];
+		n._min = glm::min(n._min, glm::min(t.coord_a, glm::min(t.coord_b, t.coord_c)));
+		n._max = glm::max(n._max, glm::max(t.coord_a, glm::max(t.coord_b, t.coord_c)));
+	}
+
+	n._min.w = n._max.w = 0.0f;
+	n.parent = parent;
+	n.sibling = -1;
+	n.bounds = 0;
+	n.axis = -1;
+	data.nodes.push_back(n);
+
+	if (end - begin <= CLUSTER_LEAF_SIZE) {
+		data.nodes[id].left = data.nodes[id].right = -1;
+		data.nodes[id].first = begin;
+		data.nodes[id].last = end - 1;
+		return id;
+	}
+
+	glm::vec3 extent = glm::vec3(n._max - n._min);
+	int axis = extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2;
+	int middle = (begin + end) / 2;
+
+	std::nth_element(data.triangles.begin() + begin, data.triangles.begin() + middle, data.triangles.begin() + end, [axis](const Scene::gpu_triangle& a, const Scene::gpu_triangle& b) {
+		return centroid(a)[axis] < centroid(b)[axis];
+	});
+
+	int left = buildCluster(data, begin, middle, id);
+	int right = buildCluster(data, middle, end, id);
+
+	data.nodes[id].left = left;
+	data.nodes[id].right = right;
+	data.nodes[id].first = data.nodes[id].last = -1;
+	data.nodes[id].axis = axis;
+	data.nodes[left].sibling = right;
+	data.nodes[right].sibling = left;
+
+	return id;
+}
+
+void ClusterCache::cache(int id, std::shared_ptr<clusterData> data){
+
+	lru.push_front(std::make_pair(id, data));
+	cached[id] = lru.begin();
+	memoryUsed += data->triangles.size() * sizeof(Scene::gpu_triangle) + data->nodes.size() * sizeof(bvhPreprocessor::gpuNode);
+
+	// Eviction of least recently used clusters, pinned clusters stay even over budget
+	auto victim = lru.end();
+
+	while (memoryUsed > memoryBudget && victim != lru.begin()) {
+
+		--victim;
+
+		if (pinned(victim->first))
+			continue;
+
+		memoryUsed -= victim->second->triangles.size() * sizeof(Scene::gpu_triangle) + victim->second->nodes.size() * sizeof(bvhPreprocessor::gpuNode);
+
+		cached.erase(victim->first);
+		victim = lru.erase(victim);
+	}
+
+}
+
+bool ClusterCache::pinned(int id){
+	return clusters[id].slot == -1 && clusters[id].lastUsed == frame;
+}
+
+void ClusterCache::assemble(){
+
+	nodes = topNodes;
+
+	// BVH of resident cluster replaces its leaf in top of BVH
+	for (size_t s = 0; s < slots.size(); s++) {
+
+		if (slots[s] == -1 || slotNodes[s].empty())
+			continue;
+
+		int leaf = clusters[slots[s]].leaf;
+		int base = static_cast<int>(nodes.size());
+		int slotOffset = static_cast<int>(s * CLUSTER_MAX_TRIANGLES);
+
+		auto global = [leaf, base](int local) { return local == -1 ? -1 : local == 0 ? leaf : base + local - 1; };
+
+		for (size_t i = 0; i < slotNodes[s].size(); i++) {
+
+			bvhPreprocessor::gpuNode n = slotNodes[s][i];
+
+			if (n.left != -1 || n.right != -1) {
+				n.left = global(n.left);
+				n.right = global(n.right);
+			}
+			else {
+				n.first += slotOffset;
+				n.last += slotOffset;
+			}
+
+			if (i == 0) {
+				n.parent = topNodes[leaf].parent;
+				n.sibling = topNodes[leaf].sibling;
+				nodes[leaf] = n;
+			}
+			else {
+				n.parent = global(n.parent);
+				n.sibling = global(n.sibling);
+				nodes.push_back(n);
+			}
+		}
+	}
+
+}
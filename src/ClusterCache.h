@@ -0,0 +1,263 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* ClusterCache.h
+*/
+
+#pragma once
+
+#include <Scene.h>
+#include <ThreadPool.h>
+#include <bvhPreprocessor.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <fstream>
+
+// Extension of file with clusters (stored next to scene file, removed with cache)
+#define CLUSTER_FILE_EXTENSION ".rtcl"
+
+// Maximum number of triangles in one cluster (size of GPU slot)
+#define CLUSTER_MAX_TRIANGLES 1024
+
+// Number of bits per axis of partitioning grid (Morton order of cells, at most 10)
+#define CLUSTER_GRID_BITS 3
+
+// Maximum number of triangles in leaf of cluster BVH
+#define CLUSTER_LEAF_SIZE 4
+
+// Maximum number of clusters uploaded on GPU during one update call
+#define CLUSTER_UPLOADS_PER_UPDATE 1
+
+// Default budgets of resident clusters (in bytes)
+#define CLUSTER_MEMORY_BUDGET (256 * 1024 * 1024)
+#define CLUSTER_GPU_BUDGET (256 * 1024 * 1024)
+
+/**
+* @brief Out-of-core geometry - spatial clusters stored on disk, paged in on demand with LRU eviction
+* @note Top of BVH is built over cluster bounds, BVH of cluster is built when cluster is paged in
+*/
+class ClusterCache {
+
+public:
+
+	/**
+	* @brief Structure of paged in cluster (triangles and BVH with local indices)
+	*/
+	typedef struct {
+		std::vector<Scene::gpu_triangle> triangles;
+		std::vector<bvhPreprocessor::gpuNode> nodes;
+	} clusterData;
+
+	/**
+	* @brief Structure of cluster, which has to be uploaded into GPU slot
+	*/
+	typedef struct {
+		int slot;
+		std::shared_ptr<clusterData> data;
+	} pageIn;
+
+	/**
+	* @brief Constructor
+	* @param threads Number of threads used for reading of clusters
+	*/
+	ClusterCache(unsigned threads = 1) : pool(threads) {}
+
+	/**
+	* @brief Destructor, removes file with clusters
+	*/
+	~ClusterCache();
+
+	/**
+	* @brief Sets maximum size of clusters kept in main memory
+	* @param bytes Memory budget in bytes
+	*/
+	void setMemoryBudget(size_t bytes);
+
+	/**
+	* @brief Sets maximum size of clusters resident on GPU (number of GPU slots)
+	* @param bytes GPU memory budget in bytes
+	*/
+	void setGpuBudget(size_t bytes);
+
+	/**
+	* @brief Starts partitioning of geometry
+	* @param file Path to file with clusters
+	* @param sceneMin Minimal coordinates of scene bounds
+	* @param sceneMax Maximal coordinates of scene bounds
+	* @return true if file was created
+	*/
+	bool begin(std::string file, glm::vec3 sceneMin, glm::vec3 sceneMax);
+
+	/**
+	* @brief Inserts triangle into cluster of its grid cell (full clusters are written on disk)
+	* @param t Triangle
+	*/
+	void insert(const Scene::gpu_triangle& t);
+
+	/**
+	* @brief Finishes partitioning, builds top of BVH over cluster bounds
+	* @return true if success
+	*/
+	bool finish();
+
+	/**
+	* @brief Updates residency of clusters (clusters nearest to viewer are requested)
+	* @param viewPos Position of viewer
+	* @return true if residency has changed (new clusters have to be uploaded, nodes have changed)
+	*/
+	bool update(glm::vec3 viewPos);
+
+	/**
+	* @brief Getter for clusters paged in by last update call
+	* @return Vector of clusters for upload
+	*/
+	std::vector<pageIn>& getPageIns();
+
+	/**
+	* @brief Getter for BVH (top of BVH with BVHs of resident clusters)
+	* @return Vector of GPU nodes, leaves index triangles in GPU slots
+	*/
+	std::vector<bvhPreprocessor::gpuNode>& getNodes();
+
+	/**
+	* @brief Getter for number of GPU slots
+	* @return Number of clusters resident on GPU at once
+	*/
+	size_t getSlotCount();
+
+	/**
+	* @brief Getter for size of GPU slot
+	* @return Size of slot in bytes
+	*/
+	size_t getSlotSize();
+
+	/**
+	* @brief Getter for number of clusters
+	* @return Number of clusters in scene
+	*/
+	size_t getClusterCount();
+
+private:
+
+	/**
+	* @brief Structure of cluster description
+	*/
+	typedef struct {
+		glm::vec3 min, max;
+		uint64_t offset;
+		unsigned count;
+		int leaf;
+		int slot;
+		bool loading;
+		uint64_t lastUsed;
+	} cluster;
+
+	/**
+	* @brief Structure of partially filled cluster of grid cell
+	*/
+	typedef struct {
+		std::vector<Scene::gpu_triangle> triangles;
+		glm::vec3 min, max;
+	} cell;
+
+	/**
+	* @brief Writes triangles of grid cell on disk as new cluster
+	* @param c Grid cell
+	*/
+	void flush(cell& c);
+
+	/**
+	* @brief Builds node of top of BVH over clusters
+	* @param order Cluster ids
+	* @param begin First cluster in node
+	* @param end Cluster after last cluster in node
+	* @param parent Index of parent node
+	* @return Index of node
+	*/
+	int buildTop(std::vector<int>& order, int begin, int end, int parent);
+
+	/**
+	* @brief Reads cluster from disk and builds its BVH (runs in worker thread)
+	* @param id Cluster id
+	*/
+	void read(int id);
+
+	/**
+	* @brief Builds node of cluster BVH (median split on the longest axis)
+	* @param data Cluster, triangles are reordered
+	* @param begin First triangle in node
+	* @param end Triangle after last triangle in node
+	* @param parent Index of parent node
+	* @return Index of node
+	*/
+	int buildCluster(clusterData& data, int begin, int end, int parent);
+
+	/**
+	* @brief Inserts cluster into main memory cache, evicts least recently used clusters over budget (except pinned clusters)
+	* @param id Cluster id
+	* @param data Cluster data
+	*/
+	void cache(int id, std::shared_ptr<clusterData> data);
+
+	/**
+	* @brief Checks, if cluster can not be evicted from main memory - it is requested in current frame and it is not uploaded yet
+	* @param id Cluster id
+	* @return true if cluster is pinned
+	*/
+	bool pinned(int id);
+
+	/**
+	* @brief Connects BVHs of resident clusters to leaves of top of BVH
+	*/
+	void assemble();
+
+	// Clusters and their file
+	std::vector<cluster> clusters;
+	std::string path;
+	std::ofstream output;
+	uint64_t fileSize = 0;
+
+	// Partitioning grid
+	std::map<unsigned, cell> cells;
+	glm::vec3 gridMin, gridScale;
+
+	// Top of BVH and whole BVH with resident clusters
+	std::vector<bvhPreprocessor::gpuNode> topNodes;
+	std::vector<bvhPreprocessor::gpuNode> nodes;
+
+	// Main memory cache (LRU order, the most recent first)
+	std::list<std::pair<int, std::shared_ptr<clusterData>>> lru;
+	std::map<int, std::list<std::pair<int, std::shared_ptr<clusterData>>>::iterator> cached;
+	size_t memoryBudget = CLUSTER_MEMORY_BUDGET;
+	size_t memoryUsed = 0;
+
+	// GPU slots (cluster id and BVH of cluster in slot)
+	std::vector<int> slots;
+	std::vector<std::vector<bvhPreprocessor::gpuNode>> slotNodes;
+	std::vector<pageIn> pageIns;
+	size_t gpuBudget = CLUSTER_GPU_BUDGET;
+	uint64_t frame = 0;
+
+	// Squared distances of clusters from viewer (reused by every update)
+	std::vector<std::pair<float, int>> distances;
+
+	// Clusters read by workers
+	std::deque<std::pair<int, std::shared_ptr<clusterData>>> loaded;
+	std::mutex loadedMutex;
+
+	// Reading threads (declared last - workers have to finish before other members are destroyed)
+	ThreadPool pool;
+
+};
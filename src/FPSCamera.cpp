@@ -18,25 +18,21 @@ FPSCamera::FPSCamera() {}
 FPSCamera::~FPSCamera() {}
 
 
-std::vector<glm::vec3> FPSCamera::getScreenCoords() {
+std::array<glm::vec3, 4> FPSCamera::getScreenCoords() {
 
-	std::vector<glm::vec3> scrCoords;
+	std::array<glm::vec3, 4> scrCoords;
 
 	// Left down corner
-	glm::vec3 tmp = (position - right - up) + (2.0f * front);
-	scrCoords.push_back(glm::vec3(tmp.x, tmp.y, tmp.z));
+	scrCoords[0] = (position - right - up) + (2.0f * front);
 
 	// Left top corner
-	tmp = (position - right + up) + (2.0f * front);
-	scrCoords.push_back(glm::vec3(tmp.x, tmp.y, tmp.z));
+	scrCoords[1] = (position - right + up) + (2.0f * front);
 
 	// Right down corner
-	tmp = (position + right - up) + (2.0f * front);
-	scrCoords.push_back(glm::vec3(tmp.x, tmp.y, tmp.z));
+	scrCoords[2] = (position + right - up) + (2.0f * front);
 
 	// Right top corner
-	tmp = (position + right + up) + (2.0f * front);
-	scrCoords.push_back(glm::vec3(tmp.x, tmp.y, tmp.z));
+	scrCoords[3] = (position + right + up) + (2.0f * front);
 
 	return scrCoords;
 }
@@ -12,7 +12,7 @@
 
 #include <Camera.h>
 
-#include <vector>
+#include <array>
 
 /**
 * @brief Camera implementation, First person view camera
@@ -35,9 +35,9 @@ public:
 
 	/**
 	* @brief Computes screen plane coordinations
-	* @return Vector of screen planes coordinations
+	* @return Corners of screen plane (left down, left top, right down, right top)
 	*/
-	std::vector<glm::vec3> getScreenCoords();
+	std::array<glm::vec3, 4> getScreenCoords();
 
 
 	/**
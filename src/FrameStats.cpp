@@ -0,0 +1,94 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* FrameStats.cpp
+*/
+
+#include <FrameStats.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+
+void FrameStats::reset(double rays, size_t count){
+	frames.clear();
+	frames.reserve(count);
+	raysPerFrame = rays;
+}
+
+void FrameStats::add(frame f){
+	frames.push_back(f);
+}
+
+FrameStats::summary FrameStats::compute(){
+
+	summary s = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	if (frames.empty())
+		return s;
+
+	std::vector<double> sorted;
+
+	for (auto& f : frames)
+		sorted.push_back(f.total);
+
+	std::sort(sorted.begin(), sorted.end());
+
+	for (double t : sorted)
+		s.mean += t;
+
+	s.mean /= sorted.size();
+	s.p50 = percentile(sorted, 50.0);
+	s.p95 = percentile(sorted, 95.0);
+	s.p99 = percentile(sorted, 99.0);
+	s.min = sorted.front();
+	s.max = sorted.back();
+	s.raysPerSecond = s.mean > 0.0 ? raysPerFrame / (s.mean / 1000.0) : 0.0;
+
+	return s;
+}
+
+bool FrameStats::write(std::string file){
+
+	std::ofstream output(file);
+
+	if (!output.is_open())
+		return false;
+
+	output << "frame,submit_ms,gpu_wait_ms,total_ms" << std::endl;
+
+	for (size_t i = 0; i < frames.size(); i++)
+		output << i << "," << frames[i].submit << "," << frames[i].total - frames[i].submit << "," << frames[i].total << std::endl;
+
+	summary s = compute();
+
+	output << std::endl << "mean_ms,p50_ms,p95_ms,p99_ms,min_ms,max_ms,rays_per_second" << std::endl;
+	output << s.mean << "," << s.p50 << "," << s.p95 << "," << s.p99 << "," << s.min << "," << s.max << "," << s.raysPerSecond << std::endl;
+
+	return static_cast<bool>(output);
+}
+
+void FrameStats::print(){
+
+	summary s = compute();
+
+	std::cout << frames.size() << " frames - mean " << s.mean << " ms, p50 " << s.p50 << " ms, p95 " << s.p95 << " ms, p99 " << s.p99 << " ms, "
+		<< (s.raysPerSecond / 1000000.0) << " Mrays/s" << std::endl;
+
+}
+
+double FrameStats::rays(int width, int height, int shadowSamples, int indirectSamples, int aoSamples){
+	return static_cast<double>(width) * height * (1 + shadowSamples + indirectSamples + aoSamples);
+}
+
+double FrameStats::percentile(const std::vector<double>& sorted, double p){
+
+	size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+
+	return sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1];
+}
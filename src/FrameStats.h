@@ -0,0 +1,94 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* FrameStats.h
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+* @brief Timing of rendered frames and their summary statistics
+*/
+class FrameStats {
+
+public:
+
+	/**
+	* @brief Structure of frame timing (in milliseconds)
+	*/
+	typedef struct {
+		double submit;		// Recording of commands on CPU
+		double total;		// Whole frame including wait for GPU
+	} frame;
+
+	/**
+	* @brief Structure of summary statistics of frame times (in milliseconds)
+	*/
+	typedef struct {
+		double mean, p50, p95, p99, min, max;
+		double raysPerSecond;
+	} summary;
+
+	/**
+	* @brief Clears measured frames
+	* @param rays Number of rays of one frame (estimate from resolution and sample counts)
+	* @param count Expected number of frames (reserved, adding of frames does not allocate)
+	*/
+	void reset(double rays, size_t count = 0);
+
+	/**
+	* @brief Adds timing of frame
+	* @param f Frame timing
+	*/
+	void add(frame f);
+
+	/**
+	* @brief Computes summary statistics of total frame times
+	* @return Summary statistics
+	*/
+	summary compute();
+
+	/**
+	* @brief Writes per-frame breakdown and summary into CSV file
+	* @param file Path to file
+	* @return true if success
+	*/
+	bool write(std::string file);
+
+	/**
+	* @brief Prints summary statistics
+	*/
+	void print();
+
+	/**
+	* @brief Estimates rays of frame (primary ray with shadow, indirect and ambient occlusion rays of every pixel)
+	* @param width Width of image
+	* @param height Height of image
+	* @param shadowSamples Shadow rays per pixel
+	* @param indirectSamples Indirect rays per pixel
+	* @param aoSamples Ambient occlusion rays per pixel
+	* @return Number of rays
+	*/
+	static double rays(int width, int height, int shadowSamples, int indirectSamples, int aoSamples);
+
+private:
+
+	/**
+	* @brief Percentile of sorted times (nearest rank)
+	* @param sorted Sorted times
+	* @param p Percentile in range 0 - 100
+	* @return Time of percentile
+	*/
+	static double percentile(const std::vector<double>& sorted, double p);
+
+	std::vector<frame> frames;
+	double raysPerFrame = 0.0;
+
+};
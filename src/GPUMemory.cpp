@@ -0,0 +1,29 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* GPUMemory.cpp
+*/
+
+#include <GPUMemory.h>
+
+std::shared_ptr<ge::gl::Buffer> GPUMemory::createBuffer(AllocationCounter::subsystem s, GLsizeiptr size, const void * data){
+
+	AllocationCounter::addGpuBytes(s, size);
+
+	// Current size is subtracted (buffer could be reallocated by resizeBuffer)
+	return std::shared_ptr<ge::gl::Buffer>(new ge::gl::Buffer(size, data), [s](ge::gl::Buffer* buffer) {
+		AllocationCounter::addGpuBytes(s, -static_cast<std::ptrdiff_t>(buffer->getSize()));
+		delete buffer;
+	});
+}
+
+void GPUMemory::resizeBuffer(AllocationCounter::subsystem s, std::shared_ptr<ge::gl::Buffer> buffer, GLsizeiptr size){
+
+	AllocationCounter::addGpuBytes(s, size - buffer->getSize());
+	buffer->realloc(size);
+
+}
@@ -0,0 +1,43 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* GPUMemory.h
+*/
+
+#pragma once
+
+#include <geGL/geGL.h>
+
+#include <AllocationCounter.h>
+
+#include <memory>
+
+/**
+* @brief Accounted GPU buffers - size of buffer is added to GPU memory of subsystem until buffer is deleted
+*/
+class GPUMemory {
+
+public:
+
+	/**
+	* @brief Creates accounted buffer
+	* @param s Subsystem, which owns buffer
+	* @param size Size of buffer in bytes
+	* @param data Initial data (nullptr - uninitialized)
+	* @return Buffer, its size is subtracted from subsystem when the last reference is released
+	*/
+	static std::shared_ptr<ge::gl::Buffer> createBuffer(AllocationCounter::subsystem s, GLsizeiptr size, const void* data = nullptr);
+
+	/**
+	* @brief Reallocates accounted buffer (content is not kept)
+	* @param s Subsystem, which owns buffer
+	* @param buffer Buffer created by createBuffer
+	* @param size New size in bytes
+	*/
+	static void resizeBuffer(AllocationCounter::subsystem s, std::shared_ptr<ge::gl::Buffer> buffer, GLsizeiptr size);
+
+};
@@ -0,0 +1,123 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* GPUTimer.cpp
+*/
+
+#include <GPUTimer.h>
+
+#include <algorithm>
+#include <cstring>
+
+GPUTimer::GPUTimer(unsigned latency){
+	frames.resize(std::max(latency, 1u));
+}
+
+GPUTimer::~GPUTimer(){
+
+	for (auto& f : frames)
+		if (!f.queries.empty())
+			ge::gl::glDeleteQueries(static_cast<GLsizei>(f.queries.size()), f.queries.data());
+
+}
+
+void GPUTimer::begin(const char * name){
+
+	unsigned index = 0;
+
+	// Few phases, linear search without allocation
+	while (index < phases.size() && std::strcmp(phases[index].name, name) != 0)
+		index++;
+
+	if (index == phases.size())
+		phases.push_back({ name, std::vector<float>(GPU_TIMER_HISTORY, 0.0f), 0, 0.0f });
+
+	frame& f = frames[current];
+
+	f.zones.push_back({ index, timestamp(), 0, static_cast<unsigned>(open.size()) });
+	open.push_back(static_cast<unsigned>(f.zones.size()) - 1);
+
+}
+
+void GPUTimer::end(){
+
+	if (open.empty())
+		return;
+
+	frames[current].zones[open.back()].end = timestamp();
+	open.pop_back();
+
+}
+
+void GPUTimer::nextFrame(){
+
+	// Unfinished zones belong to next frame
+	if (!open.empty())
+		return;
+
+	current = (current + 1) % frames.size();
+
+	// The oldest frame in flight is reused
+	resolve(frames[current]);
+
+}
+
+const std::vector<GPUTimer::phase>& GPUTimer::getPhases(){
+	return phases;
+}
+
+unsigned GPUTimer::timestamp(){
+
+	frame& f = frames[current];
+
+	// Queries are created once, later frames reuse them
+	if (f.used == f.queries.size()) {
+		GLuint query;
+		ge::gl::glGenQueries(1, &query);
+		f.queries.push_back(query);
+	}
+
+	ge::gl::glQueryCounter(f.queries[f.used], GL_TIMESTAMP);
+
+	return f.used++;
+}
+
+void GPUTimer::resolve(frame & f){
+
+	if (f.used > 0) {
+
+		// Results are available in order of submission, the last one is checked
+		GLint available = 0;
+		ge::gl::glGetQueryObjectiv(f.queries[f.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (available) {
+
+			// GPU clock is moved to time of profiler (zones are placed on GPU thread of trace)
+			GLint64 gpuNow = 0;
+			ge::gl::glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+			int64_t offset = static_cast<int64_t>(Profiler::now()) - gpuNow;
+
+			for (auto& z : f.zones) {
+
+				GLuint64 begin, end;
+				ge::gl::glGetQueryObjectui64v(f.queries[z.begin], GL_QUERY_RESULT, &begin);
+				ge::gl::glGetQueryObjectui64v(f.queries[z.end], GL_QUERY_RESULT, &end);
+
+				phase& p = phases[z.phase];
+				p.last = (end - begin) / 1000000.0f;
+				p.history[p.head] = p.last;
+				p.head = (p.head + 1) % GPU_TIMER_HISTORY;
+
+				Profiler::add(p.name, static_cast<uint64_t>(std::max(static_cast<int64_t>(begin) + offset, int64_t(0))), end - begin, PROFILER_GPU_THREAD, z.depth);
+			}
+		}
+	}
+
+	f.zones.clear();
+	f.used = 0;
+
+}
@@ -0,0 +1,116 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* GPUTimer.h
+*/
+
+#pragma once
+
+#include <geGL/geGL.h>
+#include <geGL/StaticCalls.h>
+
+#include <Profiler.h>
+
+#include <string>
+#include <vector>
+
+// Number of frames in flight - results of frame are read back this many frames later
+#define GPU_TIMER_LATENCY 3
+
+// Number of stored times of every phase
+#define GPU_TIMER_HISTORY 100
+
+/**
+* @brief Non-blocking GPU timing - ring of timestamp queries read back several frames later
+* @note Zones can be nested, phases are identified by names (string literals), resolved zones are passed to Profiler
+*/
+class GPUTimer {
+
+public:
+
+	/**
+	* @brief Structure of measured phase (history is ring buffer, head is index of the oldest time)
+	*/
+	typedef struct {
+		const char* name;
+		std::vector<float> history;
+		unsigned head;
+		float last;
+	} phase;
+
+	/**
+	* @brief Constructor
+	* @param latency Number of frames in flight
+	*/
+	GPUTimer(unsigned latency = GPU_TIMER_LATENCY);
+
+	/**
+	* @brief Destructor (deletes queries)
+	*/
+	~GPUTimer();
+
+	/**
+	* @brief Starts zone of phase (timestamp is recorded into command stream)
+	* @param name Name of phase (string literal)
+	*/
+	void begin(const char* name);
+
+	/**
+	* @brief Ends the innermost started zone
+	*/
+	void end();
+
+	/**
+	* @brief Moves to next frame, reads results of the oldest frame if they are available
+	* @note Results which are not available are dropped (the CPU never waits for the GPU)
+	*/
+	void nextFrame();
+
+	/**
+	* @brief Getter for measured phases
+	* @return Vector of phases in order of first measurement
+	*/
+	const std::vector<phase>& getPhases();
+
+private:
+
+	/**
+	* @brief Structure of zone (queries of begin and end)
+	*/
+	typedef struct {
+		unsigned phase;
+		unsigned begin, end;
+		unsigned depth;
+	} zone;
+
+	/**
+	* @brief Structure of frame in flight (queries are reused by later frames)
+	*/
+	typedef struct {
+		std::vector<GLuint> queries;
+		std::vector<zone> zones;
+		unsigned used;
+	} frame;
+
+	/**
+	* @brief Records timestamp into next query of current frame
+	* @return Index of query in frame
+	*/
+	unsigned timestamp();
+
+	/**
+	* @brief Reads results of frame into phases
+	* @param f Frame
+	*/
+	void resolve(frame& f);
+
+	std::vector<frame> frames;
+	std::vector<phase> phases;
+	std::vector<unsigned> open;
+	unsigned current = 0;
+
+};
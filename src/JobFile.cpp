@@ -0,0 +1,117 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* JobFile.cpp
+*/
+
+#include <JobFile.h>
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+bool JobFile::load(std::string file, std::vector<job>& jobs){
+
+	std::ifstream input(file);
+
+	if (!input.is_open()) {
+		std::cout << "Job file " << file << " not found" << std::endl;
+		return false;
+	}
+
+	// Default settings of the first job
+	job current;
+	current.bvhType = BVH_TYPE_SAH;
+	current.width = 1200;
+	current.height = 800;
+	current.shadowSamples = 1;
+	current.indirectSamples = 0;
+	current.aoSamples = 0;
+	current.view = { glm::vec3(0.0f, 1.0f, 0.5f), 0.0f, 0.0f, 45.0f, glm::vec3(4.0f, 7.0f, 1.0f) };
+	current.frames = 1;
+	current.output = "frame.png";
+
+	bool started = false;
+	std::string line;
+
+	for (unsigned number = 1; std::getline(input, line); number++) {
+
+		std::istringstream values(line);
+		std::string key;
+
+		// Empty lines and comments
+		if (!(values >> key) || key[0] == '#')
+			continue;
+
+		if (key == "job") {
+			if (started)
+				jobs.push_back(current);
+			started = true;
+		}
+
+		else if (key == "scene")
+			values >> current.scene;
+
+		else if (key == "bvh")
+			values >> current.bvhType;
+
+		else if (key == "resolution")
+			values >> current.width >> current.height;
+
+		else if (key == "samples")
+			values >> current.shadowSamples >> current.indirectSamples >> current.aoSamples;
+
+		else if (key == "camera")
+			values >> current.view.position.x >> current.view.position.y >> current.view.position.z >> current.view.yaw >> current.view.pitch;
+
+		else if (key == "light")
+			values >> current.view.light.x >> current.view.light.y >> current.view.light.z;
+
+		else if (key == "frames")
+			values >> current.frames;
+
+		else if (key == "path")
+			values >> current.path;
+
+		else if (key == "output")
+			values >> current.output;
+
+		else {
+			std::cout << "Job file " << file << ":" << number << " unknown key " << key << std::endl;
+			return false;
+		}
+
+		if (values.fail()) {
+			std::cout << "Job file " << file << ":" << number << " invalid value of " << key << std::endl;
+			return false;
+		}
+	}
+
+	if (started)
+		jobs.push_back(current);
+
+	return !jobs.empty();
+}
+
+std::string JobFile::framePath(const job & j, unsigned frame){
+
+	if (j.frames <= 1)
+		return j.output;
+
+	std::ostringstream number;
+	number << "_" << std::setw(4) << std::setfill('0') << frame;
+
+	// Number goes before extension
+	size_t dot = j.output.find_last_of('.');
+	size_t slash = j.output.find_last_of("/\\");
+
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return j.output + number.str();
+
+	return j.output.substr(0, dot) + number.str() + j.output.substr(dot);
+}
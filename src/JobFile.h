@@ -0,0 +1,68 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* JobFile.h
+*/
+
+#pragma once
+
+#include <Renderer.h>
+
+#include <string>
+#include <vector>
+
+/**
+* @brief Parser of job files for batch rendering
+*
+* Job file is a list of "key values" lines, every "job" line starts new job with settings of previous job:
+*	job
+*	scene ../scenes/sponza.obj		(or generated:<uniform|spheres|stadium|thin|grid>:<triangles>)
+*	bvh 0						(BVH_TYPE_*, 0 - CPU SAH, 1 - GPU, 2 - CPU PLOC)
+*	resolution 1920 1080
+*	samples 1 0 0				(shadow, indirect and ambient occlusion samples)
+*	camera 0 1 0.5 0 0			(position, yaw, pitch)
+*	light 4 7 1
+*	frames 10
+*	path flythrough.path		(recorded camera path replaces camera, light and frames)
+*	output sponza.png			(frame number is appended for more frames)
+* Lines starting with # are comments.
+*/
+class JobFile {
+
+public:
+
+	/**
+	* @brief Structure of one rendering job
+	*/
+	typedef struct {
+		std::string scene;
+		int bvhType;
+		int width, height;
+		int shadowSamples, indirectSamples, aoSamples;
+		Renderer::viewState view;
+		unsigned frames;
+		std::string path;
+		std::string output;
+	} job;
+
+	/**
+	* @brief Loads jobs from file
+	* @param file Path to job file
+	* @param jobs Output jobs in order of file
+	* @return true if file was parsed without error
+	*/
+	static bool load(std::string file, std::vector<job>& jobs);
+
+	/**
+	* @brief Path of output image of frame
+	* @param j Job
+	* @param frame Index of frame
+	* @return Output path, frame number is inserted before extension if job has more frames
+	*/
+	static std::string framePath(const job& j, unsigned frame);
+
+};
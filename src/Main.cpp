@@ -11,6 +11,7 @@
 #pragma once
 
 #include <iostream>
+#include <string>
 
 #include <App.h>
 #include <RayTracing.h>
@@ -18,9 +19,29 @@
 #define APP_SUCCESS 0
 #define APP_FAIL 1
 
-int main(int, char**) {
+int main(int argc, char** argv) {
+
+	std::string jobFile, reportFile = "batch_report.csv";
+	bool validateSort = false;
+
+	// Batch rendering - RayTracing --batch jobs.txt [--report report.csv] [--validate-sort]
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if (arg == "--batch" && i + 1 < argc)
+			jobFile = argv[++i];
+		else if (arg == "--report" && i + 1 < argc)
+			reportFile = argv[++i];
+		else if (arg == "--validate-sort")
+			validateSort = true;
+	}
 
 	try{
+		if (!jobFile.empty()) {
+			App<RayTracing> a(1200, 800, "RayTracing", true);
+			return a.runBatch(jobFile, reportFile, validateSort) ? APP_SUCCESS : APP_FAIL;
+		}
+
 		App<RayTracing> a(1200, 800, "RayTracing");
 		a.run();
 	}
@@ -0,0 +1,247 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* Profiler.cpp
+*/
+
+#include <Profiler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+std::atomic<bool> Profiler::enabled{ true };
+std::atomic<uint64_t> Profiler::frameBegin{ 0 };
+std::atomic<uint64_t> Profiler::frameEnd{ 0 };
+std::mutex Profiler::registryLock;
+std::vector<std::unique_ptr<Profiler::threadBuffer>> Profiler::buffers;
+
+namespace {
+
+	// Start of time of profiler
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	// Start of current frame
+	uint64_t currentFrame = 0;
+
+}
+
+Profiler::scope::scope(const char * name, bool condition) : name(name), start(0), active(condition && Profiler::isEnabled()){
+
+	if (!active)
+		return;
+
+	local().depth++;
+	start = Profiler::now();
+
+}
+
+Profiler::scope::~scope(){
+
+	if (!active)
+		return;
+
+	uint64_t end = Profiler::now();
+	threadBuffer& buffer = local();
+
+	buffer.depth--;
+	store(buffer, { name, start, end - start, buffer.id, buffer.depth });
+
+}
+
+void Profiler::setEnabled(bool enable){
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool Profiler::isEnabled(){
+	return enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t Profiler::now(){
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Profiler::setThreadName(std::string name){
+
+	threadBuffer& buffer = local();
+	std::lock_guard<std::mutex> guard(buffer.lock);
+	buffer.name = name;
+
+}
+
+void Profiler::add(const char * name, uint64_t start, uint64_t duration, unsigned thread, unsigned depth){
+
+	if (!isEnabled())
+		return;
+
+	store(local(), { name, start, duration, thread, depth });
+
+}
+
+void Profiler::nextFrame(){
+
+	uint64_t t = now();
+
+	if (currentFrame != 0) {
+		frameBegin.store(currentFrame, std::memory_order_relaxed);
+		frameEnd.store(t, std::memory_order_relaxed);
+	}
+
+	currentFrame = t;
+
+}
+
+void Profiler::collect(std::vector<zone>& zones, uint64_t begin, uint64_t end){
+
+	zones.clear();
+
+	std::lock_guard<std::mutex> registry(registryLock);
+
+	for (auto& b : buffers) {
+
+		threadBuffer& buffer = *b;
+		std::lock_guard<std::mutex> guard(buffer.lock);
+
+		size_t first = (buffer.head + buffer.zones.size() - buffer.count) % std::max(buffer.zones.size(), static_cast<size_t>(1));
+
+		for (size_t i = 0; i < buffer.count; i++) {
+			const zone& z = buffer.zones[(first + i) % buffer.zones.size()];
+
+			if (z.start <= end && z.start + z.duration >= begin)
+				zones.push_back(z);
+		}
+	}
+
+}
+
+void Profiler::getLastFrame(uint64_t & begin, uint64_t & end){
+	begin = frameBegin.load(std::memory_order_relaxed);
+	end = frameEnd.load(std::memory_order_relaxed);
+}
+
+std::vector<Profiler::thread> Profiler::getThreads(){
+
+	std::vector<thread> threads = { { PROFILER_GPU_THREAD, "GPU" } };
+	std::lock_guard<std::mutex> registry(registryLock);
+
+	for (auto& b : buffers) {
+		threadBuffer& buffer = *b;
+		std::lock_guard<std::mutex> guard(buffer.lock);
+		threads.push_back({ buffer.id, buffer.name });
+	}
+
+	return threads;
+}
+
+bool Profiler::writeTrace(std::string file){
+
+	std::ofstream out(file);
+
+	if (!out.is_open()) {
+		std::cout << "Trace file " << file << " could not be created" << std::endl;
+		return false;
+	}
+
+	std::vector<zone> zones;
+	collect(zones);
+
+	std::sort(zones.begin(), zones.end(), [](const zone& a, const zone& b) { return a.start < b.start; });
+
+	out << "[" << std::endl;
+
+	// Names of threads (metadata events), GPU zones are on own thread of trace
+	bool first = true;
+
+	for (auto& t : getThreads()) {
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t.id << ",\"args\":{\"name\":\"" << t.name << "\"}}";
+		first = false;
+	}
+
+	// Complete events with times in us (fixed notation keeps ns precision of long traces)
+	out << std::fixed << std::setprecision(3);
+
+	for (auto& z : zones)
+		out << ",\n{\"name\":\"" << z.name << "\",\"cat\":\"" << (z.thread == PROFILER_GPU_THREAD ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << z.thread
+			<< ",\"ts\":" << z.start / 1000.0 << ",\"dur\":" << z.duration / 1000.0 << "}";
+
+	out << std::endl << "]" << std::endl;
+
+	return out.good();
+}
+
+void Profiler::clear(){
+
+	std::lock_guard<std::mutex> registry(registryLock);
+
+	for (auto& b : buffers) {
+		threadBuffer& buffer = *b;
+		std::lock_guard<std::mutex> guard(buffer.lock);
+		buffer.head = 0;
+		buffer.count = 0;
+	}
+
+}
+
+Profiler::threadBuffer & Profiler::local(){
+
+	// Buffer of thread is returned to registry, when thread exits
+	struct handle {
+		threadBuffer* buffer = nullptr;
+		~handle() {
+			if (buffer != nullptr) {
+				std::lock_guard<std::mutex> registry(registryLock);
+				buffer->retired = true;
+			}
+		}
+	};
+
+	thread_local handle h;
+
+	if (h.buffer != nullptr)
+		return *h.buffer;
+
+	std::lock_guard<std::mutex> registry(registryLock);
+
+	// Buffer of finished thread is reused (loading threads are short-lived)
+	for (auto& b : buffers) {
+		threadBuffer* buffer = b.get();
+
+		if (buffer->retired) {
+			std::lock_guard<std::mutex> guard(buffer->lock);
+			buffer->retired = false;
+			buffer->depth = 0;
+			h.buffer = buffer;
+			return *buffer;
+		}
+	}
+
+	buffers.emplace_back(new threadBuffer);
+	threadBuffer* buffer = buffers.back().get();
+	buffer->zones.resize(PROFILER_CAPACITY);
+	buffer->head = 0;
+	buffer->count = 0;
+	buffer->id = static_cast<unsigned>(buffers.size());
+	buffer->depth = 0;
+	buffer->name = "Thread " + std::to_string(buffer->id);
+	buffer->retired = false;
+
+	h.buffer = buffer;
+
+	return *buffer;
+}
+
+void Profiler::store(threadBuffer & buffer, const zone & z){
+
+	std::lock_guard<std::mutex> guard(buffer.lock);
+
+	buffer.zones[buffer.head] = z;
+	buffer.head = (buffer.head + 1) % buffer.zones.size();
+	buffer.count = std::min(buffer.count + 1, buffer.zones.size());
+
+}
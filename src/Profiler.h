@@ -0,0 +1,200 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* Profiler.h
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Profiling zones, without RT_PROFILE zone macros are empty (set by CMake option RT_PROFILE)
+//#define RT_PROFILE
+
+// Number of stored zones of every thread (ring buffer, the oldest zones are overwritten)
+#define PROFILER_CAPACITY 16384
+
+// Thread identifier of GPU zones
+#define PROFILER_GPU_THREAD 0
+
+// Output file of Chrome trace (chrome://tracing, Perfetto)
+#define PROFILER_TRACE_FILE "profile_trace.json"
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+#ifdef RT_PROFILE
+#define PROFILE_ZONE(name) Profiler::scope PROFILER_CONCAT(profilerZone, __LINE__)(name)
+#define PROFILE_ZONE_IF(condition, name) Profiler::scope PROFILER_CONCAT(profilerZone, __LINE__)(name, condition)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_ZONE_IF(condition, name)
+#endif // RT_PROFILE
+
+/**
+* @brief Hierarchical profiler of CPU and GPU zones (zones of every thread are stored into own ring buffer)
+* @note Zone names are string literals, stored zones are never allocated (steady state frames stay allocation free)
+*/
+class Profiler {
+
+public:
+
+	/**
+	* @brief Structure of measured zone (times in ns from start of application)
+	*/
+	typedef struct {
+		const char* name;
+		uint64_t start;
+		uint64_t duration;
+		unsigned thread;
+		unsigned depth;
+	} zone;
+
+	/**
+	* @brief Structure of profiled thread
+	*/
+	typedef struct {
+		unsigned id;
+		std::string name;
+	} thread;
+
+	/**
+	* @brief Scoped CPU zone - measures time from construction to destruction
+	*/
+	class scope {
+
+	public:
+
+		/**
+		* @brief Starts zone
+		* @param name Name of zone (string literal)
+		* @param condition false - zone is not measured
+		*/
+		scope(const char* name, bool condition = true);
+
+		/**
+		* @brief Ends zone
+		*/
+		~scope();
+
+	private:
+
+		const char* name;
+		uint64_t start;
+		bool active;
+
+	};
+
+	/**
+	* @brief Enables and disables profiling (disabled zones cost one atomic load)
+	* @param enable true - zones are measured
+	*/
+	static void setEnabled(bool enable);
+
+	/**
+	* @brief Getter for state of profiling
+	* @return true if zones are measured
+	*/
+	static bool isEnabled();
+
+	/**
+	* @brief Getter for current time of profiler
+	* @return Time in ns from start of application
+	*/
+	static uint64_t now();
+
+	/**
+	* @brief Sets name of calling thread in traces
+	* @param name Name of thread
+	*/
+	static void setThreadName(std::string name);
+
+	/**
+	* @brief Stores zone measured outside of scope (GPU zones)
+	* @param name Name of zone (string literal)
+	* @param start Start of zone in ns (time of profiler)
+	* @param duration Duration of zone in ns
+	* @param thread Thread of zone (PROFILER_GPU_THREAD for GPU)
+	* @param depth Nesting depth of zone
+	*/
+	static void add(const char* name, uint64_t start, uint64_t duration, unsigned thread, unsigned depth);
+
+	/**
+	* @brief Marks start of next frame (called by main thread)
+	*/
+	static void nextFrame();
+
+	/**
+	* @brief Collects stored zones
+	* @param zones Output zones (cleared at first)
+	* @param begin, end Only zones overlapping this interval are collected
+	*/
+	static void collect(std::vector<zone>& zones, uint64_t begin = 0, uint64_t end = UINT64_MAX);
+
+	/**
+	* @brief Getter for interval of the last finished frame
+	* @param begin, end Output interval (equal if no frame was finished)
+	*/
+	static void getLastFrame(uint64_t& begin, uint64_t& end);
+
+	/**
+	* @brief Getter for profiled threads (GPU has identifier PROFILER_GPU_THREAD)
+	* @return Threads in order of registration
+	*/
+	static std::vector<thread> getThreads();
+
+	/**
+	* @brief Writes all stored zones as Chrome trace (JSON array of complete events)
+	* @param file Path to output file
+	* @return true if success
+	*/
+	static bool writeTrace(std::string file);
+
+	/**
+	* @brief Removes all stored zones
+	*/
+	static void clear();
+
+private:
+
+	/**
+	* @brief Structure of zones of one thread (buffer is reused after exit of thread)
+	*/
+	typedef struct {
+		std::mutex lock;
+		std::vector<zone> zones;
+		size_t head;
+		size_t count;
+		unsigned id;
+		unsigned depth;
+		std::string name;
+		bool retired;
+	} threadBuffer;
+
+	/**
+	* @brief Getter for buffer of calling thread (registered on the first call)
+	*/
+	static threadBuffer& local();
+
+	/**
+	* @brief Stores zone into buffer
+	*/
+	static void store(threadBuffer& buffer, const zone& z);
+
+	static std::atomic<bool> enabled;
+	static std::atomic<uint64_t> frameBegin, frameEnd;
+
+	// Registered buffers (buffers live until end of application)
+	static std::mutex registryLock;
+	static std::vector<std::unique_ptr<threadBuffer>> buffers;
+
+};
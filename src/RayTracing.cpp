@@ -17,6 +17,20 @@ void RayTracing::init(){
 	// Compute shader - Ray Tracing
 	auto cs = std::make_shared<ge::gl::Shader>(GL_COMPUTE_SHADER, ge::core::loadTextFile(COMPUTE_SHADER_PATH));
 	tracer = std::make_shared<ge::gl::Program>(cs);
+
+	GLuint id = tracer->getId();
+	uniforms.screenPlane[0] = ge::gl::glGetUniformLocation(id, "screen_plane[0]");
+	uniforms.screenPlane[1] = ge::gl::glGetUniformLocation(id, "screen_plane[1]");
+	uniforms.screenPlane[2] = ge::gl::glGetUniformLocation(id, "screen_plane[2]");
+	uniforms.viewPos = ge::gl::glGetUniformLocation(id, "view_pos");
+	uniforms.lightPos = ge::gl::glGetUniformLocation(id, "light_pos");
+	uniforms.width = ge::gl::glGetUniformLocation(id, "width");
+	uniforms.height = ge::gl::glGetUniformLocation(id, "height");
+	uniforms.renderMode = ge::gl::glGetUniformLocation(id, "renderMode");
+	uniforms.nodeFormat = ge::gl::glGetUniformLocation(id, "nodeFormat");
+	uniforms.shadowSamples = ge::gl::glGetUniformLocation(id, "shadowSamples");
+	uniforms.indirectSamples = ge::gl::glGetUniformLocation(id, "indirectSamples");
+	uniforms.aoSamples = ge::gl::glGetUniformLocation(id, "aoSamples");
 	// Compute shader - Ray Tracing
 
 
@@ -32,12 +46,17 @@ void RayTracing::init(){
 
 
 	// SSBOs
-	geomBuff = std::make_shared<ge::gl::Buffer>(sizeof(Scene::gpu_triangle));
-	matBuff = std::make_shared<ge::gl::Buffer>(sizeof(Scene::gpu_material));
-	nodeBuff = std::make_shared<ge::gl::Buffer>(2 * sizeof(bvhPreprocessor::gpuNode));
-	indBuff = std::make_shared<ge::gl::Buffer>(sizeof(unsigned));
+	geomBuff = GPUMemory::createBuffer(AllocationCounter::RENDERER, sizeof(Scene::gpu_triangle));
+	matBuff = GPUMemory::createBuffer(AllocationCounter::RENDERER, sizeof(Scene::gpu_material));
+	nodeBuff = GPUMemory::createBuffer(AllocationCounter::RENDERER, 2 * sizeof(bvhPreprocessor::gpuNode));
+	indBuff = GPUMemory::createBuffer(AllocationCounter::RENDERER, sizeof(unsigned));
 	// SSBOs
 
+#ifdef RT_DEBUG_BUFFER
+	dbg = std::make_shared<ge::gl::Buffer>(sizeof(float) * RT_DEBUG_SIZE);
+	dbgData.resize(RT_DEBUG_SIZE);
+#endif // RT_DEBUG_BUFFER
+
 	// Rendering texture
 	ge::gl::glGenTextures(1, &renderTexture);
 	ge::gl::glActiveTexture(GL_TEXTURE0);
@@ -50,8 +69,6 @@ void RayTracing::init(){
 	ge::gl::glBindImageTexture(0, renderTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 	// Rendering texture
 
-	ge::gl::glGenQueries(1, &query);
-
 }
 
 void RayTracing::setWindowObject(std::shared_ptr<Window> w){
@@ -59,97 +76,94 @@ void RayTracing::setWindowObject(std::shared_ptr<Window> w){
 }
 
 void RayTracing::render(){
-#define DT_DGB float
-	std::vector<DT_DGB> dbg_data(400);
-	std::shared_ptr<ge::gl::Buffer> dbg = std::make_shared<ge::gl::Buffer>(sizeof(DT_DGB) * 400);
 
-	if (drawFrame) {
+	PROFILE_ZONE("Render");
 
-		// Move of camera (recompute vectors values)
+	// Move of camera (recompute vectors values)
+	if (inputControl) {
 		camera->camera_move(win->getWindow(), static_cast<float>(glfwGetTime()));
-
 		lightPosEvent();
+	}
 
-		// Window resize
-		if (win->isResized()) {
-			ge::gl::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, win->getWidth(), win->getHeight(), 0, GL_RGBA, GL_FLOAT, NULL);
-			printf("resize window to %d %d\n", win->getWidth(), win->getHeight());
-		}
-		
-		ge::gl::glClearColor(0.1f, 0.9f, 0.4f, 1.0f);
-		ge::gl::glClear(GL_COLOR_BUFFER_BIT);
-
-		// ----- Ray trace -----
-		tracer->use();
-
-		// Compute screen plane vectors
-		std::vector<glm::vec3> sp = camera->c.getScreenCoords();
-		glm::vec3 spx = sp[2] - sp[0];
-		glm::vec3 spy = sp[1] - sp[0];
-		
-		tracer->set3f("screen_plane[0]", spx.x, spx.y, spx.z);
-		tracer->set3f("screen_plane[1]", spy.x, spy.y, spy.z);
-		tracer->set3f("screen_plane[2]", sp[0].x, sp[0].y, sp[0].z);
-		
-		tracer->set3f("view_pos", camera->c.getPosition().x, camera->c.getPosition().y, camera->c.getPosition().z);
-		tracer->set1i("width", win->getWidth());
-		tracer->set1i("height", win->getHeight());
-		tracer->set1i("renderMode", !guiData->renderMode);
-		tracer->set1i("bvhType", guiData->bvhType);
-		tracer->set3f("light_pos", lightPos.x, lightPos.y, lightPos.z);
+	// Window resize
+	if (win->isResized()) {
+		ge::gl::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, win->getWidth(), win->getHeight(), 0, GL_RGBA, GL_FLOAT, NULL);
+		printf("resize window to %d %d\n", win->getWidth(), win->getHeight());
+	}
 	
-		tracer->set1i("shadowSamples", guiData->shadowSamples);
-		tracer->set1i("indirectSamples", guiData->indirectSamples);
-		tracer->set1i("aoSamples", guiData->aoSamples);
-
-		// Bind all buffers
-		geomBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 1);
-		matBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 2);
-		nodeBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 3);
-		indBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 4);
-
-		dbg->bindBase(GL_SHADER_STORAGE_BUFFER, 7);
-
-		GLint wgs[3];
-		tracer->getComputeWorkGroupSize(wgs);
-		
-		// Computation of Ray Tracing in Compute shaders
-		ge::gl::glBeginQuery(GL_TIME_ELAPSED, query);
-		
-		ge::gl::glDispatchCompute(ceil(win->getWidth() / static_cast<float>(wgs[0])), ceil(win->getHeight() / static_cast<float>(wgs[1])), 1);
-		ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-		
-		ge::gl::glEndQuery(GL_TIME_ELAPSED);
-		// Computation of Ray Tracing in Compute shaders
-
-		while (!done)
-			ge::gl::glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &done);
-
-		// Get rendering time
-		done = 0;
-		ge::gl::glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
-		guiData->renderTimes.push_back(elapsed_time / 1000000.0);
-		guiData->renderTimes.erase(guiData->renderTimes.begin());
-		
-		dbg->getData(dbg_data);
-		//for (int i = 0; i < dbg_data.size(); i++)
-		//	printf("node %f\n", dbg_data[i]);
-
-		//system("pause");
-		
-		geomBuff->unbindBase(GL_SHADER_STORAGE_BUFFER, 0);
-		matBuff->unbindBase(GL_SHADER_STORAGE_BUFFER, 0);
-		// ----- Ray trace -----
-
-		// Draw frame
-		display->use();
-		
-		ge::gl::glActiveTexture(GL_TEXTURE0);
-		ge::gl::glBindTexture(GL_TEXTURE_2D, renderTexture);
-		ge::gl::glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-		// Draw frame
+	ge::gl::glClearColor(0.1f, 0.9f, 0.4f, 1.0f);
+	ge::gl::glClear(GL_COLOR_BUFFER_BIT);
 
-	}
+	// Out-of-core scene
+	if (clusters != nullptr)
+		streamClusters();
+
+	// ----- Ray trace -----
+	PROFILE_ZONE("Trace dispatch");
+
+	tracer->use();
+
+	// Compute screen plane vectors
+	std::array<glm::vec3, 4> sp = camera->c.getScreenCoords();
+	glm::vec3 spx = sp[2] - sp[0];
+	glm::vec3 spy = sp[1] - sp[0];
+	
+	// Locations are cached, uniforms are set without lookup by name (frame does not allocate)
+	ge::gl::glUniform3f(uniforms.screenPlane[0], spx.x, spx.y, spx.z);
+	ge::gl::glUniform3f(uniforms.screenPlane[1], spy.x, spy.y, spy.z);
+	ge::gl::glUniform3f(uniforms.screenPlane[2], sp[0].x, sp[0].y, sp[0].z);
+	
+	ge::gl::glUniform3f(uniforms.viewPos, camera->c.getPosition().x, camera->c.getPosition().y, camera->c.getPosition().z);
+	ge::gl::glUniform1i(uniforms.width, win->getWidth());
+	ge::gl::glUniform1i(uniforms.height, win->getHeight());
+	ge::gl::glUniform1i(uniforms.renderMode, !guiData->renderMode);
+	ge::gl::glUniform1i(uniforms.nodeFormat, nodeFormat);
+	ge::gl::glUniform3f(uniforms.lightPos, lightPos.x, lightPos.y, lightPos.z);
+	
+	ge::gl::glUniform1i(uniforms.shadowSamples, guiData->shadowSamples);
+	ge::gl::glUniform1i(uniforms.indirectSamples, guiData->indirectSamples);
+	ge::gl::glUniform1i(uniforms.aoSamples, guiData->aoSamples);
+
+	// Bind all buffers
+	geomBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 1);
+	matBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 2);
+	nodeBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 3);
+	indBuff->bindBase(GL_SHADER_STORAGE_BUFFER, 4);
+
+#ifdef RT_DEBUG_BUFFER
+	dbg->bindBase(GL_SHADER_STORAGE_BUFFER, 7);
+#endif // RT_DEBUG_BUFFER
+
+	GLint wgs[3];
+	tracer->getComputeWorkGroupSize(wgs);
+	
+	// Computation of Ray Tracing in Compute shaders (time is read back by timer frames later)
+	guiData->gpuTimer->begin("Ray tracing");
+	
+	ge::gl::glDispatchCompute(ceil(win->getWidth() / static_cast<float>(wgs[0])), ceil(win->getHeight() / static_cast<float>(wgs[1])), 1);
+	ge::gl::glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	
+	guiData->gpuTimer->end();
+	// Computation of Ray Tracing in Compute shaders
+
+#ifdef RT_DEBUG_BUFFER
+	// Synchronous readback (stalls pipeline)
+	dbg->getData(dbgData.data(), dbgData.size() * sizeof(float));
+	//for (int i = 0; i < dbgData.size(); i++)
+	//	printf("node %f\n", dbgData[i]);
+#endif // RT_DEBUG_BUFFER
+	
+	geomBuff->unbindBase(GL_SHADER_STORAGE_BUFFER, 0);
+	matBuff->unbindBase(GL_SHADER_STORAGE_BUFFER, 0);
+	// ----- Ray trace -----
+
+	// Draw frame
+	display->use();
+	
+	ge::gl::glActiveTexture(GL_TEXTURE0);
+	ge::gl::glBindTexture(GL_TEXTURE_2D, renderTexture);
+	ge::gl::glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	// Draw frame
 
 }
 
@@ -159,40 +173,210 @@ void RayTracing::setupUIData(std::shared_ptr<UserInterface::uiData> data){
 
 void RayTracing::updateScene(Scene & s){
 
-	drawFrame = false;
+	AllocationCounter::tag memoryTag(AllocationCounter::RENDERER);
 
-	// Reload scene
+	// New scene is uploaded into back buffers, current buffers are still used for rendering
+	uploadScene = &s;
+	uploadOffset = 0;
 
-	// Geometry
-	//printf("geo %d\n", s.getGeometry().size());
-	geomBuff->realloc(sizeof(Scene::gpu_triangle) * s.getGeometry().size());
-	geomBuff->setData(s.getGeometry());
-	
-	// Materials
-	matBuff->realloc(sizeof(Scene::gpu_material) * s.getMaterials().size());
-	matBuff->setData(s.getMaterials());
+	size_t geometrySize = sizeof(Scene::gpu_triangle) * s.getGeometry().size();
+	size_t nodesSize = sizeof(bvhPreprocessor::gpuNode) * uploadNodes.size();
+
+	// Out-of-core scene - geometry buffer holds GPU slots of clusters, top of BVH is uploaded at first
+	size_t slotsSize = 0;
+
+	if (nextClusters != nullptr) {
+		uploadNodes = nextClusters->getNodes();
+		nodesSize = sizeof(bvhPreprocessor::gpuNode) * uploadNodes.size();
+		slotsSize = nextClusters->getSlotCount() * nextClusters->getSlotSize();
+	}
+
+	nextGeomBuff = GPUMemory::createBuffer(AllocationCounter::RENDERER, std::max(std::max(geometrySize, slotsSize), sizeof(Scene::gpu_triangle)));
+	nextMatBuff = GPUMemory::createBuffer(AllocationCounter::RENDERER, std::max(sizeof(Scene::gpu_material) * s.getMaterials().size(), sizeof(Scene::gpu_material)));
+
+	// Flattened CPU BVH or top of clusters BVH (GPU BVH is already in buffers from setupGPUBVH)
+	if (!uploadNodes.empty())
+		nextNodeBuff = GPUMemory::createBuffer(AllocationCounter::RENDERER, nodesSize);
+
+	uploadSize = geometrySize + nodesSize;
+
+}
+
+bool RayTracing::uploadStep(){
+
+	if (uploadScene == nullptr)
+		return true;
+
+	PROFILE_ZONE("Upload step");
+	AllocationCounter::tag memoryTag(AllocationCounter::RENDERER);
+
+	size_t budget = SCENE_UPLOAD_CHUNK;
+	size_t geometrySize = sizeof(Scene::gpu_triangle) * uploadScene->getGeometry().size();
+
+	// Geometry, then nodes of CPU BVH
+	uploadChunk(nextGeomBuff, uploadScene->getGeometry().data(), geometrySize, 0, budget);
+	uploadChunk(nextNodeBuff, uploadNodes.data(), sizeof(bvhPreprocessor::gpuNode) * uploadNodes.size(), geometrySize, budget);
+
+	if (uploadOffset < uploadSize)
+		return false;
+
+	// Materials are small, they are uploaded at once (with the latest texture handles)
+	nextMatBuff->setData(uploadScene->getMaterials());
+
+	// Swap scenes
+	geomBuff = nextGeomBuff;
+	matBuff = nextMatBuff;
+
+	if (nextNodeBuff != nullptr)
+		nodeBuff = nextNodeBuff;
+
+	if (nextIndBuff != nullptr)
+		indBuff = nextIndBuff;
+
+	nodeFormat = uploadNodeFormat;
+	clusters = nextClusters;
+
+	nextGeomBuff.reset();
+	nextMatBuff.reset();
+	nextNodeBuff.reset();
+	nextIndBuff.reset();
+	nextClusters.reset();
+
+	uploadNodes.clear();
+	uploadNodes.shrink_to_fit();
+	uploadScene = nullptr;
+
+	return true;
+}
+
+float RayTracing::getUploadProgress(){
 
-	drawFrame = true;
+	if (uploadScene == nullptr || uploadSize == 0)
+		return 1.0f;
+
+	return uploadOffset / static_cast<float>(uploadSize);
+}
+
+void RayTracing::uploadChunk(std::shared_ptr<ge::gl::Buffer> buffer, const void * data, size_t size, size_t start, size_t & budget){
+
+	// Part is already uploaded or there is no budget in this step
+	if (uploadOffset >= start + size || budget == 0)
+		return;
+
+	size_t offset = uploadOffset - start;
+	size_t chunk = std::min(budget, size - offset);
+
+	buffer->setData(static_cast<const char*>(data) + offset, chunk, offset);
+
+	uploadOffset += chunk;
+	budget -= chunk;
+
+}
+
+void RayTracing::updateMaterials(Scene & s){
+
+	// Only texture handles are changed, size of buffer stays the same
+	matBuff->setData(s.getMaterials());
 
 }
 
 void RayTracing::setupCPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::AABB_SAH_BVH>> rootNode){
+	setupCPUNodes(rootNode->getRoot().get());
+}
+
+void RayTracing::setupCPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::PLOC_BVH>> rootNode){
+	setupCPUNodes(rootNode->getRoot().get());
+}
+
+void RayTracing::setupCPUNodes(ge::sg::BVH_Node<ge::sg::AABB>* root){
+
+	PROFILE_ZONE("Flatten BVH");
+	AllocationCounter::tag memoryTag(AllocationCounter::PREPROCESSOR);
 
 	// Preprocess BVH into linear structure
 	bvhPreprocessor bp;
-	bp.transformBVH(rootNode->getRoot().get(), rootNode->getRoot()->first);
+	bp.setLayout(static_cast<bvhPreprocessor::layout>(guiData->nodeLayout));
+	bp.transformBVH(root, root->first);
 	
-	// Insert converted structure on the GPU
-	nodeBuff->realloc(bp.getTree()->size() * sizeof(bvhPreprocessor::gpuNode));
-	nodeBuff->setData(bp.getTree()->data());
+	// Converted structure is inserted on the GPU with the rest of the scene
+	uploadNodes.swap(*bp.getTree());
+	uploadNodeFormat = BVH_NODES_RANGES;
+	nextClusters.reset();
 
 }
 
 void RayTracing::setupGPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::RadixTree_BVH>> bvh){
 
-	// Setup nodes and indices buffers
-	nodeBuff = bvh->getNodes();
-	indBuff = bvh->getIndices();
+	// Setup nodes and indices buffers (used after upload of scene)
+	uploadNodes.clear();
+	nextNodeBuff = bvh->getNodes();
+	nextIndBuff = bvh->getIndices();
+	uploadNodeFormat = bvh->getNodeFormat();
+	nextClusters.reset();
+
+}
+
+void RayTracing::setupClusters(std::shared_ptr<ClusterCache> clusters){
+
+	// Leaves of cluster BVHs index triangles directly (as CPU BVH)
+	uploadNodes.clear();
+	uploadNodeFormat = BVH_NODES_RANGES;
+	nextClusters = clusters;
+
+}
+
+void RayTracing::streamClusters(){
+
+	PROFILE_ZONE("Stream clusters");
+
+	if (!clusters->update(camera->c.getPosition()))
+		return;
+
+	// New clusters into their GPU slots
+	for (auto& p : clusters->getPageIns())
+		geomBuff->setData(p.data->triangles.data(), p.data->triangles.size() * sizeof(Scene::gpu_triangle), p.slot * clusters->getSlotSize());
+
+	// Top of BVH with BVHs of resident clusters
+	auto& nodes = clusters->getNodes();
+	size_t size = nodes.size() * sizeof(bvhPreprocessor::gpuNode);
+
+	if (static_cast<size_t>(nodeBuff->getSize()) < size)
+		GPUMemory::resizeBuffer(AllocationCounter::RENDERER, nodeBuff, size);
+
+	nodeBuff->setData(nodes.data(), size);
+
+}
+
+RayTracing::viewState RayTracing::getView(){
+	return { camera->c.position, camera->c.yaw, camera->c.pitch, camera->c.zoom, lightPos };
+}
+
+void RayTracing::setView(const viewState & view){
+
+	camera->c.position = view.position;
+	camera->c.yaw = view.yaw;
+	camera->c.pitch = view.pitch;
+	camera->c.zoom = view.zoom;
+	camera->c.updateVectors();
+
+	lightPos = view.light;
+
+}
+
+void RayTracing::setInputControl(bool enable){
+	inputControl = enable;
+}
+
+void RayTracing::getImage(std::vector<unsigned char>& rgba){
+
+	rgba.resize(static_cast<size_t>(win->getWidth()) * win->getHeight() * 4);
+
+	// Image stores of tracer have to be finished
+	ge::gl::glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	ge::gl::glBindTexture(GL_TEXTURE_2D, renderTexture);
+	ge::gl::glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	ge::gl::glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
 
 }
 
@@ -15,10 +15,14 @@
 #include <Renderer.h>
 #include <FPScameraManager.h>
 #include <bvhPreprocessor.h>
+#include <Profiler.h>
+#include <GPUMemory.h>
 
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <algorithm>
+#include <array>
 
 #include <geGL/geGL.h>
 #include <geGL/StaticCalls.h>
@@ -33,6 +37,13 @@
 #define VERTEX_SHADER_PATH "../shaders/display.vs"
 #endif
 
+// Maximum number of bytes uploaded on GPU during one uploadStep call
+#define SCENE_UPLOAD_CHUNK (8 * 1024 * 1024)
+
+// Debug buffer of tracer (binding 7) - allocated and read back every frame only if enabled
+//#define RT_DEBUG_BUFFER
+#define RT_DEBUG_SIZE 400
+
 #ifndef FRAGMENT_SHADER_PATH
 #define FRAGMENT_SHADER_PATH "../shaders/display.fs"
 #endif
@@ -83,32 +94,119 @@ public:
 	* @param s Refernce to new (loaded) scene
 	*/
 	void updateScene(Scene& s) override;
+
+	/**
+	* @brief Uploads next part of new scene, swaps scenes after whole scene is uploaded
+	* @return true if there is nothing to upload (new scene is used for rendering)
+	*/
+	bool uploadStep() override;
+
+	/**
+	* @brief Getter for progress of scene upload
+	* @return Progress of upload in range 0 - 1
+	*/
+	float getUploadProgress() override;
+
+	/**
+	* @brief Update materials of current scene (e.g. after streamed texture became resident)
+	* @param s Refernce to current scene
+	*/
+	void updateMaterials(Scene& s) override;
 	
 	/**
 	* @brief Setup CPU BVH acceleration structure to renderer
 	* @param rootNode Pointer to root node of BVH
+	* @note can be called from loading thread (no GL calls)
 	*/
 	void setupCPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::AABB_SAH_BVH>> rootNode) override;
+
+	/**
+	* @brief Setup CPU BVH built by clustering to renderer
+	* @param rootNode Pointer to root node of BVH
+	* @note can be called from loading thread (no GL calls)
+	*/
+	void setupCPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::PLOC_BVH>> rootNode) override;
 	
 	/**
 	* @brief Setup GPU BVH acceleration structure to renderer
 	* @param bvh Pointer to GPU BVH structure
 	*/
 	void setupGPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::RadixTree_BVH>> bvh) override;
+
+	/**
+	* @brief Setup clusters of out-of-core scene to renderer (geometry and BVH are streamed during rendering)
+	* @param clusters Pointer to cluster cache of scene
+	*/
+	void setupClusters(std::shared_ptr<ClusterCache> clusters) override;
+
+	/**
+	* @brief Getter for current view
+	* @return Camera pose and light position
+	*/
+	viewState getView() override;
+
+	/**
+	* @brief Sets camera pose and light position
+	* @param view New view
+	*/
+	void setView(const viewState& view) override;
+
+	/**
+	* @brief Enables control of camera and light by keyboard and mouse
+	* @param enable false for batch rendering (view is set by setView only)
+	*/
+	void setInputControl(bool enable) override;
+
+	/**
+	* @brief Reads last rendered image from render texture
+	* @param rgba Output pixels (RGBA8, bottom row first)
+	*/
+	void getImage(std::vector<unsigned char>& rgba) override;
 	
 private:
 
+	/**
+	* @brief Locations of uniforms of tracer (looked up once after linking, render passes no names)
+	*/
+	typedef struct {
+		GLint screenPlane[3];
+		GLint viewPos, lightPos;
+		GLint width, height;
+		GLint renderMode, nodeFormat;
+		GLint shadowSamples, indirectSamples, aoSamples;
+	} tracerUniforms;
+
 	/**
 	* @brief Setup new position of light
 	*/
 	void lightPosEvent();
 
-	bool drawFrame = true;
+	/**
+	* @brief Pages in clusters needed by current camera position (out-of-core scene)
+	*/
+	void streamClusters();
+
+	/**
+	* @brief Flattens CPU BVH into nodes uploaded with scene
+	* @param root Root node of BVH
+	*/
+	void setupCPUNodes(ge::sg::BVH_Node<ge::sg::AABB>* root);
+
+	/**
+	* @brief Uploads next chunk of data into buffer
+	* @param buffer Destination buffer
+	* @param data Source data
+	* @param size Size of source data (in bytes)
+	* @param start Offset of source data in whole upload
+	* @param budget Remaining bytes of current upload step
+	*/
+	void uploadChunk(std::shared_ptr<ge::gl::Buffer> buffer, const void* data, size_t size, size_t start, size_t& budget);
 	
 	// Renderer's attributes (window, camera, ui, programs)
 	std::shared_ptr<Window> win;
 	std::shared_ptr<ge::gl::Program> display;
 	std::shared_ptr<ge::gl::Program> tracer;
+	tracerUniforms uniforms;
 	std::shared_ptr<FPSCameraManager> camera;
 	std::shared_ptr<UserInterface::uiData> guiData;
 
@@ -119,13 +217,37 @@ private:
 	std::shared_ptr<ge::gl::Buffer> nodeBuff;
 	std::shared_ptr<ge::gl::Buffer> indBuff;
 
+	// Buffers of new scene (swapped with buffers above after upload)
+	std::shared_ptr<ge::gl::Buffer> nextGeomBuff;
+	std::shared_ptr<ge::gl::Buffer> nextMatBuff;
+	std::shared_ptr<ge::gl::Buffer> nextNodeBuff;
+	std::shared_ptr<ge::gl::Buffer> nextIndBuff;
+
+	// Clusters of rendered and uploaded out-of-core scene
+	std::shared_ptr<ClusterCache> clusters;
+	std::shared_ptr<ClusterCache> nextClusters;
+
+	// State of scene upload
+	Scene* uploadScene = nullptr;
+	std::vector<bvhPreprocessor::gpuNode> uploadNodes;
+	size_t uploadOffset = 0;
+	size_t uploadSize = 0;
+
+	// Format of BVH nodes in rendered scene and in uploaded scene (BVH_NODES_*)
+	int nodeFormat = BVH_NODES_RANGES;
+	int uploadNodeFormat = BVH_NODES_RANGES;
+
+#ifdef RT_DEBUG_BUFFER
+	// Persistent debug buffer and its copy in main memory
+	std::shared_ptr<ge::gl::Buffer> dbg;
+	std::vector<float> dbgData;
+#endif // RT_DEBUG_BUFFER
+
 	// Image object for screen rendering
 	GLuint renderTexture;
 	
-	// GL query for render duration + helper variables
-	GLuint query;
-	GLuint64 elapsed_time;
-	int done = 0;
+	// Position of light
 	glm::vec3 lightPos = glm::vec3(4.0f, 7.0f, 1.0f);
+	bool inputControl = true;
 
 };
\ No newline at end of file
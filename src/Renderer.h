@@ -11,15 +11,18 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <Window.h>
 #include <Scene.h>
+#include <ClusterCache.h>
 #include <UserInterface.h>
 
 #include <geSG/AABB.h>
 #include <BVH.h>
 #include <AABB_SAH_BVH.h>
 #include <RadixTree_BVH.h>
+#include <PLOC_BVH.h>
 #include <BVH_Node.h>
 
 /**
@@ -29,6 +32,15 @@ class Renderer {
 
 public:
 
+	/**
+	* @brief Structure of view (camera pose and light position)
+	*/
+	typedef struct {
+		glm::vec3 position;
+		float yaw, pitch, zoom;
+		glm::vec3 light;
+	} viewState;
+
 	/**
 	* @brief Initialization of class attributes
 	*/
@@ -48,8 +60,27 @@ public:
 	/**
 	* @brief Update new scene into renderer
 	* @param s Refernce to new (loaded) scene
+	* @note Scene is uploaded by uploadStep() calls, previous scene is rendered until upload is finished
 	*/
 	virtual void updateScene(Scene& s){}
+
+	/**
+	* @brief Uploads next part of new scene, swaps scenes after whole scene is uploaded
+	* @return true if there is nothing to upload (new scene is used for rendering)
+	*/
+	virtual bool uploadStep(){ return true; }
+
+	/**
+	* @brief Getter for progress of scene upload
+	* @return Progress of upload in range 0 - 1
+	*/
+	virtual float getUploadProgress(){ return 1.0f; }
+
+	/**
+	* @brief Update materials of current scene (e.g. after streamed texture became resident)
+	* @param s Refernce to current scene
+	*/
+	virtual void updateMaterials(Scene& s){}
 	
 	/**
 	* @brief Set window object for renderer (window of current context)
@@ -60,8 +91,16 @@ public:
 	/**
 	* @brief Setup CPU BVH acceleration structure to renderer
 	* @param rootNode Pointer to root node of BVH
+	* @note can be called from loading thread (no GL calls)
 	*/
 	virtual void setupCPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::AABB_SAH_BVH>> rootNode){}
+
+	/**
+	* @brief Setup CPU BVH built by clustering to renderer
+	* @param rootNode Pointer to root node of BVH
+	* @note can be called from loading thread (no GL calls)
+	*/
+	virtual void setupCPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::PLOC_BVH>> rootNode){}
 	
 	/**
 	* @brief Setup GPU BVH acceleration structure to renderer
@@ -69,4 +108,34 @@ public:
 	*/
 	virtual void setupGPUBVH(std::shared_ptr<ge::sg::BVH<ge::sg::RadixTree_BVH>> bvh){}
 
+	/**
+	* @brief Setup clusters of out-of-core scene to renderer (geometry and BVH are streamed during rendering)
+	* @param clusters Pointer to cluster cache of scene
+	*/
+	virtual void setupClusters(std::shared_ptr<ClusterCache> clusters){}
+
+	/**
+	* @brief Getter for current view
+	* @return Camera pose and light position
+	*/
+	virtual viewState getView(){ return viewState(); }
+
+	/**
+	* @brief Sets camera pose and light position
+	* @param view New view
+	*/
+	virtual void setView(const viewState& view){}
+
+	/**
+	* @brief Enables control of camera and light by keyboard and mouse
+	* @param enable false for batch rendering (view is set by setView only)
+	*/
+	virtual void setInputControl(bool enable){}
+
+	/**
+	* @brief Reads last rendered image
+	* @param rgba Output pixels (RGBA8, bottom row first)
+	*/
+	virtual void getImage(std::vector<unsigned char>& rgba){}
+
 };
\ No newline at end of file
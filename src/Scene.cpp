@@ -10,30 +10,36 @@
 
 
 #include <Scene.h>
+#include <ClusterCache.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <3rd_party/image/stb_image.h>
+#include <limits>
 
 Scene::~Scene(){
 	triangles.shrink_to_fit();
 	materials.shrink_to_fit();
 }
 
-bool Scene::loadScene(std::string file, int mode) {
+bool Scene::loadScene(std::string file) {
 
 	triangles.shrink_to_fit();
 	materials.shrink_to_fit();
 
+	triangles.clear();
+	materials.clear();
+
+	textures.clear();
+	materialTextures.clear();
+	clusters.reset();
+
+	loadProgress = 0.0f;
+
 	std::string directory;
-	std::vector<float> tmp_pos, tmp_nor, tmp_uv;
-	std::vector<unsigned> tmp_mat, tmp_ind;
-	std::map<std::shared_ptr<ge::sg::Material>, int> asoc_mat;
-	float* tmp;
-	int mat_id = 0;
-	int ind_offset = 0;
 
 	std::replace(file.begin(), file.end(), '\\', '/');
 	std::cout << file << std::endl;
+
+	// Scene graph is accounted to loader, attributes copied from it to scene
+	AllocationCounter::tag memoryTag(AllocationCounter::LOADER);
 	
 	auto scene = ml.loadScene(file.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
 
@@ -46,68 +52,66 @@ bool Scene::loadScene(std::string file, int mode) {
 	
 	std::cout << "Scene " << file << " loaded" << std::endl;
 
-	for (auto model : scene->models) {
+	loadProgress = 0.2f;
 
-		// Materials
-		for (auto material : model->materials) {
+	return loadGeometry(*scene, directory);
+}
 
-			asoc_mat.insert(std::pair<std::shared_ptr<ge::sg::Material>, int>(material, mat_id));
-			mat_id++;
+bool Scene::loadGenerated(SceneGenerator::distribution d, size_t triangleCount){
 
-			gpu_material m;
+	triangles.shrink_to_fit();
+	materials.shrink_to_fit();
 
-			for (auto comp : material->materialComponents) {
+	triangles.clear();
+	materials.clear();
 
-				if (comp->getType() == ge::sg::MaterialComponent::ComponentType::SIMPLE) {
-					ge::sg::MaterialSimpleComponent* ms = (ge::sg::MaterialSimpleComponent*)comp.get();
-					
-					if (ms->semantic == ge::sg::MaterialSimpleComponent::Semantic::diffuseColor) {
+	textures.clear();
+	materialTextures.clear();
+	clusters.reset();
 
-						float* col = (float*)ms->data.get();
-						m.diffuseColor = glm::vec3(col[0], col[1], col[2]);
-					}
+	loadProgress = 0.0f;
 
-					else if (ms->semantic == ge::sg::MaterialSimpleComponent::Semantic::specularColor) {
+	// Generated scene is built in memory, it has no textures
+	AllocationCounter::tag memoryTag(AllocationCounter::LOADER);
+	auto scene = SceneGenerator::generate(d, triangleCount);
 
-						float* col = (float*)ms->data.get();
-						m.metalness = col[0];
-					}
+	std::cout << "Scene " << SceneGenerator::getName(d) << " with " << triangleCount << " triangles generated" << std::endl;
 
-					else if (ms->semantic == ge::sg::MaterialSimpleComponent::Semantic::ambientColor) {
+	loadProgress = 0.2f;
 
-						float* col = (float*)ms->data.get();
-						m.roughness = col[0];
-					}
-				}
+	return loadGeometry(*scene, "");
+}
 
-				if (comp->getType() == ge::sg::MaterialComponent::ComponentType::IMAGE) {
-					
-					ge::sg::MaterialImageComponent* mi = (ge::sg::MaterialImageComponent*)comp.get();
-					
-					if (mi->semantic == ge::sg::MaterialImageComponent::Semantic::diffuseTexture) {
+bool Scene::loadGeometry(const ge::sg::Scene& scene, std::string directory){
 
-						std::replace(mi->filePath.begin(), mi->filePath.end(), '\\', '/');
+	AllocationCounter::tag memoryTag(AllocationCounter::SCENE);
 
-						std::string fullPath;
+	std::vector<float> tmp_pos, tmp_nor, tmp_uv;
+	std::vector<unsigned> tmp_mat, tmp_ind;
+	std::map<std::shared_ptr<ge::sg::Material>, int> asoc_mat;
+	float* tmp;
+	int mat_id = 0;
 
-						if (std::count(mi->filePath.begin(), mi->filePath.end(), '/') < 3)
-							fullPath = directory + '/' + mi->filePath;
-						else
-							fullPath = mi->filePath;
+	size_t meshCount = 0, processedMeshes = 0;
+	for (auto model : scene.models)
+		meshCount += model->meshes.size();
 
-						if(loadTexture(fullPath))
-							m.diffuseTexture = texHandles[texHandles.size() - 1];
-					}
-				}
+	for (auto model : scene.models) {
 
-			}
-			materials.push_back(m);
+		// Materials
+		for (auto material : model->materials) {
+			asoc_mat.insert(std::pair<std::shared_ptr<ge::sg::Material>, int>(material, mat_id));
+			mat_id++;
+
+			loadMaterial(material, directory);
 		}
 
 		// Meshes
 		for (auto mesh : model->meshes) {
 
-			tmp_mat.insert(tmp_mat.end(), mesh->count, asoc_mat.at(mesh->material));
+			// Indices of mesh are offset by vertices of previous meshes (vertices can be shared)
+			size_t firstIndex = tmp_ind.size();
+			unsigned vertexOffset = static_cast<unsigned>(tmp_pos.size() / 3);
 
 			for (auto attr : mesh->attributes) {
 
@@ -127,95 +131,244 @@ bool Scene::loadScene(std::string file, int mode) {
 				else if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::indices) {
 					unsigned* ind = static_cast<unsigned*>(attr->data.get());
 					std::copy(ind, ind + (attr->size / sizeof(unsigned)), std::back_inserter(tmp_ind));
-
-					for (int i = ind_offset; i < tmp_ind.size(); i++){
-						tmp_ind[i] += ind_offset;
-					}
-
-					ind_offset = tmp_ind.size();
 				}
 
 			}
+
+			for (size_t i = firstIndex; i < tmp_ind.size(); i++)
+				tmp_ind[i] += vertexOffset;
+
+			// Material of every vertex
+			tmp_mat.resize(tmp_pos.size() / 3, asoc_mat.at(mesh->material));
+
+			processedMeshes++;
+			loadProgress = 0.2f + 0.5f * (processedMeshes / static_cast<float>(meshCount));
 		}
 	}
 
-	
-	whole_scene->count = tmp_pos.size() / 3;
 
-	positions->size = tmp_pos.size() * sizeof(float);
-	positions->numComponents = 3;
-	positions->semantic = ge::sg::AttributeDescriptor::Semantic::position;
-	positions->data.reset();
+	// Attributes are moved, views for BVH builders point into them
+	coords.swap(tmp_pos);
+	normals.swap(tmp_nor);
+	texcoords.swap(tmp_uv);
+	mats.swap(tmp_mat);
+	sceneIndices.swap(tmp_ind);
 
-	indices->size = tmp_ind.size() * sizeof(unsigned);
-	indices->numComponents = 1;
-	indices->semantic = ge::sg::AttributeDescriptor::Semantic::indices;
-	indices->data.reset();
+	loadProgress = 1.0f;
 
-	float* a = new float[tmp_pos.size()];
-	std::memcpy(a, tmp_pos.data(), sizeof(float) * tmp_pos.size());
-	positions->data = std::shared_ptr<void>((void*)a);
+	return true;
+}
 
-	unsigned* b = new unsigned[tmp_ind.size()];
-	std::memcpy(b, tmp_ind.data(), sizeof(unsigned) * tmp_ind.size());
-	indices->data = std::shared_ptr<void>((void*)b);
+bool Scene::loadClustered(std::string file, size_t memoryBudget, size_t gpuBudget){
 
-	whole_scene->attributes.push_back(positions);
-	whole_scene->attributes.push_back(indices);
-	whole_scene->primitive = ge::sg::Mesh::PrimitiveType::TRIANGLES;
+	AllocationCounter::tag memoryTag(AllocationCounter::SCENE);
 
-	void* atr = whole_scene->attributes[0]->data.get();
-	float* att = (float*)atr;
+	triangles.clear();
+	materials.clear();
+	coords.clear();
+	normals.clear();
+	texcoords.clear();
+	mats.clear();
+	sceneIndices.clear();
 
-	coords = tmp_pos;
-	normals = tmp_nor;
-	texcoords = tmp_uv;
-	mats = tmp_mat;
+	textures.clear();
+	materialTextures.clear();
+	clusters.reset();
 
-	if(!mode)
-		return true;
+	loadProgress = 0.0f;
 
-	for (int i = 0; i < tmp_ind.size(); i += 3) {
-		gpu_triangle t;
+	std::string directory;
+	std::map<std::shared_ptr<ge::sg::Material>, int> asoc_mat;
+	int mat_id = 0;
+
+	std::replace(file.begin(), file.end(), '\\', '/');
+	std::cout << file << std::endl;
+
+	auto scene = ml.loadScene(file.c_str(), aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
+
+	if (scene == nullptr)
+		return false;
+
+	const size_t last_slash_idx = file.rfind('/');
+	if (std::string::npos != last_slash_idx)
+		directory = file.substr(0, last_slash_idx);
 
-		t.coord_a = glm::vec4(tmp_pos[3 * i], tmp_pos[(3 * i) + 1], tmp_pos[(3 * i) + 2], 1.0f);
-		t.coord_b = glm::vec4(tmp_pos[3 * (i + 1)], tmp_pos[(3 * (i + 1)) + 1], tmp_pos[(3 * (i + 1)) + 2], 1.0f);
-		t.coord_c = glm::vec4(tmp_pos[3 * (i + 2)], tmp_pos[(3 * (i + 2)) + 1], tmp_pos[(3 * (i + 2)) + 2], 1.0f);
+	std::cout << "Scene " << file << " loaded" << std::endl;
 
-		posVector.push_back(t.coord_a.x);
-		posVector.push_back(t.coord_a.y);
-		posVector.push_back(t.coord_a.z);
+	loadProgress = 0.2f;
 
-		posVector.push_back(t.coord_b.x);
-		posVector.push_back(t.coord_b.y);
-		posVector.push_back(t.coord_b.z);
+	// Materials and bounds of scene
+	glm::vec3 sceneMin(std::numeric_limits<float>::max()), sceneMax(std::numeric_limits<float>::lowest());
+	size_t meshCount = 0, processedMeshes = 0;
 
-		posVector.push_back(t.coord_c.x);
-		posVector.push_back(t.coord_c.y);
-		posVector.push_back(t.coord_c.z);
+	for (auto model : scene->models) {
 
-		t.normal_a = glm::vec4(tmp_nor[3 * (i)], tmp_nor[(3 * i) + 1], tmp_nor[(3 * i) + 2], 1.0f);
-		t.normal_b = glm::vec4(tmp_nor[3 * (i + 1)], tmp_nor[(3 * (i + 1)) + 1], tmp_nor[(3 * (i + 1)) + 2], 1.0f);
-		t.normal_c = glm::vec4(tmp_nor[3 * (i + 2)], tmp_nor[(3 * (i + 2)) + 1], tmp_nor[(3 * (i + 2)) + 2], 1.0f);
+		for (auto material : model->materials) {
+			asoc_mat.insert(std::pair<std::shared_ptr<ge::sg::Material>, int>(material, mat_id));
+			mat_id++;
 
-		if (!tmp_uv.empty()) {
-			t.uv_a = glm::vec2(tmp_uv[2 * i], tmp_uv[(2 * i) + 1]);
-			t.uv_b = glm::vec2(tmp_uv[2 * (i + 1)], tmp_uv[(2 * (i + 1)) + 1]);
-			t.uv_c = glm::vec2(tmp_uv[2 * (i + 2)], tmp_uv[(2 * (i + 2)) + 1]);
+			loadMaterial(material, directory);
 		}
 
-		t.material_id = tmp_mat[i];
+		for (auto mesh : model->meshes) {
 
-		triangles.push_back(t);
+			meshCount++;
+
+			for (auto attr : mesh->attributes) {
+
+				if (attr->semantic != ge::sg::AttributeDescriptor::Semantic::position)
+					continue;
+
+				float* pos = static_cast<float*>(attr->data.get());
+
+				for (size_t i = 0; i + 2 < attr->size / sizeof(float); i += 3) {
+					sceneMin = glm::min(sceneMin, glm::vec3(pos[i], pos[i + 1], pos[i + 2]));
+					sceneMax = glm::max(sceneMax, glm::vec3(pos[i], pos[i + 1], pos[i + 2]));
+				}
+			}
+		}
+	}
+
+	clusters = std::make_shared<ClusterCache>();
+	clusters->setMemoryBudget(memoryBudget);
+	clusters->setGpuBudget(gpuBudget);
+
+	if (!clusters->begin(file + CLUSTER_FILE_EXTENSION, sceneMin, sceneMax)) {
+		clusters.reset();
+		return false;
+	}
+
+	// Triangles go into clusters on disk mesh by mesh, geometry of mesh is released immediately
+	for (auto model : scene->models) {
+		for (auto mesh : model->meshes) {
+
+			float* pos = nullptr;
+			float* nor = nullptr;
+			float* uv = nullptr;
+			unsigned* ind = nullptr;
+			size_t indCount = 0;
+
+			for (auto attr : mesh->attributes) {
+
+				if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::position)
+					pos = static_cast<float*>(attr->data.get());
+				else if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::normal)
+					nor = static_cast<float*>(attr->data.get());
+				else if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::texcoord)
+					uv = static_cast<float*>(attr->data.get());
+				else if (attr->semantic == ge::sg::AttributeDescriptor::Semantic::indices) {
+					ind = static_cast<unsigned*>(attr->data.get());
+					indCount = attr->size / sizeof(unsigned);
+				}
+			}
+
+			int material = asoc_mat.at(mesh->material);
+
+			for (size_t i = 0; pos != nullptr && ind != nullptr && i + 2 < indCount; i += 3) {
+				gpu_triangle t = {};
+
+				t.coord_a = glm::vec4(pos[3 * ind[i]], pos[3 * ind[i] + 1], pos[3 * ind[i] + 2], 1.0f);
+				t.coord_b = glm::vec4(pos[3 * ind[i + 1]], pos[3 * ind[i + 1] + 1], pos[3 * ind[i + 1] + 2], 1.0f);
+				t.coord_c = glm::vec4(pos[3 * ind[i + 2]], pos[3 * ind[i + 2] + 1], pos[3 * ind[i + 2] + 2], 1.0f);
+
+				if (nor != nullptr) {
+					t.normal_a = glm::vec4(nor[3 * ind[i]], nor[3 * ind[i] + 1], nor[3 * ind[i] + 2], 1.0f);
+					t.normal_b = glm::vec4(nor[3 * ind[i + 1]], nor[3 * ind[i + 1] + 1], nor[3 * ind[i + 1] + 2], 1.0f);
+					t.normal_c = glm::vec4(nor[3 * ind[i + 2]], nor[3 * ind[i + 2] + 1], nor[3 * ind[i + 2] + 2], 1.0f);
+				}
+
+				if (uv != nullptr) {
+					t.uv_a = glm::vec2(uv[2 * ind[i]], uv[2 * ind[i] + 1]);
+					t.uv_b = glm::vec2(uv[2 * ind[i + 1]], uv[2 * ind[i + 1] + 1]);
+					t.uv_c = glm::vec2(uv[2 * ind[i + 2]], uv[2 * ind[i + 2] + 1]);
+				}
+
+				t.material_id = material;
+
+				clusters->insert(t);
+			}
+
+			mesh->attributes.clear();
+
+			processedMeshes++;
+			loadProgress = 0.2f + 0.7f * (processedMeshes / static_cast<float>(meshCount));
+		}
 	}
 
+	if (!clusters->finish()) {
+		clusters.reset();
+		return false;
+	}
+
+	loadProgress = 1.0f;
+
 	return true;
 }
 
-void Scene::prepareScene(){
+void Scene::loadMaterial(std::shared_ptr<ge::sg::Material> material, std::string directory){
 
-	std::vector<unsigned> indices = std::vector<unsigned>(static_cast<unsigned*> (this->indices->data.get()), static_cast<unsigned*> (this->indices->data.get()) + (this->indices->size / sizeof(unsigned)));
-	triangles.shrink_to_fit();
+	gpu_material m;
+	int textureSlot = -1;
+
+	for (auto comp : material->materialComponents) {
+
+		if (comp->getType() == ge::sg::MaterialComponent::ComponentType::SIMPLE) {
+			ge::sg::MaterialSimpleComponent* ms = (ge::sg::MaterialSimpleComponent*)comp.get();
+			
+			if (ms->semantic == ge::sg::MaterialSimpleComponent::Semantic::diffuseColor) {
+
+				float* col = (float*)ms->data.get();
+				m.diffuseColor = glm::vec3(col[0], col[1], col[2]);
+			}
+
+			else if (ms->semantic == ge::sg::MaterialSimpleComponent::Semantic::specularColor) {
+
+				float* col = (float*)ms->data.get();
+				m.metalness = col[0];
+			}
+
+			else if (ms->semantic == ge::sg::MaterialSimpleComponent::Semantic::ambientColor) {
+
+				float* col = (float*)ms->data.get();
+				m.roughness = col[0];
+			}
+		}
+
+		if (comp->getType() == ge::sg::MaterialComponent::ComponentType::IMAGE) {
+			
+			ge::sg::MaterialImageComponent* mi = (ge::sg::MaterialImageComponent*)comp.get();
+			
+			if (mi->semantic == ge::sg::MaterialImageComponent::Semantic::diffuseTexture) {
+
+				std::replace(mi->filePath.begin(), mi->filePath.end(), '\\', '/');
+
+				std::string fullPath;
+
+				if (std::count(mi->filePath.begin(), mi->filePath.end(), '/') < 3)
+					fullPath = directory + '/' + mi->filePath;
+				else
+					fullPath = mi->filePath;
+
+				textureSlot = textures.request(fullPath);
+			}
+		}
+
+	}
+
+	// Placeholder is used until texture is resident
+	m.diffuseTexture = textures.getHandle(textureSlot);
+
+	materials.push_back(m);
+	materialTextures.push_back(textureSlot);
+
+}
+
+void Scene::prepareScene(const std::vector<unsigned>& indices){
+
+	AllocationCounter::tag memoryTag(AllocationCounter::SCENE);
+
+	triangles.clear();
+	triangles.reserve(indices.size() / 3);
 	
 	for (int i = 0; i < indices.size(); i += 3) {
 		gpu_triangle t;
@@ -241,6 +394,10 @@ void Scene::prepareScene(){
 
 }
 
+float Scene::getLoadProgress(){
+	return loadProgress;
+}
+
 std::vector<Scene::gpu_triangle>& Scene::getGeometry(){
 	return triangles;
 }
@@ -249,73 +406,35 @@ std::vector<Scene::gpu_material>& Scene::getMaterials(){
 	return materials;
 }
 
-std::vector<float>& Scene::getPositionsVector(){
-	return posVector;
+std::vector<unsigned>& Scene::getIndices(){
+	return sceneIndices;
 }
 
-std::shared_ptr<ge::sg::Mesh>& Scene::getSceneMesh(){
-	return whole_scene;
+ge::sg::GeometryView Scene::getGeometryView(){
+	return ge::sg::GeometryView(coords.data(), coords.size() / 3, sceneIndices.data(), sceneIndices.size());
 }
 
-void Scene::init(){
-
-	whole_scene->attributes.push_back(positions);
-	whole_scene->attributes.push_back(indices);
+std::shared_ptr<ClusterCache>& Scene::getClusters(){
+	return clusters;
+}
 
-	positions->semantic = ge::sg::AttributeDescriptor::Semantic::position;
-	positions->numComponents = 3;
-	positions->type = ge::sg::AttributeDescriptor::DataType::FLOAT;
+void Scene::init(){
 
-	indices->semantic = ge::sg::AttributeDescriptor::Semantic::indices;
-	indices->numComponents = 1;
-	indices->type = ge::sg::AttributeDescriptor::DataType::UNSIGNED_INT;
+	textures.init();
 	
 }
 
-bool Scene::loadTexture(std::string path){
-	
-	GLuint textureID;
-	int width, height, comp;
-
-	ge::gl::glGenTextures(1, &textureID);
+bool Scene::texturesLoaded(){
+	return textures.isIdle();
+}
 
-	std::unique_ptr<unsigned char> imageData;
-	
-	// Load texture
-	imageData.reset(stbi_load(path.c_str(), &width, &height, &comp, STBI_default));
+bool Scene::updateTextures(){
 
-	if (imageData.get() == nullptr){
-		std::cout << "Texture " << path << " loading failed" << std::endl;
+	if (!textures.update())
 		return false;
-	}
-
-	GLenum components = comp == 3 ? GL_RGB : comp == 1 ? GL_RED : GL_RGBA;
-
-	// Setup texture
-	ge::gl::glBindTexture(GL_TEXTURE_2D, textureID);
-
-	ge::gl::glTexImage2D(GL_TEXTURE_2D, 0, components, width, height, 0, components, GL_UNSIGNED_BYTE, imageData.get());
-	ge::gl::glGenerateMipmap(GL_TEXTURE_2D);
-
-	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	ge::gl::glBindTexture(GL_TEXTURE_2D, 0);
-
-	// Bindless texture
-	textureIDs.push_back(textureID);
-	texHandles.push_back(ge::gl::glGetTextureHandleARB(textureIDs.at(textureIDs.size() - 1)));
-	ge::gl::glMakeTextureHandleResidentARB(texHandles.at(texHandles.size() - 1));
-	
-	stbi_image_free(imageData.get());
-	imageData.release();
-
-#ifdef TEXTURES_PRINT
-	std::cout << "Loaded " << path.c_str() << std::endl;
-#endif
+	for (int i = 0; i < materials.size(); i++)
+		materials[i].diffuseTexture = textures.getHandle(materialTextures[i]);
 
 	return true;
-
 }
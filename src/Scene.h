@@ -26,8 +26,16 @@
 #include <geGL/geGL.h>
 #include <geGL/StaticCalls.h>
 
+#include <TextureLoader.h>
+#include <GeometryView.h>
+#include <SceneGenerator.h>
+#include <AllocationCounter.h>
+
 #include <iostream>
 #include <vector>
+#include <atomic>
+
+class ClusterCache;
 
 /**
 * @brief Scene manager class
@@ -71,15 +79,41 @@ public:
 	/**
 	* @brief loads scene from given file
 	* @param file path to file with scene data
-	* @param mode mode of loading
 	* @return true if success
+	* @note can be called from loading thread, GL objects are created in updateTextures() only
+	*/
+	bool loadScene(std::string file);
+
+	/**
+	* @brief Generates procedural scene in memory (no Assimp round trip)
+	* @param d Distribution of triangles
+	* @param triangleCount Approximate number of triangles
+	* @return true if success
+	* @note can be called from loading thread
+	*/
+	bool loadGenerated(SceneGenerator::distribution d, size_t triangleCount);
+
+	/**
+	* @brief Getter for progress of loadScene() call
+	* @return Progress of loading in range 0 - 1
+	*/
+	float getLoadProgress();
+
+	/**
+	* @brief loads scene from given file in out-of-core mode (geometry is partitioned into clusters on disk)
+	* @param file path to file with scene data
+	* @param memoryBudget Maximum size of clusters kept in main memory (in bytes)
+	* @param gpuBudget Maximum size of clusters resident on GPU (in bytes)
+	* @return true if success
+	* @note can be called from loading thread, geometry vectors stay empty
 	*/
-	bool loadScene(std::string file, int mode);
+	bool loadClustered(std::string file, size_t memoryBudget, size_t gpuBudget);
 	
 	/**
 	* @brief Converts scene into vector of triangles, prepares geometry for transfer on GPU
+	* @param indices Triangle indices in required order (e.g. reordered by CPU BVH build)
 	*/
-	void prepareScene();
+	void prepareScene(const std::vector<unsigned>& indices);
 	//bool prepareGeometry(ge::sg::MeshIndexedTriangleIterator start, ge::sg::MeshIndexedTriangleIterator end);
 
 	/**
@@ -95,16 +129,34 @@ public:
 	std::vector<gpu_material>& getMaterials();
 
 	/**
-	* @brief Getter for position vectors of triangles
-	* @return Vector of position vectors
+	* @brief Getter for triangle indices of scene (in order of loading)
+	* @return Vector of indices, 3 per triangle
 	*/
-	std::vector<float>& getPositionsVector();
+	std::vector<unsigned>& getIndices();
 
 	/**
-	* @brief Gets Mesh object, which includes all triangles in scene (may be useful for BVH build)
-	* @return Mesh object with all scene triangles
+	* @brief Gets non-owning view of scene geometry for BVH build (valid until next load)
+	* @return View of positions and indices of all triangles in scene
 	*/
-	std::shared_ptr<ge::sg::Mesh>& getSceneMesh();
+	ge::sg::GeometryView getGeometryView();
+
+	/**
+	* @brief Getter for clusters of scene loaded in out-of-core mode
+	* @return Cluster cache, nullptr if scene is not loaded in out-of-core mode
+	*/
+	std::shared_ptr<ClusterCache>& getClusters();
+
+	/**
+	* @brief Streams loaded textures on GPU and updates materials by resident textures
+	* @return true if materials have changed (material buffer needs update)
+	*/
+	bool updateTextures();
+
+	/**
+	* @brief Checks, if all textures of scene are processed (resident or failed)
+	* @return true if no texture is being loaded
+	*/
+	bool texturesLoaded();
 
 private:
 
@@ -114,31 +166,42 @@ private:
 	void init();
 
 	/**
-	* @brief Loads texture from file
-	* @param path Path to file with texture
+	* @brief Converts material into GPU material, requests its texture
+	* @param material Loaded material
+	* @param directory Directory of scene file (base of relative texture paths)
+	*/
+	void loadMaterial(std::shared_ptr<ge::sg::Material> material, std::string directory);
+
+	/**
+	* @brief Converts geometry and materials of loaded or generated scene into attributes of triangles
+	* @param scene Scene graph with meshes
+	* @param directory Directory of scene file (base of relative texture paths)
 	* @return true if success
 	*/
-	bool loadTexture(std::string path);
+	bool loadGeometry(const ge::sg::Scene& scene, std::string directory);
 
 	// Loader objects
 	AssimpModelLoader ml;
-	std::shared_ptr<ge::sg::Mesh> whole_scene = std::make_shared<ge::sg::Mesh>();
-	std::shared_ptr<ge::sg::AttributeDescriptor> positions = std::make_shared<ge::sg::AttributeDescriptor>();
-	std::shared_ptr<ge::sg::AttributeDescriptor> indices = std::make_shared<ge::sg::AttributeDescriptor>();
 
 	// Triangle attributes
 	std::vector<float> coords;
 	std::vector<float> normals;
 	std::vector<float> texcoords;
+	std::vector<unsigned> sceneIndices;
 
 	// Material attributes
 	std::vector<unsigned> mats;
-	std::vector<GLuint> textureIDs;
-	std::vector<GLuint64> texHandles;
+	std::vector<int> materialTextures;
+	TextureLoader textures;
 
 	// Data for usage on GPU
 	std::vector<gpu_triangle> triangles;
 	std::vector<gpu_material> materials;
-	std::vector<float> posVector;
+
+	// Out-of-core geometry
+	std::shared_ptr<ClusterCache> clusters;
+
+	// Progress of loading (read from main thread)
+	std::atomic<float> loadProgress{ 0.0f };
 
 };
\ No newline at end of file
@@ -0,0 +1,316 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* SceneGenerator.cpp
+*/
+
+#include <SceneGenerator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <type_traits>
+
+std::shared_ptr<ge::sg::Scene> SceneGenerator::generate(distribution d, size_t triangles, unsigned seed){
+
+	auto scene = std::make_shared<ge::sg::Scene>();
+	auto model = std::make_shared<ge::sg::Model>();
+	scene->models.push_back(model);
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f), symmetric(-1.0f, 1.0f);
+
+	// Random unit vector
+	auto direction = [&]() {
+		glm::vec3 v;
+		do {
+			v = glm::vec3(symmetric(generator), symmetric(generator), symmetric(generator));
+		} while (glm::dot(v, v) > 1.0f || glm::dot(v, v) < 1e-6f);
+		return glm::normalize(v);
+	};
+
+	triangles = std::max(triangles, static_cast<size_t>(1));
+
+	meshData mesh;
+	auto material = createMaterial(glm::vec3(0.8f));
+	model->materials.push_back(material);
+
+	switch (d) {
+
+	case UNIFORM_RANDOM: {
+
+		// Triangles are as large as spacing of their centers
+		float size = 2.0f / std::cbrt(static_cast<float>(triangles));
+		reserve(mesh, triangles);
+
+		for (size_t t = 0; t < triangles; t++) {
+			glm::vec3 center(symmetric(generator), symmetric(generator), symmetric(generator));
+			triangle(mesh, center + size * direction(), center + size * direction(), center + size * direction());
+		}
+		break;
+	}
+
+	case SPHERES: {
+
+		size_t perSphere = std::min(triangles, static_cast<size_t>(SCENE_GENERATOR_OBJECT_TRIANGLES));
+		size_t count = std::max(triangles / perSphere, static_cast<size_t>(1));
+		float extent = 4.0f * std::cbrt(static_cast<float>(count));
+
+		for (size_t s = 0; s < count; s++) {
+			glm::vec3 center(extent * symmetric(generator), extent * symmetric(generator), extent * symmetric(generator));
+			sphere(mesh, center, 0.5f + unit(generator), perSphere);
+		}
+		break;
+	}
+
+	case TEAPOT_IN_STADIUM: {
+
+		size_t stadium = std::max(static_cast<size_t>(triangles * SCENE_GENERATOR_STADIUM_PART), static_cast<size_t>(64));
+		size_t segments = stadium / 2;
+		float radius = 100.0f, height = 20.0f;
+
+		// Stadium - open tube of large triangles around the scene
+		for (size_t s = 0; s < segments; s++) {
+
+			float a0 = 6.2831853f * s / segments, a1 = 6.2831853f * (s + 1) / segments;
+			glm::vec3 p0(radius * std::cos(a0), 0.0f, radius * std::sin(a0)), p1(radius * std::cos(a1), 0.0f, radius * std::sin(a1));
+			glm::vec3 up(0.0f, height, 0.0f);
+
+			triangle(mesh, p0, p1, p1 + up);
+			triangle(mesh, p0, p1 + up, p0 + up);
+		}
+
+		model->meshes.push_back(createMesh(mesh, material));
+
+		// Teapot - small densely tessellated object in the middle
+		auto teapot = createMaterial(glm::vec3(0.8f, 0.2f, 0.2f));
+		model->materials.push_back(teapot);
+
+		sphere(mesh, glm::vec3(0.0f, 1.0f, 0.0f), 0.5f, triangles > 2 * segments ? triangles - 2 * segments : 8);
+		model->meshes.push_back(createMesh(mesh, teapot));
+
+		return scene;
+	}
+
+	case THIN_TRIANGLES: {
+
+		// Length of triangles is quarter of scene, width is thousand times smaller
+		float length = 0.5f, width = 0.0005f;
+		reserve(mesh, triangles);
+
+		for (size_t t = 0; t < triangles; t++) {
+
+			glm::vec3 center(symmetric(generator), symmetric(generator), symmetric(generator));
+			glm::vec3 axis = direction();
+			glm::vec3 side = glm::cross(axis, direction());
+
+			if (glm::dot(side, side) < 1e-6f)
+				side = glm::cross(axis, glm::vec3(axis.y, axis.z, axis.x) + glm::vec3(1.0f, 0.0f, 0.0f));
+
+			side = glm::normalize(side);
+
+			triangle(mesh, center - 0.5f * length * axis, center + 0.5f * length * axis, center + width * side);
+		}
+		break;
+	}
+
+	case INSTANCED_GRID: {
+
+		size_t perObject = std::min(triangles, static_cast<size_t>(SCENE_GENERATOR_OBJECT_TRIANGLES));
+		size_t count = std::max(triangles / perObject, static_cast<size_t>(1));
+		size_t side = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+
+		meshData object;
+		sphere(object, glm::vec3(0.0f), 1.0f, perObject);
+
+		// Instances are baked, builders see all triangles
+		for (size_t i = 0; i < count; i++)
+			instance(mesh, object, 3.0f * glm::vec3(static_cast<float>(i % side), static_cast<float>((i / side) % side), static_cast<float>(i / (side * side))));
+
+		break;
+	}
+
+	}
+
+	model->meshes.push_back(createMesh(mesh, material));
+
+	return scene;
+}
+
+bool SceneGenerator::parse(std::string file, distribution & d, size_t & triangles){
+
+	std::string prefix = SCENE_GENERATOR_PREFIX;
+
+	if (file.compare(0, prefix.size(), prefix) != 0)
+		return false;
+
+	size_t separator = file.find(':', prefix.size());
+
+	if (separator == std::string::npos || !parseDistribution(file.substr(prefix.size(), separator - prefix.size()), d))
+		return false;
+
+	try {
+		triangles = static_cast<size_t>(std::stoull(file.substr(separator + 1)));
+	}
+	catch (std::exception&) {
+		return false;
+	}
+
+	return triangles > 0;
+}
+
+bool SceneGenerator::parseDistribution(std::string name, distribution & d){
+
+	for (distribution candidate : { UNIFORM_RANDOM, SPHERES, TEAPOT_IN_STADIUM, THIN_TRIANGLES, INSTANCED_GRID }) {
+		if (getName(candidate) == name) {
+			d = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::string SceneGenerator::getName(distribution d){
+
+	switch (d) {
+	case UNIFORM_RANDOM: return "uniform";
+	case SPHERES: return "spheres";
+	case TEAPOT_IN_STADIUM: return "stadium";
+	case THIN_TRIANGLES: return "thin";
+	case INSTANCED_GRID: return "grid";
+	}
+
+	return "";
+}
+
+void SceneGenerator::triangle(meshData & mesh, glm::vec3 a, glm::vec3 b, glm::vec3 c){
+
+	glm::vec3 n = glm::cross(b - a, c - a);
+	n = glm::dot(n, n) > 0.0f ? glm::normalize(n) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	for (const glm::vec3& v : { a, b, c }) {
+		mesh.indices.push_back(static_cast<unsigned>(mesh.positions.size() / 3));
+		mesh.positions.insert(mesh.positions.end(), { v.x, v.y, v.z });
+		mesh.normals.insert(mesh.normals.end(), { n.x, n.y, n.z });
+	}
+
+}
+
+void SceneGenerator::reserve(meshData & mesh, size_t triangles){
+
+	mesh.positions.reserve(9 * triangles);
+	mesh.normals.reserve(9 * triangles);
+	mesh.indices.reserve(3 * triangles);
+
+}
+
+void SceneGenerator::sphere(meshData & mesh, glm::vec3 center, float radius, size_t triangles){
+
+	// Sphere with r rings and 2r segments has 4r(r - 1) triangles (one triangle per quad at poles)
+	unsigned rings = std::max(2u, static_cast<unsigned>(std::lround((1.0 + std::sqrt(1.0 + static_cast<double>(triangles))) / 2.0)));
+	unsigned segments = 2 * rings;
+	unsigned first = static_cast<unsigned>(mesh.positions.size() / 3);
+
+	for (unsigned r = 0; r <= rings; r++) {
+
+		// Poles and seam share exactly the same positions (closed mesh without cracks)
+		float theta = 3.14159265f * r / rings;
+		float sinTheta = r == rings ? 0.0f : std::sin(theta);
+
+		for (unsigned s = 0; s <= segments; s++) {
+
+			float phi = s == segments ? 0.0f : 6.2831853f * s / segments;
+			glm::vec3 n(sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi));
+			glm::vec3 p = center + radius * n;
+
+			mesh.positions.insert(mesh.positions.end(), { p.x, p.y, p.z });
+			mesh.normals.insert(mesh.normals.end(), { n.x, n.y, n.z });
+		}
+	}
+
+	for (unsigned r = 0; r < rings; r++) {
+		for (unsigned s = 0; s < segments; s++) {
+
+			unsigned a = first + r * (segments + 1) + s, b = a + 1;
+			unsigned c = a + segments + 1, e = c + 1;
+
+			if (r > 0)
+				mesh.indices.insert(mesh.indices.end(), { a, b, e });
+
+			if (r + 1 < rings)
+				mesh.indices.insert(mesh.indices.end(), { a, e, c });
+		}
+	}
+
+}
+
+void SceneGenerator::instance(meshData & mesh, const meshData & object, glm::vec3 offset){
+
+	unsigned first = static_cast<unsigned>(mesh.positions.size() / 3);
+
+	for (size_t i = 0; i < object.positions.size(); i += 3)
+		mesh.positions.insert(mesh.positions.end(), { object.positions[i] + offset.x, object.positions[i + 1] + offset.y, object.positions[i + 2] + offset.z });
+
+	mesh.normals.insert(mesh.normals.end(), object.normals.begin(), object.normals.end());
+
+	for (unsigned index : object.indices)
+		mesh.indices.push_back(first + index);
+
+}
+
+std::shared_ptr<ge::sg::Mesh> SceneGenerator::createMesh(meshData & data, std::shared_ptr<ge::sg::Material> material){
+
+	auto mesh = std::make_shared<ge::sg::Mesh>();
+	mesh->count = data.indices.size();
+	mesh->primitive = ge::sg::Mesh::PrimitiveType::TRIANGLES;
+	mesh->material = material;
+
+	// Attributes own vectors of mesh data (no copy of large scenes)
+	auto attribute = [&mesh](auto& values, ge::sg::AttributeDescriptor::Semantic semantic, int components, ge::sg::AttributeDescriptor::DataType type) {
+		auto owner = std::make_shared<typename std::remove_reference<decltype(values)>::type>();
+		owner->swap(values);
+
+		auto attr = std::make_shared<ge::sg::AttributeDescriptor>();
+		attr->data = std::shared_ptr<void>(owner, owner->data());
+		attr->size = owner->size() * sizeof((*owner)[0]);
+		attr->numComponents = components;
+		attr->stride = 0;
+		attr->type = type;
+		attr->semantic = semantic;
+
+		mesh->attributes.push_back(attr);
+	};
+
+	attribute(data.indices, ge::sg::AttributeDescriptor::Semantic::indices, 1, ge::sg::AttributeDescriptor::DataType::UNSIGNED_INT);
+	attribute(data.positions, ge::sg::AttributeDescriptor::Semantic::position, 3, ge::sg::AttributeDescriptor::DataType::FLOAT);
+	attribute(data.normals, ge::sg::AttributeDescriptor::Semantic::normal, 3, ge::sg::AttributeDescriptor::DataType::FLOAT);
+
+	return mesh;
+}
+
+std::shared_ptr<ge::sg::Material> SceneGenerator::createMaterial(glm::vec3 color){
+
+	auto material = std::make_shared<ge::sg::Material>();
+
+	// Diffuse color, metalness (specular) and roughness (ambient) as read by Scene
+	auto component = [&material](ge::sg::MaterialSimpleComponent::Semantic semantic, glm::vec3 value) {
+		ge::sg::MaterialSimpleComponent* c = new ge::sg::MaterialSimpleComponent;
+		c->semantic = semantic;
+		c->dataType = ge::sg::MaterialSimpleComponent::DataType::FLOAT;
+		c->size = 3;
+		c->data.reset(new unsigned char[3 * sizeof(float)]);
+		std::copy_n(reinterpret_cast<const unsigned char*>(&value.x), 3 * sizeof(float), c->data.get());
+		material->materialComponents.push_back(std::unique_ptr<ge::sg::MaterialComponent>(c));
+	};
+
+	component(ge::sg::MaterialSimpleComponent::Semantic::diffuseColor, color);
+	component(ge::sg::MaterialSimpleComponent::Semantic::specularColor, glm::vec3(0.0f));
+	component(ge::sg::MaterialSimpleComponent::Semantic::ambientColor, glm::vec3(0.5f));
+
+	return material;
+}
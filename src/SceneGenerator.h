@@ -0,0 +1,140 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* SceneGenerator.h
+*/
+
+#pragma once
+
+#include <geSG/Scene.h>
+#include <geSG/Model.h>
+#include <geSG/Mesh.h>
+#include <geSG/Material.h>
+#include <geSG/AttributeDescriptor.h>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+
+// Prefix of scene name, which is generated instead of loaded (generated:<distribution>:<triangles>)
+#define SCENE_GENERATOR_PREFIX "generated:"
+
+// Seed of random generator (generated scenes are reproducible)
+#define SCENE_GENERATOR_SEED 1
+
+// Number of triangles of one tessellated object (spheres, instances of grid)
+#define SCENE_GENERATOR_OBJECT_TRIANGLES 8192
+
+// Part of triangles in stadium of teapot in stadium scene
+#define SCENE_GENERATOR_STADIUM_PART 0.01f
+
+/**
+* @brief Generator of procedural scenes for stress tests of BVH builders and tracers (no Assimp round trip)
+* @note Scenes have positions, normals and indices as loaded scenes, instances are baked into meshes
+*/
+class SceneGenerator {
+
+public:
+
+	/**
+	* @brief Distributions of generated triangles
+	*/
+	typedef enum {
+		UNIFORM_RANDOM,		// Random triangles in cube, size follows density
+		SPHERES,			// Randomly placed tessellated spheres
+		TEAPOT_IN_STADIUM,	// Dense small object in the middle of large sparse stadium
+		THIN_TRIANGLES,		// Long thin triangles with random orientation (large overlapping boxes)
+		INSTANCED_GRID		// Copies of tessellated object on regular grid
+	} distribution;
+
+	/**
+	* @brief Generates scene
+	* @param d Distribution of triangles
+	* @param triangles Required number of triangles (tessellated scenes have approximately this number)
+	* @param seed Seed of random generator
+	* @return Generated scene with one model
+	*/
+	static std::shared_ptr<ge::sg::Scene> generate(distribution d, size_t triangles, unsigned seed = SCENE_GENERATOR_SEED);
+
+	/**
+	* @brief Parses name of generated scene (generated:<distribution>:<triangles>)
+	* @param file Scene name
+	* @param d Output distribution
+	* @param triangles Output number of triangles
+	* @return true if name describes generated scene
+	*/
+	static bool parse(std::string file, distribution& d, size_t& triangles);
+
+	/**
+	* @brief Parses name of distribution
+	* @param name Name (uniform, spheres, stadium, thin, grid)
+	* @param d Output distribution
+	* @return true if name is known
+	*/
+	static bool parseDistribution(std::string name, distribution& d);
+
+	/**
+	* @brief Getter for name of distribution
+	* @param d Distribution
+	* @return Name used in scene names
+	*/
+	static std::string getName(distribution d);
+
+private:
+
+	/**
+	* @brief Structure of generated mesh data
+	*/
+	typedef struct {
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<unsigned> indices;
+	} meshData;
+
+	/**
+	* @brief Appends triangle with flat normal
+	*/
+	static void triangle(meshData& mesh, glm::vec3 a, glm::vec3 b, glm::vec3 c);
+
+	/**
+	* @brief Reserves memory of mesh data for triangles with own vertices
+	*/
+	static void reserve(meshData& mesh, size_t triangles);
+
+	/**
+	* @brief Appends tessellated sphere (UV sphere)
+	* @param mesh Mesh data
+	* @param center Center of sphere
+	* @param radius Radius of sphere
+	* @param triangles Approximate number of triangles
+	*/
+	static void sphere(meshData& mesh, glm::vec3 center, float radius, size_t triangles);
+
+	/**
+	* @brief Appends copy of mesh moved by offset
+	*/
+	static void instance(meshData& mesh, const meshData& object, glm::vec3 offset);
+
+	/**
+	* @brief Creates mesh of scene graph from mesh data (data are released)
+	* @param data Mesh data
+	* @param material Material of mesh
+	* @return Mesh with position, normal and index attributes
+	*/
+	static std::shared_ptr<ge::sg::Mesh> createMesh(meshData& data, std::shared_ptr<ge::sg::Material> material);
+
+	/**
+	* @brief Creates diffuse material
+	* @param color Diffuse color
+	* @return Material with simple color components
+	*/
+	static std::shared_ptr<ge::sg::Material> createMaterial(glm::vec3 color);
+
+};
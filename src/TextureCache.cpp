@@ -0,0 +1,407 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TextureCache.cpp
+*/
+
+#include <TextureCache.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <3rd_party/image/stb_image.h>
+
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+
+/**
+* @brief Packs 8-bit color into RGB565
+*/
+static uint16_t packColor(const int* c){
+	return static_cast<uint16_t>(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+/**
+* @brief Expands RGB565 color into 8-bit components
+*/
+static void unpackColor(uint16_t packed, int* c){
+
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+void TextureCache::setCompression(bool enable){
+	compression = enable;
+}
+
+void TextureCache::setCaching(bool enable){
+	caching = enable;
+}
+
+bool TextureCache::load(std::string path, textureData & texture){
+
+	// Size and hash of content of source file are used for cache validation (edited texture of the same size is rebuilt)
+	std::ifstream source(path, std::ios::binary | std::ios::ate);
+
+	if (!source.is_open())
+		return false;
+
+	std::vector<unsigned char> content(static_cast<size_t>(source.tellg()));
+	source.seekg(0);
+	source.read(reinterpret_cast<char*>(content.data()), content.size());
+
+	if (!source)
+		return false;
+
+	source.close();
+
+	uint64_t sourceSize = content.size();
+	uint64_t sourceHash = hash(content);
+
+	if (caching && readCache(path, sourceSize, sourceHash, texture))
+		return true;
+
+	// Decode source image from already read content
+	int width, height, comp;
+	unsigned char* pixels = stbi_load_from_memory(content.data(), static_cast<int>(content.size()), &width, &height, &comp, STBI_rgb_alpha);
+
+	if (pixels == nullptr)
+		return false;
+
+	prepare(pixels, width, height, texture);
+	stbi_image_free(pixels);
+
+	if (caching)
+		writeCache(path, sourceSize, sourceHash, texture);
+
+	return true;
+}
+
+bool TextureCache::readCache(std::string path, uint64_t sourceSize, uint64_t sourceHash, textureData & texture){
+
+	std::ifstream file(path + TEXTURE_CACHE_EXTENSION, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+		return false;
+
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	char magic[4];
+	uint32_t version, format, compressed, levels;
+	uint64_t size, contentHash, dataSize;
+
+	file.read(magic, 4);
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(&size), sizeof(size));
+	file.read(reinterpret_cast<char*>(&contentHash), sizeof(contentHash));
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	file.read(reinterpret_cast<char*>(&compressed), sizeof(compressed));
+	file.read(reinterpret_cast<char*>(&levels), sizeof(levels));
+
+	// Outdated cache or cache with other settings
+	if (!file || std::memcmp(magic, "RTTC", 4) != 0 || version != TEXTURE_CACHE_VERSION || size != sourceSize || contentHash != sourceHash || (compressed != 0) != compression)
+		return false;
+
+	if (levels == 0 || levels > TEXTURE_CACHE_MAX_LEVELS)
+		return false;
+
+	texture.format = format;
+	texture.compressed = compressed != 0;
+	texture.levels.resize(levels);
+
+	for (auto& level : texture.levels) {
+		uint32_t w, h;
+		uint64_t offset, levelSize;
+
+		file.read(reinterpret_cast<char*>(&w), sizeof(w));
+		file.read(reinterpret_cast<char*>(&h), sizeof(h));
+		file.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+		file.read(reinterpret_cast<char*>(&levelSize), sizeof(levelSize));
+
+		level.width = w;
+		level.height = h;
+		level.offset = static_cast<size_t>(offset);
+		level.size = static_cast<size_t>(levelSize);
+	}
+
+	file.read(reinterpret_cast<char*>(&dataSize), sizeof(dataSize));
+
+	// Truncated or corrupted file - data block or mip levels outside of file
+	if (!file || dataSize > fileSize - static_cast<uint64_t>(file.tellg()))
+		return false;
+
+	for (auto& level : texture.levels) {
+		if (level.offset > dataSize || level.size > dataSize - level.offset)
+			return false;
+	}
+
+	texture.data.resize(static_cast<size_t>(dataSize));
+	file.read(reinterpret_cast<char*>(texture.data.data()), dataSize);
+
+	return static_cast<bool>(file);
+}
+
+void TextureCache::writeCache(std::string path, uint64_t sourceSize, uint64_t sourceHash, textureData & texture){
+
+	std::ofstream file(path + TEXTURE_CACHE_EXTENSION, std::ios::binary | std::ios::trunc);
+
+	// Cache is optional (e.g. read-only directory)
+	if (!file.is_open())
+		return;
+
+	uint32_t version = TEXTURE_CACHE_VERSION;
+	uint32_t format = texture.format;
+	uint32_t compressed = texture.compressed ? 1 : 0;
+	uint32_t levels = static_cast<uint32_t>(texture.levels.size());
+	uint64_t dataSize = texture.data.size();
+
+	file.write("RTTC", 4);
+	file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	file.write(reinterpret_cast<const char*>(&sourceSize), sizeof(sourceSize));
+	file.write(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash));
+	file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	file.write(reinterpret_cast<const char*>(&compressed), sizeof(compressed));
+	file.write(reinterpret_cast<const char*>(&levels), sizeof(levels));
+
+	for (auto& level : texture.levels) {
+		uint32_t w = level.width, h = level.height;
+		uint64_t offset = level.offset, levelSize = level.size;
+
+		file.write(reinterpret_cast<const char*>(&w), sizeof(w));
+		file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+		file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+		file.write(reinterpret_cast<const char*>(&levelSize), sizeof(levelSize));
+	}
+
+	file.write(reinterpret_cast<const char*>(&dataSize), sizeof(dataSize));
+	file.write(reinterpret_cast<const char*>(texture.data.data()), dataSize);
+
+}
+
+uint64_t TextureCache::hash(const std::vector<unsigned char>& data){
+
+	uint64_t h = 14695981039346656037ull;
+
+	for (unsigned char byte : data) {
+		h ^= byte;
+		h *= 1099511628211ull;
+	}
+
+	return h;
+}
+
+void TextureCache::prepare(const unsigned char * rgba, int width, int height, textureData & texture){
+
+	// Transparent textures need BC3, opaque are stored as BC1
+	bool alpha = false;
+
+	for (size_t i = 3; i < static_cast<size_t>(width) * height * 4 && !alpha; i += 4)
+		alpha = rgba[i] < 255;
+
+	texture.compressed = compression;
+	texture.format = !compression ? GL_RGBA8 : alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	texture.levels.clear();
+	texture.data.clear();
+
+	std::vector<unsigned char> current(rgba, rgba + static_cast<size_t>(width) * height * 4);
+	std::vector<unsigned char> next;
+
+	// Mip chain down to 1x1 level
+	while (true) {
+
+		mipLevel level;
+		level.width = width;
+		level.height = height;
+		level.offset = texture.data.size();
+
+		if (compression)
+			level.size = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8);
+		else
+			level.size = current.size();
+
+		texture.data.resize(level.offset + level.size);
+
+		if (compression)
+			encodeLevel(current.data(), width, height, alpha, texture.data.data() + level.offset);
+		else
+			std::memcpy(texture.data.data() + level.offset, current.data(), level.size);
+
+		texture.levels.push_back(level);
+
+		if (width == 1 && height == 1)
+			break;
+
+		downsample(current.data(), width, height, next);
+		current.swap(next);
+
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+}
+
+void TextureCache::downsample(const unsigned char * src, int width, int height, std::vector<unsigned char>& dst){
+
+	int w = std::max(1, width / 2);
+	int h = std::max(1, height / 2);
+
+	dst.resize(static_cast<size_t>(w) * h * 4);
+
+	// 2x2 box filter (clamped on edges of odd sized levels)
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+
+			for (int c = 0; c < 4; c++) {
+				int sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c] +
+					src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+
+				dst[(static_cast<size_t>(y) * w + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+
+}
+
+void TextureCache::encodeLevel(const unsigned char * src, int width, int height, bool alpha, unsigned char * dst){
+
+	unsigned char block[64];
+
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+
+			// Gather 4x4 block (clamped on edges)
+			for (int y = 0; y < 4; y++) {
+				for (int x = 0; x < 4; x++) {
+					int sx = std::min(bx + x, width - 1);
+					int sy = std::min(by + y, height - 1);
+					std::memcpy(block + (y * 4 + x) * 4, src + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+				}
+			}
+
+			if (alpha) {
+				encodeAlphaBlock(block, dst);
+				dst += 8;
+			}
+
+			encodeColorBlock(block, dst);
+			dst += 8;
+		}
+	}
+
+}
+
+void TextureCache::encodeColorBlock(const unsigned char * block, unsigned char * dst){
+
+	int minColor[3] = { 255, 255, 255 }, maxColor[3] = { 0, 0, 0 };
+
+	// Bounding box of block colors
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			minColor[c] = std::min(minColor[c], static_cast<int>(block[i * 4 + c]));
+			maxColor[c] = std::max(maxColor[c], static_cast<int>(block[i * 4 + c]));
+		}
+	}
+
+	// Inset of bounding box reduces error of end points
+	for (int c = 0; c < 3; c++) {
+		int inset = (maxColor[c] - minColor[c]) >> 4;
+		minColor[c] = std::min(255, minColor[c] + inset);
+		maxColor[c] = std::max(0, maxColor[c] - inset);
+	}
+
+	uint16_t c0 = packColor(maxColor), c1 = packColor(minColor);
+	uint32_t indices = 0;
+
+	// c0 > c1 selects 4 color mode, equal end points use first color only
+	if (c0 != c1) {
+
+		int palette[4][3];
+		unpackColor(c0, palette[0]);
+		unpackColor(c1, palette[1]);
+
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++) {
+
+			int best = 0, bestDist = std::numeric_limits<int>::max();
+
+			for (int p = 0; p < 4; p++) {
+				int dr = block[i * 4] - palette[p][0], dg = block[i * 4 + 1] - palette[p][1], db = block[i * 4 + 2] - palette[p][2];
+				int dist = dr * dr + dg * dg + db * db;
+
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = p;
+				}
+			}
+
+			indices |= static_cast<uint32_t>(best) << (2 * i);
+		}
+	}
+
+	dst[0] = c0 & 0xFF;
+	dst[1] = c0 >> 8;
+	dst[2] = c1 & 0xFF;
+	dst[3] = c1 >> 8;
+	std::memcpy(dst + 4, &indices, 4);
+
+}
+
+void TextureCache::encodeAlphaBlock(const unsigned char * block, unsigned char * dst){
+
+	int a0 = 0, a1 = 255;
+
+	for (int i = 0; i < 16; i++) {
+		a0 = std::max(a0, static_cast<int>(block[i * 4 + 3]));
+		a1 = std::min(a1, static_cast<int>(block[i * 4 + 3]));
+	}
+
+	uint64_t indices = 0;
+
+	// a0 > a1 selects 8 values mode, equal end points use first value only
+	if (a0 != a1) {
+
+		int palette[8] = { a0, a1 };
+
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+		for (int i = 0; i < 16; i++) {
+
+			int best = 0, bestDist = 256;
+
+			for (int p = 0; p < 8; p++) {
+				int dist = std::abs(block[i * 4 + 3] - palette[p]);
+
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = p;
+				}
+			}
+
+			indices |= static_cast<uint64_t>(best) << (3 * i);
+		}
+	}
+
+	dst[0] = static_cast<unsigned char>(a0);
+	dst[1] = static_cast<unsigned char>(a1);
+
+	for (int i = 0; i < 6; i++)
+		dst[2 + i] = static_cast<unsigned char>((indices >> (8 * i)) & 0xFF);
+
+}
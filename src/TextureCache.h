@@ -0,0 +1,154 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TextureCache.h
+*/
+
+#pragma once
+
+#include <geGL/geGL.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Extension of cache files (stored next to source texture)
+#define TEXTURE_CACHE_EXTENSION ".rtc"
+
+// Version of cache file format, older files are rebuilt
+#define TEXTURE_CACHE_VERSION 2
+
+// Maximal number of mip levels in cache file (larger counts mean corrupted file)
+#define TEXTURE_CACHE_MAX_LEVELS 32
+
+/**
+* @brief Builds mip chains of textures on CPU, compresses them and caches them on disk
+*/
+class TextureCache {
+
+public:
+
+	/**
+	* @brief Structure of one mip level
+	*/
+	typedef struct {
+		int width, height;
+		size_t offset, size;
+	} mipLevel;
+
+	/**
+	* @brief Structure of prepared texture (all mip levels in one block of memory)
+	*/
+	typedef struct {
+		GLenum format;
+		bool compressed;
+		std::vector<mipLevel> levels;
+		std::vector<unsigned char> data;
+	} textureData;
+
+	/**
+	* @brief Sets usage of block compression (BC1 for opaque, BC3 for transparent textures)
+	* @param enable true for compressed textures, false for RGBA8 textures
+	*/
+	void setCompression(bool enable);
+
+	/**
+	* @brief Sets usage of cache files
+	* @param enable true if cache files are read and written
+	*/
+	void setCaching(bool enable);
+
+	/**
+	* @brief Loads prepared texture - from cache file if it is valid, else from source file
+	* @param path Path to source texture file
+	* @param texture Output prepared texture
+	* @return true if success
+	*/
+	bool load(std::string path, textureData& texture);
+
+private:
+
+	/**
+	* @brief Reads texture from cache file
+	* @param path Path to source texture file
+	* @param sourceSize Size of source file (validation of cache)
+	* @param sourceHash Hash of content of source file (validation of cache)
+	* @param texture Output prepared texture
+	* @return true if cache file is valid and belongs to the same source file
+	*/
+	bool readCache(std::string path, uint64_t sourceSize, uint64_t sourceHash, textureData& texture);
+
+	/**
+	* @brief Writes texture into cache file
+	* @param path Path to source texture file
+	* @param sourceSize Size of source file
+	* @param sourceHash Hash of content of source file
+	* @param texture Prepared texture
+	*/
+	void writeCache(std::string path, uint64_t sourceSize, uint64_t sourceHash, textureData& texture);
+
+	/**
+	* @brief Hash of file content (FNV-1a)
+	* @param data Content of file
+	* @return 64-bit hash
+	*/
+	static uint64_t hash(const std::vector<unsigned char>& data);
+
+	/**
+	* @brief Builds mip chain and encodes all levels
+	* @param rgba Pixels of base level (RGBA8)
+	* @param width Width of base level
+	* @param height Height of base level
+	* @param texture Output prepared texture
+	*/
+	void prepare(const unsigned char* rgba, int width, int height, textureData& texture);
+
+	/**
+	* @brief Computes next mip level by box filter
+	* @param src Pixels of source level (RGBA8)
+	* @param width Width of source level
+	* @param height Height of source level
+	* @param dst Output pixels of next level
+	*/
+	void downsample(const unsigned char* src, int width, int height, std::vector<unsigned char>& dst);
+
+	/**
+	* @brief Encodes one mip level into BC1/BC3 blocks
+	* @param src Pixels of level (RGBA8)
+	* @param width Width of level
+	* @param height Height of level
+	* @param alpha true for BC3 (with alpha), false for BC1
+	* @param dst Output blocks
+	*/
+	void encodeLevel(const unsigned char* src, int width, int height, bool alpha, unsigned char* dst);
+
+	/**
+	* @brief Encodes colors of 4x4 block (BC1 block)
+	* @param block Pixels of block (16 x RGBA8)
+	* @param dst Output 8 bytes of block
+	*/
+	void encodeColorBlock(const unsigned char* block, unsigned char* dst);
+
+	/**
+	* @brief Encodes alpha of 4x4 block (BC4 block used in BC3)
+	* @param block Pixels of block (16 x RGBA8)
+	* @param dst Output 8 bytes of block
+	*/
+	void encodeAlphaBlock(const unsigned char* block, unsigned char* dst);
+
+	bool compression = true;
+	bool caching = true;
+
+};
@@ -0,0 +1,273 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TextureLoader.cpp
+*/
+
+#include <TextureLoader.h>
+
+#include <cstring>
+
+TextureLoader::~TextureLoader(){
+
+	clear();
+
+	for (int i = 0; i < TEXTURE_PBO_RING_SIZE; i++) {
+		if (fences[i] != 0)
+			ge::gl::glDeleteSync(fences[i]);
+	}
+
+	if (placeholderID != 0) {
+		ge::gl::glMakeTextureHandleNonResidentARB(placeholderHandle);
+		ge::gl::glDeleteTextures(1, &placeholderID);
+	}
+
+}
+
+void TextureLoader::init(){
+
+	// Placeholder texture - black texel, shader uses diffuse color of material instead
+	unsigned char texel[4] = { 0, 0, 0, 255 };
+
+	ge::gl::glGenTextures(1, &placeholderID);
+	ge::gl::glBindTexture(GL_TEXTURE_2D, placeholderID);
+	ge::gl::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	ge::gl::glBindTexture(GL_TEXTURE_2D, 0);
+
+	placeholderHandle = ge::gl::glGetTextureHandleARB(placeholderID);
+	ge::gl::glMakeTextureHandleResidentARB(placeholderHandle);
+
+	// Ring of pixel buffers for streaming
+	for (int i = 0; i < TEXTURE_PBO_RING_SIZE; i++)
+		pbo[i] = GPUMemory::createBuffer(AllocationCounter::TEXTURES, 1024 * 1024 * 4);
+
+}
+
+int TextureLoader::request(std::string path){
+
+	int slot;
+	int currentGeneration;
+
+	{
+		std::unique_lock<std::mutex> lock(loaderMutex);
+
+		// Texture is already requested
+		auto it = associatedSlots.find(path);
+		if (it != associatedSlots.end())
+			return it->second;
+
+		slot = static_cast<int>(slots.size());
+		slots.push_back({ path, 0, 0, false, 0 });
+		associatedSlots.insert(std::pair<std::string, int>(path, slot));
+
+		currentGeneration = generation;
+		pending++;
+	}
+
+	pool.submit([this, slot, currentGeneration, path]() { decode(slot, currentGeneration, path); });
+
+	return slot;
+}
+
+bool TextureLoader::update(){
+
+	bool changed = false;
+
+	for (int i = 0; i < TEXTURE_UPLOADS_PER_UPDATE; i++) {
+
+		decodedImage image;
+
+		{
+			std::unique_lock<std::mutex> lock(loaderMutex);
+
+			if (decoded.empty())
+				break;
+
+			image = decoded.front();
+
+			// Failed or outdated image
+			if (image.texture == nullptr || image.generation != generation) {
+				decoded.pop_front();
+				continue;
+			}
+		}
+
+		// All pixel buffers are still in use - try it again in next update
+		if (!upload(image))
+			break;
+
+		{
+			std::unique_lock<std::mutex> lock(loaderMutex);
+			decoded.pop_front();
+		}
+
+		changed = true;
+	}
+
+	return changed;
+}
+
+GLuint64 TextureLoader::getHandle(int slot){
+
+	std::unique_lock<std::mutex> lock(loaderMutex);
+
+	if (slot < 0 || slot >= static_cast<int>(slots.size()) || !slots[slot].resident)
+		return placeholderHandle;
+
+	return slots[slot].handle;
+}
+
+TextureCache & TextureLoader::getCache(){
+	return cache;
+}
+
+GLuint64 TextureLoader::getPlaceholder(){
+	return placeholderHandle;
+}
+
+bool TextureLoader::isIdle(){
+
+	std::unique_lock<std::mutex> lock(loaderMutex);
+	return pending == 0 && decoded.empty();
+}
+
+void TextureLoader::clear(){
+
+	std::unique_lock<std::mutex> lock(loaderMutex);
+
+	for (auto& s : slots) {
+		if (s.resident) {
+			ge::gl::glMakeTextureHandleNonResidentARB(s.handle);
+			ge::gl::glDeleteTextures(1, &s.id);
+			AllocationCounter::addGpuBytes(AllocationCounter::TEXTURES, -static_cast<std::ptrdiff_t>(s.size));
+		}
+	}
+
+	slots.clear();
+	associatedSlots.clear();
+	decoded.clear();
+
+	// Waiting decodes of previous scene are cancelled, images of running decodes are dropped when they finish
+	pending -= static_cast<int>(pool.cancel());
+	generation++;
+
+}
+
+void TextureLoader::decode(int slot, int requestGeneration, std::string path){
+
+	// Decoded images are accounted to textures until they are uploaded
+	AllocationCounter::tag memoryTag(AllocationCounter::TEXTURES);
+
+	// Texture of previous scene (task was taken from queue before clear)
+	{
+		std::unique_lock<std::mutex> lock(loaderMutex);
+
+		if (requestGeneration != generation) {
+			pending--;
+			return;
+		}
+	}
+
+	decodedImage image;
+	image.slot = slot;
+	image.generation = requestGeneration;
+	image.texture = std::make_shared<TextureCache::textureData>();
+
+	if (!cache.load(path, *image.texture)) {
+		std::cout << "Texture " << path << " loading failed" << std::endl;
+		image.texture.reset();
+	}
+
+#ifdef TEXTURES_PRINT
+	else
+		std::cout << "Loaded " << path.c_str() << std::endl;
+#endif
+
+	std::unique_lock<std::mutex> lock(loaderMutex);
+	pending--;
+
+	// Scene was cleared during decoding - image is released immediately
+	if (requestGeneration != generation)
+		return;
+
+	decoded.push_back(image);
+
+}
+
+bool TextureLoader::upload(decodedImage& image){
+
+	// Pixel buffer is free after GPU finished previous transfer from it
+	GLsync& fence = fences[activePbo];
+
+	if (fence != 0) {
+		if (ge::gl::glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			return false;
+
+		ge::gl::glDeleteSync(fence);
+		fence = 0;
+	}
+
+	TextureCache::textureData& texture = *image.texture;
+	GLsizeiptr size = static_cast<GLsizeiptr>(texture.data.size());
+	auto& buffer = pbo[activePbo];
+
+	if (buffer->getSize() < size)
+		GPUMemory::resizeBuffer(AllocationCounter::TEXTURES, buffer, size);
+
+	// Copy all mip levels into pixel buffer
+	void* ptr = buffer->map(0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	std::memcpy(ptr, texture.data.data(), size);
+	buffer->unmap();
+
+	GLuint textureID;
+
+	// Setup texture, transfer of prebuilt mip levels from pixel buffer
+	ge::gl::glGenTextures(1, &textureID);
+	ge::gl::glBindTexture(GL_TEXTURE_2D, textureID);
+	ge::gl::glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(texture.levels.size()), texture.format, texture.levels[0].width, texture.levels[0].height);
+
+	buffer->bind(GL_PIXEL_UNPACK_BUFFER);
+
+	for (size_t i = 0; i < texture.levels.size(); i++) {
+
+		auto& level = texture.levels[i];
+		void* offset = reinterpret_cast<void*>(level.offset);
+
+		if (texture.compressed)
+			ge::gl::glCompressedTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), 0, 0, level.width, level.height, texture.format, static_cast<GLsizei>(level.size), offset);
+		else
+			ge::gl::glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+	}
+
+	buffer->unbind(GL_PIXEL_UNPACK_BUFFER);
+
+	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	ge::gl::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	ge::gl::glBindTexture(GL_TEXTURE_2D, 0);
+
+	fence = ge::gl::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	activePbo = (activePbo + 1) % TEXTURE_PBO_RING_SIZE;
+
+	// Bindless texture
+	GLuint64 handle = ge::gl::glGetTextureHandleARB(textureID);
+	ge::gl::glMakeTextureHandleResidentARB(handle);
+
+	std::unique_lock<std::mutex> lock(loaderMutex);
+	slots[image.slot].id = textureID;
+	slots[image.slot].handle = handle;
+	slots[image.slot].resident = true;
+	slots[image.slot].size = static_cast<size_t>(size);
+
+	AllocationCounter::addGpuBytes(AllocationCounter::TEXTURES, size);
+
+	return true;
+}
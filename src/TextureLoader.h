@@ -0,0 +1,163 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TextureLoader.h
+*/
+
+#pragma once
+
+#include <ThreadPool.h>
+#include <TextureCache.h>
+#include <GPUMemory.h>
+
+#include <geGL/geGL.h>
+#include <geGL/StaticCalls.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Number of pixel buffers used for streaming of texture uploads
+#define TEXTURE_PBO_RING_SIZE 4
+
+// Maximum number of textures uploaded on GPU during one update call
+#define TEXTURE_UPLOADS_PER_UPDATE 4
+
+/**
+* @brief Asynchronous texture loader - prepares textures (cache or decode + mip chain) in thread pool and streams them on GPU
+* @note All functions except request() must be called from thread with GL context
+*/
+class TextureLoader {
+
+public:
+
+	/**
+	* @brief Constructor
+	* @param threads Number of decoding threads (0 = number of hardware threads)
+	*/
+	TextureLoader(unsigned threads = 0) : pool(threads) {}
+
+	/**
+	* @brief Destructor, releases all textures and cancels waiting decodes (only running decodes are finished)
+	*/
+	~TextureLoader();
+
+	/**
+	* @brief Initialization of GPU objects (placeholder texture, PBO ring)
+	*/
+	void init();
+
+	/**
+	* @brief Requests texture from file, decoding starts immediately in background
+	* @param path Path to file with texture
+	* @return Slot of texture (same path gives same slot)
+	*/
+	int request(std::string path);
+
+	/**
+	* @brief Uploads decoded textures on GPU
+	* @return true if some texture became resident (handles have changed)
+	*/
+	bool update();
+
+	/**
+	* @brief Getter for bindless handle of texture
+	* @param slot Slot of texture
+	* @return Handle of texture, placeholder handle if texture is not resident yet
+	*/
+	GLuint64 getHandle(int slot);
+
+	/**
+	* @brief Getter for bindless handle of placeholder texture
+	* @return Handle of placeholder texture
+	*/
+	GLuint64 getPlaceholder();
+
+	/**
+	* @brief Checks, if all requested textures are processed
+	* @return true if there is nothing to decode or upload
+	*/
+	bool isIdle();
+
+	/**
+	* @brief Releases all loaded textures, cancels waiting decodes and drops images of running decodes
+	*/
+	void clear();
+
+	/**
+	* @brief Getter for texture cache (settings of compression and caching)
+	* @return Reference to texture cache
+	*/
+	TextureCache& getCache();
+
+private:
+
+	/**
+	* @brief Structure of prepared texture waiting for upload
+	*/
+	typedef struct {
+		int slot;
+		int generation;
+		std::shared_ptr<TextureCache::textureData> texture;
+	} decodedImage;
+
+	/**
+	* @brief Structure of texture slot
+	*/
+	typedef struct {
+		std::string path;
+		GLuint id;
+		GLuint64 handle;
+		bool resident;
+		size_t size;		// Size of all mip levels on GPU
+	} textureSlot;
+
+	/**
+	* @brief Prepares texture with all mip levels (runs in worker thread)
+	* @param slot Slot of texture
+	* @param requestGeneration Generation of slots, in which was texture requested
+	* @param path Path to file with texture
+	*/
+	void decode(int slot, int requestGeneration, std::string path);
+
+	/**
+	* @brief Uploads one decoded image through PBO ring
+	* @param image Decoded image
+	* @return false if there is no free pixel buffer
+	*/
+	bool upload(decodedImage& image);
+
+	// Texture slots (deduplicated by path)
+	std::vector<textureSlot> slots;
+	std::map<std::string, int> associatedSlots;
+
+	// Mip chains and compression of textures
+	TextureCache cache;
+
+	// Decoded images waiting for upload
+	std::deque<decodedImage> decoded;
+	std::mutex loaderMutex;
+	int pending = 0;
+	int generation = 0;
+
+	// Pixel buffer ring for streaming
+	std::shared_ptr<ge::gl::Buffer> pbo[TEXTURE_PBO_RING_SIZE];
+	GLsync fences[TEXTURE_PBO_RING_SIZE] = {};
+	int activePbo = 0;
+
+	// Placeholder used until texture is resident
+	GLuint placeholderID = 0;
+	GLuint64 placeholderHandle = 0;
+
+	// Decoding threads (declared last - workers have to finish before other members are destroyed)
+	ThreadPool pool;
+
+};
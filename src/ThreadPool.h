@@ -0,0 +1,139 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* ThreadPool.h
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <type_traits>
+
+/**
+* @brief Simple pool of worker threads executing queued tasks
+*/
+class ThreadPool {
+
+public:
+
+	/**
+	* @brief Constructor, starts worker threads
+	* @param threads Number of workers (0 = number of hardware threads)
+	*/
+	ThreadPool(unsigned threads = 0) {
+
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned i = 0; i < threads; i++)
+			workers.emplace_back([this]() { workerLoop(); });
+	}
+
+	/**
+	* @brief Destructor, finishes queued tasks and joins workers
+	*/
+	~ThreadPool() {
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			stop = true;
+		}
+
+		condition.notify_all();
+
+		for (auto& w : workers)
+			w.join();
+	}
+
+	/**
+	* @brief Inserts new task into queue
+	* @param task Callable object without parameters
+	* @return Future with result of task
+	*/
+	template <typename Task> std::future<typename std::result_of<Task()>::type> submit(Task task) {
+
+		using Result = typename std::result_of<Task()>::type;
+
+		auto packed = std::make_shared<std::packaged_task<Result()>>(task);
+		std::future<Result> result = packed->get_future();
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			tasks.push([packed]() { (*packed)(); });
+		}
+
+		condition.notify_one();
+		return result;
+	}
+
+	/**
+	* @brief Removes all waiting tasks from queue, running tasks are finished (futures of removed tasks get broken promise)
+	* @return Number of removed tasks
+	*/
+	size_t cancel() {
+
+		std::unique_lock<std::mutex> lock(queueMutex);
+
+		size_t removed = tasks.size();
+		std::queue<std::function<void()>>().swap(tasks);
+
+		return removed;
+	}
+
+	/**
+	* @brief Getter for number of worker threads
+	* @return Number of workers
+	*/
+	unsigned size() {
+		return static_cast<unsigned>(workers.size());
+	}
+
+private:
+
+	/**
+	* @brief Main loop of worker thread
+	*/
+	void workerLoop() {
+
+		while (true) {
+
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				condition.wait(lock, [this]() { return stop || !tasks.empty(); });
+
+				if (stop && tasks.empty())
+					return;
+
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+
+			task();
+		}
+
+	}
+
+	// Workers and queue of waiting tasks
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+
+	// Synchronization
+	std::mutex queueMutex;
+	std::condition_variable condition;
+	bool stop = false;
+
+};
@@ -0,0 +1,347 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TraceBenchmark.cpp
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+
+#include <BVH.h>
+#include <AABB_SAH_BVH.h>
+#include <PLOC_BVH.h>
+#include <GeometryView.h>
+#include <bvhPreprocessor.h>
+#include <CPUTracer.h>
+#include <SceneGenerator.h>
+#include <Benchmark.h>
+
+// Default parameters of benchmark (sizes of procedural scenes, resolution, secondary rays per primary hit)
+#define BENCHMARK_SIZES "10000,100000,1000000"
+#define BENCHMARK_WIDTH 512
+#define BENCHMARK_HEIGHT 512
+#define BENCHMARK_SAMPLES 4
+#define BENCHMARK_LAYOUTS "dfs,bfs,veb,frequency"
+#define BENCHMARK_TRAVERSALS "stack,stackless"
+#define BENCHMARK_INTERSECTIONS "moller,watertight,simd"
+
+// Points on every edge of closed sphere hit by rays of leak check
+#define BENCHMARK_EDGE_POINTS 3
+
+// Resolution of sampling pass of access frequency layout is divided by this factor
+#define BENCHMARK_SAMPLING_SCALE 4
+
+/**
+* @brief Builds BVH, traces all ray types over every node layout, traversal and ray-triangle test and writes one row per configuration and ray type
+* @param scene Benchmarked scene
+* @param builder Name of builder in results
+* @param tracer Tracer
+* @param layouts Benchmarked layouts of nodes
+* @param traversals Benchmarked traversals (stack, stackless)
+* @param intersections Benchmarked ray-triangle tests
+* @param width, height Resolution of primary rays
+* @param samples Number of secondary rays of every type per primary hit
+* @param output Output CSV stream
+*/
+template<typename BuildPolicy>
+void runBuilder(const benchmarkScene& scene, std::string builder, CPUTracer& tracer, const std::vector<bvhPreprocessor::layout>& layouts, const std::vector<std::string>& traversals, const std::vector<CPUTracer::intersection>& intersections, unsigned width, unsigned height, unsigned samples, std::ostream& output){
+
+	size_t triangles = scene.indices.size() / 3;
+	std::cerr << builder << " " << scene.name << " " << triangles << std::endl;
+
+	auto bvh = std::make_shared<ge::sg::BVH<BuildPolicy>>();
+	bvh->setGeometryData(ge::sg::GeometryView(scene.positions.data(), scene.positions.size() / 3, scene.indices.data(), scene.indices.size()));
+
+	// Same parameters as builds of application
+	if (std::is_same<BuildPolicy, ge::sg::AABB_SAH_BVH>::value) {
+		bvh->setDepth(35);
+		bvh->setMinimumPrimitivesInNode(25);
+	}
+	else
+		bvh->setMinimumPrimitivesInNode(4);
+
+	bvh->buildBVH();
+
+	// Flattened as for GPU, leaves index triangles in order of primitive indices
+	auto root = bvh->getRoot();
+	bvhPreprocessor bp;
+	bp.transformBVH(root.get(), root->first);
+
+	std::vector<unsigned> indices = bvh->getPrimitiveIndices();
+	std::vector<unsigned> order(indices.size() / 3);
+	std::iota(order.begin(), order.end(), 0u);
+
+	ge::sg::GeometryView geometry(scene.positions.data(), scene.positions.size() / 3, indices.data(), indices.size());
+	tracer.setScene(*bp.getTree(), geometry, order, false);
+
+	// Camera in front of scene, light above its center
+	glm::vec3 center = 0.5f * (tracer.getMin() + tracer.getMax());
+	float extent = glm::length(tracer.getMax() - tracer.getMin());
+	glm::vec3 eye = center + 0.7f * extent * glm::normalize(glm::vec3(0.3f, 0.3f, 1.0f));
+	glm::vec3 light = center + glm::vec3(0.0f, 0.4f * extent, 0.0f);
+
+	// Sampling pass over depth first nodes with reduced resolution
+	tracer.setStackless(false);
+	unsigned sampleWidth = std::max(1u, width / BENCHMARK_SAMPLING_SCALE), sampleHeight = std::max(1u, height / BENCHMARK_SAMPLING_SCALE);
+	bp.setAccessFrequencies(tracer.sampleAccesses(eye, center, light, sampleWidth, sampleHeight, 1));
+
+	for (bvhPreprocessor::layout l : layouts) {
+
+		bp.setLayout(l);
+		bp.transformBVH(root.get(), root->first);
+		tracer.setScene(*bp.getTree(), geometry, order, false);
+
+		for (auto& traversal : traversals) {
+
+			tracer.setStackless(traversal == "stackless");
+
+			for (CPUTracer::intersection test : intersections) {
+
+				tracer.setIntersection(test);
+
+				// Throughput is measured without instrumentation, misses in the second run
+				std::vector<CPUTracer::rayStats> results = tracer.run(eye, center, light, width, height, samples);
+
+				tracer.setCacheSimulation(true);
+				std::vector<CPUTracer::rayStats> simulated = tracer.run(eye, center, light, width, height, samples);
+				tracer.setCacheSimulation(false);
+
+				for (size_t i = 0; i < results.size(); i++) {
+
+					const CPUTracer::rayStats& r = results[i];
+					double rays = std::max(static_cast<double>(r.rays), 1.0);
+
+					output << builder << "," << bvhPreprocessor::getLayoutName(l) << "," << traversal << "," << CPUTracer::getIntersectionName(test) << "," << scene.name << "," << triangles << "," << r.type << "," << r.rays << ","
+						   << r.time << "," << (r.time > 0.0 ? r.rays / (r.time * 1000.0) : 0.0) << ","
+						   << r.counters.nodes / rays << "," << r.counters.triangles / rays << "," << r.counters.stack / rays << ","
+						   << r.counters.maxStack << "," << r.hits / rays << ","
+						   << simulated[i].counters.cacheMisses / rays << "," << simulated[i].counters.tlbMisses / rays << std::endl;
+				}
+			}
+		}
+	}
+
+}
+
+/**
+* @brief Runs builders over scene
+*/
+void runScene(const benchmarkScene& scene, CPUTracer& tracer, const std::vector<bvhPreprocessor::layout>& layouts, const std::vector<std::string>& traversals, const std::vector<CPUTracer::intersection>& intersections, unsigned width, unsigned height, unsigned samples, std::ostream& output){
+
+	runBuilder<ge::sg::AABB_SAH_BVH>(scene, "AABB_SAH_BVH", tracer, layouts, traversals, intersections, width, height, samples, output);
+	runBuilder<ge::sg::PLOC_BVH>(scene, "PLOC_BVH", tracer, layouts, traversals, intersections, width, height, samples, output);
+
+}
+
+/**
+* @brief Leak check of ray-triangle tests - rays from the center of closed sphere through its vertices and points on its edges must hit it
+* @param triangles Number of triangles of sphere
+* @param tracer Tracer
+* @param intersections Checked ray-triangle tests
+* @param output Output CSV stream
+* @return Number of leaked rays of watertight tests (Moller-Trumbore test is not watertight)
+*/
+size_t leakCheck(size_t triangles, CPUTracer& tracer, const std::vector<CPUTracer::intersection>& intersections, std::ostream& output){
+
+	// Grid with one object is unit sphere in origin
+	benchmarkScene scene;
+	collectGeometry(*SceneGenerator::generate(SceneGenerator::INSTANCED_GRID, std::min(triangles, static_cast<size_t>(SCENE_GENERATOR_OBJECT_TRIANGLES))), "grid", scene);
+
+	auto bvh = std::make_shared<ge::sg::BVH<ge::sg::AABB_SAH_BVH>>();
+	bvh->setGeometryData(ge::sg::GeometryView(scene.positions.data(), scene.positions.size() / 3, scene.indices.data(), scene.indices.size()));
+	bvh->setDepth(35);
+	bvh->setMinimumPrimitivesInNode(25);
+	bvh->buildBVH();
+
+	auto root = bvh->getRoot();
+	bvhPreprocessor bp;
+	bp.transformBVH(root.get(), root->first);
+
+	std::vector<unsigned> indices = bvh->getPrimitiveIndices();
+	std::vector<unsigned> order(indices.size() / 3);
+	std::iota(order.begin(), order.end(), 0u);
+
+	ge::sg::GeometryView geometry(scene.positions.data(), scene.positions.size() / 3, indices.data(), indices.size());
+	tracer.setScene(*bp.getTree(), geometry, order, false);
+
+	// Directions through vertices and edges of all triangles
+	std::vector<glm::vec3> vertexRays, edgeRays;
+
+	for (size_t t = 0; t < order.size(); t++) {
+		for (unsigned c = 0; c < 3; c++) {
+
+			const float* a = geometry.vertex(t, c);
+			const float* b = geometry.vertex(t, (c + 1) % 3);
+			glm::vec3 pa(a[0], a[1], a[2]), pb(b[0], b[1], b[2]);
+
+			vertexRays.push_back(glm::normalize(pa));
+
+			for (unsigned p = 1; p <= BENCHMARK_EDGE_POINTS; p++)
+				edgeRays.push_back(glm::normalize(pa + (pb - pa) * (static_cast<float>(p) / (BENCHMARK_EDGE_POINTS + 1))));
+		}
+	}
+
+	size_t leaks = 0;
+
+	for (CPUTracer::intersection test : intersections) {
+
+		tracer.setIntersection(test);
+
+		auto count = [&tracer](const std::vector<glm::vec3>& directions) {
+			size_t missed = 0;
+			CPUTracer::traversal counters = {};
+
+			for (const glm::vec3& d : directions) {
+				CPUTracer::hit h;
+
+				if (!tracer.intersect({ glm::vec3(0.0f), d, std::numeric_limits<float>::max() }, h, counters))
+					missed++;
+			}
+
+			return missed;
+		};
+
+		size_t vertexLeaks = count(vertexRays), edgeLeaks = count(edgeRays);
+
+		if (test != CPUTracer::MOLLER_TRUMBORE)
+			leaks += vertexLeaks + edgeLeaks;
+
+		output << CPUTracer::getIntersectionName(test) << "," << order.size() << "," << vertexRays.size() << "," << vertexLeaks << "," << edgeRays.size() << "," << edgeLeaks << std::endl;
+	}
+
+	return leaks;
+}
+
+/**
+* @brief Benchmark of ray tracing on CPU (primary, shadow, ambient occlusion and diffuse rays) with traversal statistics
+* TraceBenchmark [--generate uniform,spheres] [--sizes 10000,100000] [--layouts dfs,bfs,veb,frequency] [--traversals stack,stackless] [--intersections moller,watertight,simd] [--width 512] [--height 512] [--samples 4] [--threads 0] [--scene file]... [--output results.csv]
+* TraceBenchmark --leaks 8192 [--intersections moller,watertight,simd] - leak check of ray-triangle tests on edges and vertices (fails if watertight test leaks)
+*/
+int main(int argc, char** argv){
+
+	std::vector<std::string> distributions = parseNames(BENCHMARK_DISTRIBUTIONS);
+	std::vector<unsigned> sizes = parseList(BENCHMARK_SIZES);
+	std::vector<std::string> layoutNames = parseNames(BENCHMARK_LAYOUTS);
+	std::vector<std::string> traversals = parseNames(BENCHMARK_TRAVERSALS);
+	std::vector<std::string> intersectionNames = parseNames(BENCHMARK_INTERSECTIONS);
+	std::vector<std::string> files;
+	std::string outputFile;
+	unsigned width = BENCHMARK_WIDTH, height = BENCHMARK_HEIGHT, samples = BENCHMARK_SAMPLES, threads = 0;
+	size_t leakTriangles = 0;
+
+	for (int i = 1; i + 1 < argc; i++) {
+		std::string arg = argv[i];
+
+		if (arg == "--generate")
+			distributions = parseNames(argv[++i]);
+		else if (arg == "--sizes")
+			sizes = parseList(argv[++i]);
+		else if (arg == "--layouts")
+			layoutNames = parseNames(argv[++i]);
+		else if (arg == "--traversals")
+			traversals = parseNames(argv[++i]);
+		else if (arg == "--intersections")
+			intersectionNames = parseNames(argv[++i]);
+		else if (arg == "--leaks")
+			leakTriangles = static_cast<size_t>(std::stoull(argv[++i]));
+		else if (arg == "--width")
+			width = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+		else if (arg == "--height")
+			height = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+		else if (arg == "--samples")
+			samples = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+		else if (arg == "--threads")
+			threads = static_cast<unsigned>(std::stoul(argv[++i]));
+		else if (arg == "--scene")
+			files.push_back(argv[++i]);
+		else if (arg == "--output")
+			outputFile = argv[++i];
+	}
+
+	std::ofstream file;
+
+	if (!outputFile.empty()) {
+		file.open(outputFile);
+
+		if (!file.is_open()) {
+			std::cout << "Output file " << outputFile << " could not be created" << std::endl;
+			return BENCHMARK_FAIL;
+		}
+	}
+
+	std::ostream& output = outputFile.empty() ? std::cout : file;
+
+	std::vector<bvhPreprocessor::layout> layouts;
+
+	for (auto& name : layoutNames) {
+
+		bvhPreprocessor::layout l;
+
+		if (bvhPreprocessor::parseLayout(name, l))
+			layouts.push_back(l);
+		else
+			std::cout << "Unknown layout " << name << std::endl;
+	}
+
+	std::vector<CPUTracer::intersection> intersections;
+
+	for (auto& name : intersectionNames) {
+
+		CPUTracer::intersection test;
+
+		if (CPUTracer::parseIntersection(name, test))
+			intersections.push_back(test);
+		else
+			std::cout << "Unknown intersection " << name << std::endl;
+	}
+
+	CPUTracer tracer(threads);
+
+	if (leakTriangles > 0) {
+
+		output << "intersection,triangles,vertex_rays,vertex_leaks,edge_rays,edge_leaks" << std::endl;
+		return leakCheck(leakTriangles, tracer, intersections, output) == 0 ? BENCHMARK_SUCCESS : BENCHMARK_FAIL;
+	}
+
+	output << "builder,layout,traversal,intersection,scene,triangles,ray_type,rays,time_ms,mrays_per_s,avg_nodes,avg_triangles,avg_stack,max_stack,hit_rate,cache_misses,tlb_misses" << std::endl;
+
+	benchmarkScene scene;
+
+	for (auto& name : distributions) {
+
+		SceneGenerator::distribution d;
+
+		if (!SceneGenerator::parseDistribution(name, d)) {
+			std::cout << "Unknown distribution " << name << std::endl;
+			continue;
+		}
+
+		for (unsigned size : sizes) {
+			collectGeometry(*SceneGenerator::generate(d, size), name, scene);
+			runScene(scene, tracer, layouts, traversals, intersections, width, height, samples, output);
+		}
+	}
+
+	for (auto& f : files) {
+
+		if (!loadScene(f, scene)) {
+			std::cout << "Scene " << f << " could not be loaded" << std::endl;
+			continue;
+		}
+
+		runScene(scene, tracer, layouts, traversals, intersections, width, height, samples, output);
+	}
+
+	return BENCHMARK_SUCCESS;
+}
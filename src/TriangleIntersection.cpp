@@ -0,0 +1,200 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TriangleIntersection.cpp
+*/
+
+#include <TriangleIntersection.h>
+
+#include <cmath>
+#include <utility>
+
+#ifdef TRIANGLE_INTERSECTION_SSE
+#include <emmintrin.h>
+#endif
+
+TriangleIntersection::ray TriangleIntersection::setup(glm::vec3 origin, glm::vec3 direction){
+
+	ray r;
+	r.origin = origin;
+
+	glm::vec3 d = glm::abs(direction);
+	r.kz = d.x > d.y ? (d.x > d.z ? 0 : 2) : (d.y > d.z ? 1 : 2);
+	r.kx = (r.kz + 1) % 3;
+	r.ky = (r.kx + 1) % 3;
+
+	// Winding of triangles is preserved by swap (sign of edge functions)
+	if (direction[r.kz] < 0.0f)
+		std::swap(r.kx, r.ky);
+
+	r.sx = direction[r.kx] / direction[r.kz];
+	r.sy = direction[r.ky] / direction[r.kz];
+	r.sz = 1.0f / direction[r.kz];
+
+	return r;
+}
+
+bool TriangleIntersection::intersect(const ray & r, const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c, float tmax, float & t, float & u, float & v){
+
+	glm::vec3 A = a - r.origin;
+	glm::vec3 B = b - r.origin;
+	glm::vec3 C = c - r.origin;
+
+	// Vertices in space of ray (ray goes along z axis from origin)
+	float ax = A[r.kx] - r.sx * A[r.kz];
+	float ay = A[r.ky] - r.sy * A[r.kz];
+	float bx = B[r.kx] - r.sx * B[r.kz];
+	float by = B[r.ky] - r.sy * B[r.kz];
+	float cx = C[r.kx] - r.sx * C[r.kz];
+	float cy = C[r.ky] - r.sy * C[r.kz];
+
+	// Edge functions, shared edge of two triangles gives the same value with opposite sign
+	float eu = cx * by - cy * bx;
+	float ev = ax * cy - ay * cx;
+	float ew = bx * ay - by * ax;
+
+	// Ray through edge or vertex - sign is decided in double precision
+	if (eu == 0.0f || ev == 0.0f || ew == 0.0f) {
+		eu = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+		ev = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+		ew = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+	}
+
+	if ((eu < 0.0f || ev < 0.0f || ew < 0.0f) && (eu > 0.0f || ev > 0.0f || ew > 0.0f))
+		return false;
+
+	float det = eu + ev + ew;
+
+	if (det == 0.0f)
+		return false;
+
+	float az = r.sz * A[r.kz];
+	float bz = r.sz * B[r.kz];
+	float cz = r.sz * C[r.kz];
+	float T = eu * az + ev * bz + ew * cz;
+
+	// Distance in range (0, tmax) scaled by determinant (both sides of triangle), the same comparison as trace shader
+	if (det > 0.0f ? (T <= 0.0f || T >= tmax * det) : (T >= 0.0f || T <= tmax * det))
+		return false;
+
+	float invdet = 1.0f / det;
+	t = T * invdet;
+	u = eu * invdet;
+	v = ev * invdet;
+
+	return true;
+}
+
+void TriangleIntersection::intersect4(const ray & r, const triangle4 & triangles, int lanes, float tmax, hit4 & result){
+
+	int exact = 0;
+
+#ifdef TRIANGLE_INTERSECTION_SSE
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 sx = _mm_set1_ps(r.sx), sy = _mm_set1_ps(r.sy), sz = _mm_set1_ps(r.sz);
+	const __m128 ox = _mm_set1_ps(r.origin[r.kx]), oy = _mm_set1_ps(r.origin[r.ky]), oz = _mm_set1_ps(r.origin[r.kz]);
+
+	// The same operations as scalar test, lanes give identical results
+	__m128 x[3], y[3], z[3];
+
+	for (int i = 0; i < 3; i++) {
+		__m128 px = _mm_sub_ps(_mm_loadu_ps(triangles.v[i][r.kx]), ox);
+		__m128 py = _mm_sub_ps(_mm_loadu_ps(triangles.v[i][r.ky]), oy);
+		__m128 pz = _mm_sub_ps(_mm_loadu_ps(triangles.v[i][r.kz]), oz);
+
+		x[i] = _mm_sub_ps(px, _mm_mul_ps(sx, pz));
+		y[i] = _mm_sub_ps(py, _mm_mul_ps(sy, pz));
+		z[i] = _mm_mul_ps(sz, pz);
+	}
+
+	__m128 eu = _mm_sub_ps(_mm_mul_ps(x[2], y[1]), _mm_mul_ps(y[2], x[1]));
+	__m128 ev = _mm_sub_ps(_mm_mul_ps(x[0], y[2]), _mm_mul_ps(y[0], x[2]));
+	__m128 ew = _mm_sub_ps(_mm_mul_ps(x[1], y[0]), _mm_mul_ps(y[1], x[0]));
+
+	// Lanes with ray through edge or vertex are tested by scalar test in double precision
+	exact = (_mm_movemask_ps(_mm_cmpeq_ps(eu, zero)) | _mm_movemask_ps(_mm_cmpeq_ps(ev, zero)) | _mm_movemask_ps(_mm_cmpeq_ps(ew, zero))) & lanes;
+
+	__m128 negative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(eu, zero), _mm_cmplt_ps(ev, zero)), _mm_cmplt_ps(ew, zero));
+	__m128 positive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(eu, zero), _mm_cmpgt_ps(ev, zero)), _mm_cmpgt_ps(ew, zero));
+
+	__m128 det = _mm_add_ps(_mm_add_ps(eu, ev), ew);
+	__m128 T = _mm_add_ps(_mm_add_ps(_mm_mul_ps(eu, z[0]), _mm_mul_ps(ev, z[1])), _mm_mul_ps(ew, z[2]));
+	__m128 limit = _mm_mul_ps(_mm_set1_ps(tmax), det);
+
+	__m128 front = _mm_and_ps(_mm_cmpgt_ps(det, zero), _mm_and_ps(_mm_cmpgt_ps(T, zero), _mm_cmplt_ps(T, limit)));
+	__m128 back = _mm_and_ps(_mm_cmplt_ps(det, zero), _mm_and_ps(_mm_cmplt_ps(T, zero), _mm_cmpgt_ps(T, limit)));
+	__m128 valid = _mm_andnot_ps(_mm_and_ps(negative, positive), _mm_or_ps(front, back));
+
+	result.mask = _mm_movemask_ps(valid) & lanes & ~exact;
+
+	__m128 invdet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	_mm_storeu_ps(result.t, _mm_mul_ps(T, invdet));
+	_mm_storeu_ps(result.u, _mm_mul_ps(eu, invdet));
+	_mm_storeu_ps(result.v, _mm_mul_ps(ev, invdet));
+
+#else
+
+	result.mask = 0;
+	exact = lanes;
+
+#endif
+
+	for (int lane = 0; lane < 4; lane++) {
+
+		if (!(exact >> lane & 1))
+			continue;
+
+		glm::vec3 v[3];
+
+		for (int i = 0; i < 3; i++)
+			v[i] = glm::vec3(triangles.v[i][0][lane], triangles.v[i][1][lane], triangles.v[i][2][lane]);
+
+		if (intersect(r, v[0], v[1], v[2], tmax, result.t[lane], result.u[lane], result.v[lane]))
+			result.mask |= 1 << lane;
+	}
+
+}
+
+float TriangleIntersection::mollerTrumbore(glm::vec3 origin, glm::vec3 direction, const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c){
+
+	glm::vec3 e1 = b - a;
+	glm::vec3 e2 = c - a;
+	glm::vec3 s1 = glm::cross(direction, e2);
+
+	float div = glm::dot(s1, e1);
+
+	if (std::abs(div) < 1e-12f)
+		return -1.0f;
+
+	float invdiv = 1.0f / div;
+	glm::vec3 dis = origin - a;
+
+	float u = glm::dot(dis, s1) * invdiv;
+
+	if (u < 0.0f || u > 1.0f)
+		return -1.0f;
+
+	glm::vec3 qv = glm::cross(dis, e1);
+	float w = glm::dot(direction, qv) * invdiv;
+
+	if (w < 0.0f || u + w > 1.0f)
+		return -1.0f;
+
+	return glm::dot(e2, qv) * invdiv;
+}
+
+void TriangleIntersection::store(triangle4 & triangles, int lane, const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c){
+
+	const glm::vec3* v[3] = { &a, &b, &c };
+
+	for (int i = 0; i < 3; i++) {
+		for (int axis = 0; axis < 3; axis++)
+			triangles.v[i][axis][lane] = (*v[i])[axis];
+	}
+
+}
@@ -0,0 +1,96 @@
+/*
+* RayTracing pro GPUEngine
+* Diplomova prace - master's thesis
+* Bc. David Novk
+* FIT VUT Brno
+* 2018/2019
+*
+* TriangleIntersection.h
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+// SSE version of test of four triangles (scalar loop otherwise)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRIANGLE_INTERSECTION_SSE
+#endif
+
+/**
+* @brief Watertight ray-triangle intersection (Woop, Benthin, Wald 2013) - scalar, four triangles at once and reference Moller-Trumbore test
+* @note Triangles are tested from both sides, edges and vertices shared by triangles never let ray through (the same test as trace.cs)
+*/
+class TriangleIntersection {
+
+public:
+
+	/**
+	* @brief Ray precomputed for watertight test - permutation of axes and shear, which moves ray direction to z axis
+	*/
+	typedef struct {
+		glm::vec3 origin;
+		int kx, ky, kz;		// Permuted axes, kz is the largest component of direction
+		float sx, sy, sz;	// Shear constants
+	} ray;
+
+	/**
+	* @brief Four triangles in structure of arrays (vertex, axis, lane)
+	*/
+	typedef struct {
+		alignas(16) float v[3][3][4];
+	} triangle4;
+
+	/**
+	* @brief Result of test of four triangles
+	*/
+	typedef struct {
+		alignas(16) float t[4];
+		alignas(16) float u[4];		// Barycentric coordinate of the first vertex
+		alignas(16) float v[4];		// Barycentric coordinate of the second vertex
+		int mask;					// Bit of every lane with hit
+	} hit4;
+
+	/**
+	* @brief Precomputation of ray (once per ray, reused by all its tests)
+	* @param origin Origin of ray
+	* @param direction Direction of ray (non zero)
+	* @return Precomputed ray
+	*/
+	static ray setup(glm::vec3 origin, glm::vec3 direction);
+
+	/**
+	* @brief Watertight test of one triangle
+	* @param r Precomputed ray
+	* @param a, b, c Vertices of triangle
+	* @param tmax Maximal distance of hit
+	* @param t Output distance of hit
+	* @param u, v Output barycentric coordinates of the first and second vertex
+	* @return true if ray hits triangle in distance (0, tmax)
+	*/
+	static bool intersect(const ray& r, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float tmax, float& t, float& u, float& v);
+
+	/**
+	* @brief Watertight test of four triangles
+	* @param r Precomputed ray
+	* @param triangles Tested triangles
+	* @param lanes Mask of valid lanes
+	* @param tmax Maximal distance of hit
+	* @param result Output hits of lanes
+	*/
+	static void intersect4(const ray& r, const triangle4& triangles, int lanes, float tmax, hit4& result);
+
+	/**
+	* @brief Moller-Trumbore test (both sides), reference of previous tracers
+	* @param origin, direction Ray
+	* @param a, b, c Vertices of triangle
+	* @return Distance of hit, negative if triangle is missed
+	*/
+	static float mollerTrumbore(glm::vec3 origin, glm::vec3 direction, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+	/**
+	* @brief Stores triangle into lane of structure of arrays
+	*/
+	static void store(triangle4& triangles, int lane, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+};
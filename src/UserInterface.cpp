@@ -20,6 +20,7 @@
 
 #include <iostream>
 #include <string>
+#include <algorithm>
 
 #ifndef FONT_FILE_DEST
 #define FONT_FILE_DEST "DroidSans.ttf"
@@ -60,7 +61,8 @@ void UserInterface::initGUI() {
 	//ImGui::StyleColorsLight();
 	ImGui::StyleColorsDark();
 
-	data->renderTimes = std::vector<float>(100);
+	// GPU times of rendering and BVH build phases
+	data->gpuTimer = std::make_shared<GPUTimer>();
 
 }
 
@@ -110,6 +112,9 @@ void UserInterface::renderGUI() {
 		showFileBrowser = true;
 	
 	ImGui::SameLine();
+	if (ImGui::Button("Generate scene..."))
+		showGenerator = true;
+
 	if (ImGui::Button("Show profile"))
 		showProfiler = true;
 	
@@ -121,6 +126,15 @@ void UserInterface::renderGUI() {
 		showHelp = true;
 	// Control buttons -------
 
+	// Camera path -------
+	ImGui::NewLine();
+	ImGui::Checkbox("Record camera path", &(data->recordPath));
+
+	ImGui::SameLine();
+	if (ImGui::Button("Replay") && !data->recordPath)
+		data->replayPath = true;
+	// Camera path -------
+
 
 	// FileBrowser Dialog -------
 	if (showFileBrowser && ImGuiFileDialog::Instance()->FileDialog("Choose Scene File", ".obj\0.stl\0.ply\0.dae\0\0", ".", "")) {
@@ -136,18 +150,68 @@ void UserInterface::renderGUI() {
 	// FileBrowser Dialog -------
 
 
+	// Scene generator Dialog -------
+	if (showGenerator) {
+		ImGui::Begin("Generate scene");
+
+		ImGui::Combo("Distribution", &generatorDistribution, "Uniform random\0Spheres\0Teapot in stadium\0Thin triangles\0Instanced grid\0\0");
+		ImGui::InputInt("Triangles", &generatorTriangles, 1000, 100000);
+		generatorTriangles = std::max(generatorTriangles, 1);
+
+		ImGui::NewLine();
+		if (ImGui::Button("Confirm")) {
+			data->sceneFile = SCENE_GENERATOR_PREFIX + SceneGenerator::getName(static_cast<SceneGenerator::distribution>(generatorDistribution)) + ":" + std::to_string(generatorTriangles);
+			showbvhChoose = true;
+			showGenerator = false;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel")) {
+			showGenerator = false;
+		}
+
+		ImGui::End();
+	}
+	// Scene generator Dialog -------
+
+
 	// BVH choose Dialog -------
 	if (showbvhChoose) {
 		ImGui::Begin("Choose BVH type");
 
 		ImGui::Text("Type of BVH");
 
-		if (ImGui::RadioButton("CPU implementation", !data->bvhType)) {
-			data->bvhType = 0;
+		if (ImGui::RadioButton("CPU implementation", data->bvhType == BVH_TYPE_SAH)) {
+			data->bvhType = BVH_TYPE_SAH;
+		}
+		if (ImGui::RadioButton("CPU clustering (PLOC)", data->bvhType == BVH_TYPE_PLOC)) {
+			data->bvhType = BVH_TYPE_PLOC;
+		}
+		if (ImGui::RadioButton("GPU implementation", data->bvhType == BVH_TYPE_GPU)) {
+			data->bvhType = BVH_TYPE_GPU;
+		}
+
+		// Longer morton codes separate more triangles of large scenes
+		if (data->bvhType == BVH_TYPE_GPU) {
+			ImGui::Checkbox("63-bit Morton codes", &(data->mortonCode64));
+			ImGui::Checkbox("Treelet optimization", &(data->treeletOptimization));
+			ImGui::Checkbox("Validate radix sort", &(data->sortValidation));
 		}
-		if (ImGui::RadioButton("GPU implementation", data->bvhType)) {
-			data->bvhType = 1;
+
+		// Order of flattened nodes of CPU BVH (access frequency layout needs sampling pass of benchmark)
+		if (data->bvhType != BVH_TYPE_GPU)
+			ImGui::Combo("Node layout", &(data->nodeLayout), "Depth first\0Breadth first\0van Emde Boas\0\0");
+
+		// Quality metrics and validation of built BVH (slow for large scenes)
+		ImGui::Checkbox("BVH metrics", &(data->bvhMetrics));
+
+		// Out-of-core mode (clusters streamed from disk)
+		ImGui::Checkbox("Out-of-core geometry", &(data->outOfCore));
+
+		if (data->outOfCore) {
+			ImGui::SliderInt("Memory budget [MB]", &(data->memoryBudget), 16, 4096);
+			ImGui::SliderInt("GPU budget [MB]", &(data->gpuBudget), 16, 4096);
 		}
+
 		ImGui::NewLine();
 		if (ImGui::Button("Confirm")) {
 			data->changeNotify = true;
@@ -162,6 +226,14 @@ void UserInterface::renderGUI() {
 	}
 	// BVH choose Dialog -------
 
+	// Loading progress -------
+	if (data->loading) {
+		ImGui::NewLine();
+		ImGui::Text("Loading scene");
+		ImGui::ProgressBar(data->loadProgress, ImVec2(-1.0f, 0.0f));
+	}
+	// Loading progress -------
+
 	ImGui::NewLine();
 	ImGui::End();
 	// GUI elements draw
@@ -172,10 +244,47 @@ void UserInterface::renderGUI() {
 	if (showProfiler) {
 		
 		ImGui::Begin("Profiler");
-		ImGui::PlotLines("Rendering times [ms]", data->renderTimes.data(), data->renderTimes.size(), 0, "", 0.0f, 1500.0f, ImVec2(250, 90));
-		ImGui::Text("Average %.2f ms", std::accumulate(data->renderTimes.begin(), data->renderTimes.end(), 0.0) / data->renderTimes.size());
-		ImGui::Text("Current %.2f ms", data->renderTimes[99]);
+
+		// Zones of the last frame or all stored zones (loading, builds)
+		drawFlameView();
 		ImGui::NewLine();
+
+		drawMemoryView();
+		ImGui::NewLine();
+
+		// GPU phases (times are several frames old)
+		for (auto& p : data->gpuTimer->getPhases()) {
+			ImGui::Text("%s", p.name);
+			ImGui::PushID(p.name);
+			ImGui::PlotLines("##history", p.history.data(), static_cast<int>(p.history.size()), p.head, "", 0.0f, 1500.0f, ImVec2(250, 90));
+			ImGui::PopID();
+			ImGui::Text("Average %.2f ms", std::accumulate(p.history.begin(), p.history.end(), 0.0) / p.history.size());
+			ImGui::Text("Current %.2f ms", p.last);
+			ImGui::NewLine();
+		}
+
+		// Metrics of BVH of current scene
+		if (data->bvhReport != nullptr) {
+			const BVHMetrics::report& r = *data->bvhReport;
+
+			ImGui::Text("BVH %s", r.valid ? "valid" : "INVALID");
+			ImGui::Text("Nodes %zu, leaves %zu", r.nodes, r.leaves);
+			ImGui::Text("SAH %.2f, EPO %.3f", r.sah, r.epo);
+			ImGui::Text("Sibling overlap %.3f", r.siblingOverlap);
+			ImGui::Text("Max depth %u, average leaf %.2f", r.maxDepth, r.averageLeafSize);
+			ImGui::Text("Memory %.2f MB", r.memory / (1024.0f * 1024.0f));
+
+			std::vector<float> depths(r.depthHistogram.begin(), r.depthHistogram.end());
+			ImGui::PlotHistogram("Leaf depth", depths.data(), static_cast<int>(depths.size()), 0, "", 0.0f, FLT_MAX, ImVec2(250, 60));
+
+			std::vector<float> sizes(r.leafSizeHistogram.begin(), r.leafSizeHistogram.end());
+			ImGui::PlotHistogram("Leaf size", sizes.data(), static_cast<int>(sizes.size()), 0, "", 0.0f, FLT_MAX, ImVec2(250, 60));
+
+			for (auto& e : r.errors)
+				ImGui::TextWrapped("%s", e.c_str());
+
+			ImGui::NewLine();
+		}
 		
 		if (ImGui::Button("Close"))
 			showProfiler = false;
@@ -223,3 +332,151 @@ void UserInterface::takeScreen(){
 
 	order++;
 }
+
+void UserInterface::drawFlameView(){
+
+	bool enabled = Profiler::isEnabled();
+
+	if (ImGui::Checkbox("Profiling", &enabled))
+		Profiler::setEnabled(enabled);
+
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause", &flamePaused);
+
+	ImGui::SameLine();
+	if (ImGui::Button("Save trace") && Profiler::writeTrace(PROFILER_TRACE_FILE))
+		std::cout << "Trace saved into " << PROFILER_TRACE_FILE << std::endl;
+
+	ImGui::RadioButton("Last frame", &flameRange, 0);
+	ImGui::SameLine();
+	ImGui::RadioButton("History", &flameRange, 1);
+
+	if (!flamePaused) {
+
+		if (flameRange == 0) {
+			Profiler::getLastFrame(flameBegin, flameEnd);
+			Profiler::collect(flameZones, flameBegin, flameEnd);
+		}
+
+		// Whole history of stored zones
+		else {
+			Profiler::collect(flameZones);
+			flameBegin = UINT64_MAX;
+			flameEnd = 0;
+
+			for (auto& z : flameZones) {
+				flameBegin = std::min(flameBegin, z.start);
+				flameEnd = std::max(flameEnd, z.start + z.duration);
+			}
+		}
+
+		flameThreads = Profiler::getThreads();
+	}
+
+	if (flameEnd <= flameBegin) {
+		ImGui::Text("No zones");
+		return;
+	}
+
+	ImGui::Text("Range %.3f ms", (flameEnd - flameBegin) / 1000000.0);
+
+	const float rowHeight = 16.0f;
+	float width = std::max(ImGui::GetContentRegionAvailWidth(), 100.0f);
+	double scale = width / static_cast<double>(flameEnd - flameBegin);
+
+	ImDrawList* draw = ImGui::GetWindowDrawList();
+
+	for (auto& t : flameThreads) {
+
+		// Lane height is given by the deepest zone of thread
+		unsigned depth = 0;
+		bool used = false;
+
+		for (auto& z : flameZones) {
+			if (z.thread == t.id) {
+				depth = std::max(depth, z.depth + 1);
+				used = true;
+			}
+		}
+
+		if (!used)
+			continue;
+
+		ImGui::Text("%s", t.name.c_str());
+
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		ImGui::Dummy(ImVec2(width, depth * rowHeight));
+
+		for (auto& z : flameZones) {
+
+			if (z.thread != t.id)
+				continue;
+
+			// Zones are clipped by range of view
+			double begin = (std::max(z.start, flameBegin) - flameBegin) * scale;
+			double end = (std::min(z.start + z.duration, flameEnd) - flameBegin) * scale;
+
+			ImVec2 a(origin.x + static_cast<float>(begin), origin.y + z.depth * rowHeight);
+			ImVec2 b(origin.x + std::max(static_cast<float>(end), static_cast<float>(begin) + 1.0f), a.y + rowHeight - 1.0f);
+
+			// Color is given by name, the same zone has the same color in all frames
+			unsigned hash = 2166136261u;
+			for (const char* c = z.name; *c != 0; c++)
+				hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+
+			draw->AddRectFilled(a, b, ImColor::HSV((hash % 360) / 360.0f, 0.5f, t.id == PROFILER_GPU_THREAD ? 0.6f : 0.8f));
+
+			if (b.x - a.x > ImGui::CalcTextSize(z.name).x + 4.0f)
+				draw->AddText(ImVec2(a.x + 2.0f, a.y + 1.0f), IM_COL32(0, 0, 0, 255), z.name);
+
+			if (ImGui::IsMouseHoveringRect(a, b))
+				ImGui::SetTooltip("%s %.3f ms", z.name, z.duration / 1000000.0);
+		}
+	}
+
+}
+
+void UserInterface::drawMemoryView(){
+
+	const float mb = 1024.0f * 1024.0f;
+
+	ImGui::Text("Memory [MB]");
+
+	if (AllocationCounter::count() == 0)
+		ImGui::Text("Heap counting is disabled (RT_COUNT_ALLOCATIONS)");
+
+	ImGui::Columns(5, "memory");
+	ImGui::Text("Subsystem");
+	ImGui::NextColumn();
+	ImGui::Text("Heap");
+	ImGui::NextColumn();
+	ImGui::Text("Heap peak");
+	ImGui::NextColumn();
+	ImGui::Text("GPU");
+	ImGui::NextColumn();
+	ImGui::Text("GPU peak");
+	ImGui::NextColumn();
+	ImGui::Separator();
+
+	for (int i = 0; i < AllocationCounter::SUBSYSTEM_COUNT; i++) {
+
+		AllocationCounter::subsystem s = static_cast<AllocationCounter::subsystem>(i);
+
+		ImGui::Text("%s", AllocationCounter::getName(s));
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", AllocationCounter::bytes(s) / mb);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", AllocationCounter::peakBytes(s) / mb);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", AllocationCounter::gpuBytes(s) / mb);
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", AllocationCounter::gpuPeakBytes(s) / mb);
+		ImGui::NextColumn();
+	}
+
+	ImGui::Columns(1);
+
+	if (ImGui::Button("Reset peaks"))
+		AllocationCounter::resetPeak();
+
+}
@@ -12,8 +12,18 @@
 
 
 #include <Window.h>
+#include <GPUTimer.h>
+#include <Profiler.h>
+#include <BVHMetrics.h>
+#include <SceneGenerator.h>
+#include <AllocationCounter.h>
 #include <numeric>
 
+// Builders of BVH selected in UI and job files (format of nodes for trace shader is BVH_NODES_*)
+#define BVH_TYPE_SAH 0		// CPU SAH builder
+#define BVH_TYPE_GPU 1		// Radix tree built on GPU
+#define BVH_TYPE_PLOC 2		// CPU clustering (PLOC)
+
 /**
 * @brief Class for User Interface control
 */
@@ -30,10 +40,23 @@ public:
 		int dofSamples = 1;
 		int aoSamples = 0;
 		std::string sceneFile = "";
-		int bvhType;
+		int bvhType;					// BVH_TYPE_SAH, BVH_TYPE_GPU or BVH_TYPE_PLOC
+		bool mortonCode64 = false;
+		bool treeletOptimization = false;
+		bool sortValidation = false;
+		bool bvhMetrics = false;
+		int nodeLayout = 0;
 		bool renderMode = true;
 		bool changeNotify = false;
-		std::vector<float> renderTimes;
+		bool outOfCore = false;
+		int memoryBudget = 256;
+		int gpuBudget = 256;
+		bool recordPath = false;
+		bool replayPath = false;
+		bool loading = false;
+		float loadProgress = 0.0f;
+		std::shared_ptr<GPUTimer> gpuTimer;
+		std::shared_ptr<BVHMetrics::report> bvhReport;
 	} uiData;
 
 	/**
@@ -66,6 +89,16 @@ public:
 	*/
 	void takeScreen();
 
+	/**
+	* @brief Draws zones of profiler as flame graph (one lane per thread, one row per nesting depth)
+	*/
+	void drawFlameView();
+
+	/**
+	* @brief Draws table of heap and GPU memory of subsystems (current and peak)
+	*/
+	void drawMemoryView();
+
 	// Informations about context
 	std::shared_ptr<Window> window;
 	std::shared_ptr<uiData> data;
@@ -76,5 +109,17 @@ public:
 	bool showProfiler = false;
 	bool showbvhChoose = false;
 	bool showHelp = false;
+	bool showGenerator = false;
+
+	// State of flame view (zones are kept while view is paused)
+	bool flamePaused = false;
+	int flameRange = 0;
+	uint64_t flameBegin = 0, flameEnd = 0;
+	std::vector<Profiler::zone> flameZones;
+	std::vector<Profiler::thread> flameThreads;
+
+	// Parameters of generated scene
+	int generatorDistribution = SceneGenerator::UNIFORM_RANDOM;
+	int generatorTriangles = 100000;
 
 };
\ No newline at end of file
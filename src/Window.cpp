@@ -10,6 +10,9 @@
 
 #include <Window.h>
 
+#include <cstdlib>
+#include <iostream>
+
 Window::Window(int width, int height, std::string title) {
 	this->width = width;
 	this->height = height;
@@ -65,20 +68,51 @@ void Window::makeContextCurrent() {
 
 void Window::setDefaults() {
 
-	// Setup default values for window
-	glfwWindowHint(GLFW_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_VERSION_MINOR, 4);
-	glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+	// Setup default values for window (window hints are valid only after glfwInit)
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+	glfwWindowHint(GLFW_VISIBLE, headless ? GL_FALSE : GL_TRUE);
+
+#if defined(GLFW_OSMESA_CONTEXT_API) && !defined(_WIN32)
+	// Software context on machines without display
+	if (headless && !hasDisplay())
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+
 	glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
-	glfwWindowHint(GLFW_SAMPLES, 16);
+
+	// Hidden window is not presented, multisampling would only cost memory
+	if (!headless)
+		glfwWindowHint(GLFW_SAMPLES, 16);
+}
+
+
+bool Window::hasDisplay() {
+#ifdef _WIN32
+	return true;
+#else
+	return std::getenv("DISPLAY") != nullptr || std::getenv("WAYLAND_DISPLAY") != nullptr;
+#endif
 }
 
 
 bool Window::createWindow() {
 
-	// Initialization
-	if (!glfwInit())
+	// Initialization (platform has to be selected by init hint before glfwInit)
+#if defined(GLFW_PLATFORM_NULL) && !defined(_WIN32)
+	// GLFW 3.4 - platform without display, context is created by OSMesa
+	if (headless && !hasDisplay())
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
+	if (!glfwInit()) {
+		if (headless && !hasDisplay())
+			std::cout << "GLFW without display needs null platform (GLFW 3.4), else run batch rendering under virtual display (xvfb-run)" << std::endl;
 		return false;
+	}
+
+	// Hints are reset by glfwInit
+	setDefaults();
 
 	window.reset(glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr));
 
@@ -109,10 +143,18 @@ bool Window::isResized(){
 
 
 void Window::showWindow() {
-	setDefaults();
 	if (!createWindow()) throw std::exception("Cannot create window\n");
 }
 
+void Window::setHeadless(bool enable){
+	headless = enable;
+}
+
+void Window::setSize(int width, int height){
+	glfwSetWindowSize(window.get(), width, height);
+	checkViewportResize();
+}
+
 void Window::checkViewportResize(){
 
 	int w, h;
@@ -82,10 +82,16 @@ public:
 
 
 	/**
-	* @brief sets window properties to default values
+	* @brief sets window properties to default values (called after glfwInit, which resets hints)
 	*/
 	void setDefaults();
 
+	/**
+	* @brief Checks, if application runs with display server (X11 or Wayland)
+	* @return true if display is available
+	*/
+	static bool hasDisplay();
+
 
 	/**
 	* @brief creates graphics context and window
@@ -109,6 +115,19 @@ public:
 	*/
 	void checkViewportResize();
 
+	/**
+	* @brief Sets window without display (hidden window, null platform and OSMesa context if there is no display), called before showWindow
+	* @param enable true for batch rendering
+	*/
+	void setHeadless(bool enable);
+
+	/**
+	* @brief Changes size of window (and viewport)
+	* @param width New width in pixels
+	* @param height New height in pixels
+	*/
+	void setSize(int width, int height);
+
 
 private:
 
@@ -127,6 +146,7 @@ private:
 	// Attributes of window
 	int width, height;
 	bool viewportResize = false;
+	bool headless = false;
 	std::string title;
 	std::unique_ptr<GLFWwindow, DestroyWin> window;
 	
@@ -10,17 +10,88 @@
 
 #include <bvhPreprocessor.h>
 
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
 //#define PRINT_NODES
 
 void bvhPreprocessor::transformBVH(ge::sg::BVH_Node<ge::sg::AABB>* root, ge::sg::IndexedTriangleIterator first){
 
-	tree.shrink_to_fit();
-	associatedIndices.clear();
-	tmp_cnt = id = 0;
+	tree.clear();
+
+	if (root == nullptr)
+		return;
+
+	// Small trees are flattened by calling thread
+	if (threads == 1 || root->last - root->first < BVH_PREPROCESSOR_PARALLEL_PRIMITIVES || isSubtreeRoot(root, 0))
+		flattenSubtree(root, first, tree);
+
+	else {
+
+		ThreadPool pool(threads);
+
+		std::vector<bvhNode*> roots;
+		collectSubtrees(root, 0, roots);
+
+		// Subtrees are flattened in parallel, their nodes are indexed from 0
+		std::vector<std::vector<gpuNode>> parts(roots.size());
+		std::vector<std::future<void>> tasks;
+		size_t size = 0;
+
+		for (size_t i = 0; i < roots.size(); i++)
+			tasks.push_back(pool.submit([&roots, &parts, first, i]() { flattenSubtree(roots[i], first, parts[i]); }));
+
+		for (size_t i = 0; i < roots.size(); i++) {
+			tasks[i].get();
+			size += parts[i].size();
+		}
+
+		// Nodes above subtrees (less than 2^depth) and ranges of subtrees
+		std::vector<int> offsets;
+		tree.reserve(size + roots.size());
+		placeTop(root, first, 0, -1, false, parts, offsets);
 
-	associatedIndices.insert(std::pair<ge::sg::BVH_Node<ge::sg::AABB>*, int>(nullptr, -1));
-	traverseTree(root, first, -1);
-	connectTree(root, -1);
+		// Subtrees are moved behind their roots (roots were placed with top)
+		tasks.clear();
+
+		for (size_t i = 0; i < roots.size(); i++) {
+			tasks.push_back(pool.submit([this, &parts, &offsets, i]() {
+				int offset = offsets[i];
+				const std::vector<gpuNode>& part = parts[i];
+
+				for (size_t j = 1; j < part.size(); j++) {
+					gpuNode n = part[j];
+					n.left += n.left != -1 ? offset : 0;
+					n.right += n.right != -1 ? offset : 0;
+					n.parent += offset;
+					n.sibling += n.sibling != -1 ? offset : 0;
+					tree[offset + j] = n;
+				}
+			}));
+		}
+
+		for (auto& t : tasks)
+			t.get();
+	}
+
+	if (nodeLayout != DEPTH_FIRST)
+		applyLayout();
+
+	// Children are reordered by split axis, layout needs preorder of builder
+	encodeChildren(tree);
+
+#ifdef PRINT_NODES
+	for (size_t id = 0; id < tree.size(); id++) {
+		printf("tree %d: extent: %d %d childs: %d %d\n", static_cast<int>(id), tree[id].first, tree[id].last, tree[id].left, tree[id].right);
+		printf("tree %d: min: %f %f %f\n", static_cast<int>(id), tree[id]._min.x, tree[id]._min.y, tree[id]._min.z);
+		printf("tree %d: max: %f %f %f\n\n", static_cast<int>(id), tree[id]._max.x, tree[id]._max.y, tree[id]._max.z);
+	}
+#endif
 
 }
 
@@ -28,54 +99,407 @@ std::vector<bvhPreprocessor::gpuNode>* bvhPreprocessor::getTree(){
 	return &tree;
 }
 
-void bvhPreprocessor::traverseTree(ge::sg::BVH_Node<ge::sg::AABB>* node, ge::sg::IndexedTriangleIterator first, int parent){
+void bvhPreprocessor::setThreads(unsigned _threads){
+	threads = _threads;
+}
+
+void bvhPreprocessor::setLayout(layout l){
+	nodeLayout = l;
+}
+
+void bvhPreprocessor::setAccessFrequencies(const std::vector<uint32_t>& accesses){
+	frequencies = accesses;
+}
+
+std::string bvhPreprocessor::getLayoutName(layout l){
+
+	switch (l) {
+	case DEPTH_FIRST: return "dfs";
+	case BREADTH_FIRST: return "bfs";
+	case VAN_EMDE_BOAS: return "veb";
+	case ACCESS_FREQUENCY: return "frequency";
+	}
+
+	return "";
+}
+
+bool bvhPreprocessor::parseLayout(std::string name, layout & l){
+
+	for (layout candidate : { DEPTH_FIRST, BREADTH_FIRST, VAN_EMDE_BOAS, ACCESS_FREQUENCY }) {
+		if (getLayoutName(candidate) == name) {
+			l = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void bvhPreprocessor::flattenSubtree(bvhNode* root, ge::sg::IndexedTriangleIterator first, std::vector<gpuNode>& nodes){
+
+	// Left child is on top of stack, it directly follows its parent
+	std::vector<pendingNode> stack = { { root, -1, false } };
+
+	while (!stack.empty()) {
+
+		pendingNode p = stack.back();
+		stack.pop_back();
+
+		int index = static_cast<int>(nodes.size());
+		nodes.push_back(createNode(p.node, first, p.parent));
+		connect(nodes, index, p.parent, p.right);
+
+		if (p.node->right != nullptr)
+			stack.push_back({ p.node->right.get(), index, true });
+
+		if (p.node->left != nullptr)
+			stack.push_back({ p.node->left.get(), index, false });
+	}
+
+}
+
+void bvhPreprocessor::collectSubtrees(bvhNode* node, unsigned depth, std::vector<bvhNode*>& roots){
+
+	if (isSubtreeRoot(node, depth)) {
+		roots.push_back(node);
+		return;
+	}
+
+	collectSubtrees(node->left.get(), depth + 1, roots);
+	collectSubtrees(node->right.get(), depth + 1, roots);
+
+}
+
+void bvhPreprocessor::placeTop(bvhNode* node, ge::sg::IndexedTriangleIterator first, unsigned depth, int parent, bool right, const std::vector<std::vector<gpuNode>>& parts, std::vector<int>& offsets){
+
+	int index = static_cast<int>(tree.size());
+
+	// Root of flattened subtree, the rest of subtree is copied later
+	if (isSubtreeRoot(node, depth)) {
+
+		const std::vector<gpuNode>& part = parts[offsets.size()];
+		offsets.push_back(index);
+
+		gpuNode n = part[0];
+		n.left += n.left != -1 ? index : 0;
+		n.right += n.right != -1 ? index : 0;
+		n.parent = parent;
+
+		tree.resize(tree.size() + part.size());
+		tree[index] = n;
+		connect(tree, index, parent, right);
+		return;
+	}
+
+	tree.push_back(createNode(node, first, parent));
+	connect(tree, index, parent, right);
+
+	placeTop(node->left.get(), first, depth + 1, index, false, parts, offsets);
+	placeTop(node->right.get(), first, depth + 1, index, true, parts, offsets);
+
+}
+
+bvhPreprocessor::gpuNode bvhPreprocessor::createNode(bvhNode* node, ge::sg::IndexedTriangleIterator first, int parent){
 
-	int cnt = tmp_cnt;
-	
 	gpuNode n;
 	n._min = glm::vec4(node->volume.min, 0.0f);
 	n._max = glm::vec4(node->volume.max, 0.0f);
-	n.first = (node->first - first);
-	n.last = (node->last - first);
+	n.left = -1;
+	n.right = -1;
 	n.parent = parent;
-	
-	associatedIndices.insert(std::pair<ge::sg::BVH_Node<ge::sg::AABB>*, int>(node, tmp_cnt));
-	
-	tmp_cnt++;
-	tree.push_back(n);
+	n.sibling = -1;
+	n.bounds = 0;
+
+	// Only leaves have range of primitives, inner nodes get bounds of children later
+	if (node->left == nullptr && node->right == nullptr) {
+		n.first = static_cast<int>(node->first - first);
+		n.last = static_cast<int>(node->last - first);
+		n.axis = -1;
+	}
+	else {
+		n.first = n.last = -1;
+		n.axis = node->axis;
+	}
+
+	return n;
+}
+
+void bvhPreprocessor::connect(std::vector<gpuNode>& nodes, int index, int parent, bool right){
+
+	if (parent == -1)
+		return;
+
+	gpuNode& p = nodes[parent];
 
-	if (node->left != nullptr)
-		traverseTree(node->left.get(), first, cnt);
+	if (!right) {
+		p.left = index;
+		return;
+	}
+
+	p.right = index;
 
-	if (node->right != nullptr)
-		traverseTree(node->right.get(), first, cnt);
+	if (p.left != -1) {
+		nodes[index].sibling = p.left;
+		nodes[p.left].sibling = index;
+	}
 
 }
 
-void bvhPreprocessor::connectTree(ge::sg::BVH_Node<ge::sg::AABB>* node, int sibling){
+void bvhPreprocessor::encodeChildren(std::vector<gpuNode>& nodes){
+
+	for (gpuNode& n : nodes) {
+
+		if (n.left == -1 && n.right == -1) {
+			n.bounds = 0;
+			n.axis = -1;
+			continue;
+		}
+
+		glm::vec3 childMin[2], childMax[2];
+
+		for (int c = 0; c < 2; c++) {
+			int child = c == 0 ? n.left : n.right;
+			childMin[c] = glm::vec3(child != -1 ? nodes[child]._min : n._max);
+			childMax[c] = glm::vec3(child != -1 ? nodes[child]._max : n._min);
+		}
+
+		// Builder without split planes - children are ordered along axis of the largest distance of their centers
+		if (n.axis == -1 && n.left != -1 && n.right != -1) {
+
+			n.axis = splitAxis(childMin[0], childMax[0], childMin[1], childMax[1]);
+
+			if (childMin[0][n.axis] + childMax[0][n.axis] > childMin[1][n.axis] + childMax[1][n.axis]) {
+				std::swap(n.left, n.right);
+				std::swap(childMin[0], childMin[1]);
+				std::swap(childMax[0], childMax[1]);
+			}
+		}
 
-	tree[id].left = associatedIndices.at(node->left.get());
-	tree[id].right = associatedIndices.at(node->right.get());
-	
-	if (tree[id].left != -1 || tree[id].right != -1) {
-			tree[id].first = -1;
-			tree[id].last = -1;
+		n.axis = std::max(n.axis, 0);
+
+		glm::ivec3 planes = quantizeChildren(glm::vec3(n._min), glm::vec3(n._max), childMin, childMax);
+		n.first = planes.x;
+		n.last = planes.y;
+		n.bounds = planes.z;
 	}
-	
-	tree[id].sibling = sibling;
-	
-#ifdef PRINT_NODES
-	printf("tree %d: extent: %d %d childs: %d %d\n", id, tree[id].first, tree[id].last, tree[id].left, tree[id].right);
-	printf("tree %d: min: %f %f %f\n", id, tree[id]._min.x, tree[id]._min.y, tree[id]._min.z);
-	printf("tree %d: max: %f %f %f\n\n", id, tree[id]._max.x, tree[id]._max.y, tree[id]._max.z);
-#endif
 
-	id++;
+}
+
+glm::ivec3 bvhPreprocessor::quantizeChildren(glm::vec3 min, glm::vec3 max, const glm::vec3 childMin[2], const glm::vec3 childMax[2]){
+
+	const int steps = BVH_PREPROCESSOR_QUANTIZATION_STEPS;
+	glm::ivec3 packed;
+
+	for (int a = 0; a < 3; a++) {
+
+		double extent = static_cast<double>(max[a]) - min[a];
+		float tolerance = (std::abs(min[a]) + std::abs(max[a])) * BVH_PREPROCESSOR_QUANTIZATION_EPSILON;
+
+		auto step = [&](float v) { return extent > 0.0 ? (v - min[a]) / extent * steps : 0.0; };
+
+		// Decoding of trace.cs, the first and the last step are exact
+		auto decode = [&](int q) {
+			float f = q / static_cast<float>(steps);
+			return min[a] * (1.0f - f) + max[a] * f;
+		};
+
+		uint32_t word = 0;
+
+		for (int c = 0; c < 2; c++) {
+
+			int low = glm::clamp(static_cast<int>(std::floor(step(childMin[c][a]))), 0, steps);
+			int high = glm::clamp(static_cast<int>(std::ceil(step(childMax[c][a]))), 0, steps);
+
+			// Planes are moved outwards until rounding of decoding cannot cut the child
+			while (low > 0 && decode(low) > childMin[c][a] - tolerance)
+				low--;
+
+			while (high < steps && decode(high) < childMax[c][a] + tolerance)
+				high++;
+
+			word |= static_cast<uint32_t>(low) << (16 * c);
+			word |= static_cast<uint32_t>(high) << (16 * c + 8);
+		}
+
+		packed[a] = static_cast<int>(word);
+	}
+
+	return packed;
+}
+
+void bvhPreprocessor::childBounds(const gpuNode& node, bool right, glm::vec3& childMin, glm::vec3& childMax){
+
+	const int planes[3] = { node.first, node.last, node.bounds };
+
+	for (int a = 0; a < 3; a++) {
+
+		uint32_t word = static_cast<uint32_t>(planes[a]) >> (right ? 16 : 0);
+		float low = (word & 0xff) / static_cast<float>(BVH_PREPROCESSOR_QUANTIZATION_STEPS);
+		float high = ((word >> 8) & 0xff) / static_cast<float>(BVH_PREPROCESSOR_QUANTIZATION_STEPS);
+
+		childMin[a] = node._min[a] * (1.0f - low) + node._max[a] * low;
+		childMax[a] = node._min[a] * (1.0f - high) + node._max[a] * high;
+	}
+
+}
+
+int bvhPreprocessor::splitAxis(glm::vec3 leftMin, glm::vec3 leftMax, glm::vec3 rightMin, glm::vec3 rightMax){
+
+	glm::vec3 d = glm::abs(leftMin + leftMax - rightMin - rightMax);
+
+	return d.x >= d.y && d.x >= d.z ? 0 : d.y >= d.z ? 1 : 2;
+}
+
+bool bvhPreprocessor::isSubtreeRoot(bvhNode* node, unsigned depth){
+	return depth == BVH_PREPROCESSOR_TASK_DEPTH || node->left == nullptr || node->right == nullptr;
+}
+
+void bvhPreprocessor::applyLayout(){
+
+	// Sizes and heights of subtrees, children follow their parent in preorder
+	std::vector<int> sizes(tree.size(), 1);
+	std::vector<unsigned> heights(tree.size(), 1);
+
+	for (size_t i = tree.size(); i-- > 0;) {
+		for (int c : { tree[i].left, tree[i].right }) {
+			if (c != -1) {
+				sizes[i] += sizes[c];
+				heights[i] = std::max(heights[i], heights[c] + 1);
+			}
+		}
+	}
+
+	// Old position of node on every new position
+	std::vector<int> order;
+	order.reserve(tree.size());
+
+	switch (nodeLayout) {
+
+	case DEPTH_FIRST:
+		return;
 
-	if (node->left != nullptr)
-		connectTree(node->left.get(), associatedIndices.at(node->right.get()));
+	case BREADTH_FIRST:
+		breadthFirstOrder(sizes, order);
+		break;
+
+	case VAN_EMDE_BOAS:
+		vanEmdeBoasOrder(0, heights[0], heights, order);
+		break;
+
+	case ACCESS_FREQUENCY:
+
+		if (frequencies.size() != tree.size()) {
+			std::cout << "Access frequencies do not match BVH, depth first layout is used" << std::endl;
+			return;
+		}
+
+		{
+			// Children are read together, pairs of siblings are sorted by their accesses (ties keep preorder)
+			std::vector<int> parents;
+
+			for (size_t i = 0; i < tree.size(); i++)
+				if (tree[i].left != -1 || tree[i].right != -1)
+					parents.push_back(static_cast<int>(i));
+
+			auto accesses = [this](int parent) { return frequencies[tree[parent].left != -1 ? tree[parent].left : tree[parent].right]; };
+			std::stable_sort(parents.begin(), parents.end(), [&accesses](int a, int b) { return accesses(a) > accesses(b); });
+
+			order.push_back(0);
+
+			for (int p : parents)
+				for (int c : { tree[p].left, tree[p].right })
+					if (c != -1)
+						order.push_back(c);
+		}
+		break;
+	}
+
+	std::vector<int> position(tree.size());
+
+	for (size_t i = 0; i < order.size(); i++)
+		position[order[i]] = static_cast<int>(i);
+
+	auto remap = [&position](int i) { return i != -1 ? position[i] : -1; };
+
+	std::vector<gpuNode> reordered(tree.size());
+
+	for (size_t i = 0; i < order.size(); i++) {
+		gpuNode n = tree[order[i]];
+		n.left = remap(n.left);
+		n.right = remap(n.right);
+		n.parent = remap(n.parent);
+		n.sibling = remap(n.sibling);
+		reordered[i] = n;
+	}
+
+	tree.swap(reordered);
+
+}
+
+void bvhPreprocessor::breadthFirstOrder(const std::vector<int>& sizes, std::vector<int>& order){
+
+	// Queue of nodes with their levels, nodes below top levels are roots of subtrees
+	std::vector<std::pair<int, unsigned>> queue = { { 0, 0 } };
+	std::vector<int> roots;
+
+	for (size_t i = 0; i < queue.size(); i++) {
+
+		int node = queue[i].first;
+		unsigned level = queue[i].second;
+
+		if (level == BVH_PREPROCESSOR_BFS_LEVELS) {
+			roots.push_back(node);
+			continue;
+		}
+
+		order.push_back(node);
+
+		for (int c : { tree[node].left, tree[node].right })
+			if (c != -1)
+				queue.push_back({ c, level + 1 });
+	}
+
+	// Subtree is continuous range of preorder
+	for (int r : roots)
+		for (int i = r; i < r + sizes[r]; i++)
+			order.push_back(i);
+
+}
+
+void bvhPreprocessor::vanEmdeBoasOrder(int node, unsigned levels, const std::vector<unsigned>& heights, std::vector<int>& order){
+
+	levels = std::min(levels, heights[node]);
+
+	if (levels == 1) {
+		order.push_back(node);
+		return;
+	}
+
+	// Top half of levels
+	unsigned top = levels / 2;
+	vanEmdeBoasOrder(node, top, heights, order);
+
+	// Roots of bottom subtrees are nodes in depth top below node
+	std::vector<std::pair<int, unsigned>> stack = { { node, 0 } };
+	std::vector<int> roots;
+
+	while (!stack.empty()) {
+
+		std::pair<int, unsigned> p = stack.back();
+		stack.pop_back();
+
+		if (p.second == top) {
+			roots.push_back(p.first);
+			continue;
+		}
+
+		// Right child is pushed first, roots are in order from left
+		for (int c : { tree[p.first].right, tree[p.first].left })
+			if (c != -1)
+				stack.push_back({ c, p.second + 1 });
+	}
 
-	if (node->right != nullptr)
-		connectTree(node->right.get(), associatedIndices.at(node->left.get()));
+	for (int r : roots)
+		vanEmdeBoasOrder(r, levels - top, heights, order);
 
 }
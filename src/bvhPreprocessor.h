@@ -10,15 +10,31 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
-#include <map>
 
 #include <glm/glm.hpp>
 
 #include <BVH.h>
 #include <AABB_SAH_BVH.h>
 
+// Trees with less primitives are flattened by calling thread only
+#define BVH_PREPROCESSOR_PARALLEL_PRIMITIVES 100000
+
+// Depth of roots of subtrees flattened by parallel tasks (at most 2^depth tasks)
+#define BVH_PREPROCESSOR_TASK_DEPTH 6
+
+// Number of top levels of breadth first layout (subtrees below them are depth first)
+#define BVH_PREPROCESSOR_BFS_LEVELS 8
+
+// Bounds of children stored in parent - planes quantized to 8 bits relative to parent
+#define BVH_PREPROCESSOR_QUANTIZATION_STEPS 255
+
+// Tolerance of decoded planes relative to magnitude of parent bounds (rounding of GPU arithmetic)
+#define BVH_PREPROCESSOR_QUANTIZATION_EPSILON 1e-6f
+
 /**
 * @brief Transformation BVH structure into GPU SSBO buffer
 */
@@ -28,26 +44,38 @@ public:
 
 	/**
 	* @brief structure of BVH node on GPU
+	* @note Inner nodes store quantized bounds of children instead of range of primitives (first - x, last - y, bounds - z planes)
 	*/
 	typedef struct {
 		glm::vec4 _min;
 		glm::vec4 _max;
 		int left;
 		int right;
-		int first;
-		int last;
+		int first;		// Leaf - first primitive, inner node - planes of children on x axis
+		int last;		// Leaf - last primitive, inner node - planes of children on y axis
 		int parent;
 		int sibling;
-		int gapA, gapB;
+		int bounds;		// Inner node - planes of children on z axis
+		int axis;		// Split axis of inner node, left child is on its lower side (-1 for leaf)
 	} gpuNode;
 
+	/**
+	* @brief Orders of nodes in memory (root is always the first node)
+	*/
+	typedef enum {
+		DEPTH_FIRST,		// Preorder, left child directly follows its parent
+		BREADTH_FIRST,		// Top levels level by level, subtrees below them in preorder
+		VAN_EMDE_BOAS,		// Recursive clusters of subtrees of half height (cache oblivious)
+		ACCESS_FREQUENCY	// Pairs of siblings sorted by measured accesses, the hottest first
+	} layout;
+
 	/**
 	* @brief Constructor - empty
 	*/
 	bvhPreprocessor(){}
 
 	/**
-	* @brief Transformation of BVH structure into vector of GPU nodes
+	* @brief Transformation of BVH structure into vector of GPU nodes (nodes in preorder, single pass without lookups)
 	* @param root Root node of BVH structure to be transformed
 	* @param first Iterator of first primitive in BVH
 	*/
@@ -59,28 +87,152 @@ public:
 	*/
 	std::vector<gpuNode>* getTree();
 
+	/**
+	* @brief Setter for number of threads flattening subtrees of large trees
+	* @param _threads Number of worker threads (0 - hardware concurrency, 1 - calling thread only)
+	*/
+	void setThreads(unsigned _threads);
+
+	/**
+	* @brief Setter for order of transformed nodes
+	* @param l Layout of nodes (depth first by default)
+	*/
+	void setLayout(layout l);
+
+	/**
+	* @brief Setter for accesses of nodes measured by sampling pass (used by access frequency layout)
+	* @param accesses Number of accesses of every node in depth first layout of the same BVH
+	*/
+	void setAccessFrequencies(const std::vector<uint32_t>& accesses);
+
+	/**
+	* @brief Getter for name of layout
+	* @param l Layout
+	* @return Name used by benchmarks (dfs, bfs, veb, frequency)
+	*/
+	static std::string getLayoutName(layout l);
+
+	/**
+	* @brief Parses name of layout
+	* @param name Name of layout
+	* @param l Output layout
+	* @return true if name is known
+	*/
+	static bool parseLayout(std::string name, layout& l);
+
+	/**
+	* @brief Stores split axis and quantized bounds of children into inner nodes
+	* @param nodes Flattened BVH, inner nodes without recorded axis (-1) get axis of the largest distance of children and their children are ordered along it
+	*/
+	static void encodeChildren(std::vector<gpuNode>& nodes);
+
+	/**
+	* @brief Quantizes bounds of children relative to their parent, decoded bounds always contain children
+	* @param min, max Bounds of parent
+	* @param childMin, childMax Bounds of left and right child (missing child has empty bounds)
+	* @return Packed planes of every axis (bytes - left min, left max, right min, right max)
+	*/
+	static glm::ivec3 quantizeChildren(glm::vec3 min, glm::vec3 max, const glm::vec3 childMin[2], const glm::vec3 childMax[2]);
+
+	/**
+	* @brief Decodes bounds of child stored in inner node (the same arithmetic as trace.cs)
+	* @param node Inner node
+	* @param right true for right child
+	* @param childMin, childMax Output bounds
+	*/
+	static void childBounds(const gpuNode& node, bool right, glm::vec3& childMin, glm::vec3& childMax);
+
+	/**
+	* @brief Axis with the largest distance of centers of children (split axis of builders without planes)
+	*/
+	static int splitAxis(glm::vec3 leftMin, glm::vec3 leftMax, glm::vec3 rightMin, glm::vec3 rightMax);
+
 private:
 
+	typedef ge::sg::BVH_Node<ge::sg::AABB> bvhNode;
+
 	/**
-	* @brief Traversal of BVH to gain informations in nodes
-	* @param node current node
+	* @brief Node waiting for flattening with position of its parent
+	*/
+	typedef struct {
+		bvhNode* node;
+		int parent;
+		bool right;
+	} pendingNode;
+
+	/**
+	* @brief Flattens subtree in preorder, indices of nodes are positions in vector
+	* @param root Root of subtree (its parent and sibling are -1)
 	* @param first first primitive in BVH structure
-	* @param parent id number of parent node
+	* @param nodes Output vector, nodes are appended
 	*/
-	void traverseTree(ge::sg::BVH_Node<ge::sg::AABB>* node, ge::sg::IndexedTriangleIterator first, int parent);
+	static void flattenSubtree(bvhNode* root, ge::sg::IndexedTriangleIterator first, std::vector<gpuNode>& nodes);
 
 	/**
-	* @brief Second traversal pass to get connections between nodes
+	* @brief Finds roots of subtrees of parallel tasks in preorder
 	* @param node current node
-	* @param sibling id number of current node's sibling
+	* @param depth depth of current node
+	* @param roots Output roots
 	*/
-	void connectTree(ge::sg::BVH_Node<ge::sg::AABB>* node, int sibling);
+	static void collectSubtrees(bvhNode* node, unsigned depth, std::vector<bvhNode*>& roots);
+
+	/**
+	* @brief Places nodes above subtrees in preorder and reserves ranges of flattened subtrees behind their roots
+	* @param node current node
+	* @param first first primitive in BVH structure
+	* @param depth depth of current node
+	* @param parent position of parent node (-1 for root)
+	* @param right true if node is right child
+	* @param parts Flattened subtrees in preorder of roots
+	* @param offsets Output positions of subtrees
+	*/
+	void placeTop(bvhNode* node, ge::sg::IndexedTriangleIterator first, unsigned depth, int parent, bool right, const std::vector<std::vector<gpuNode>>& parts, std::vector<int>& offsets);
+
+	/**
+	* @brief Creates GPU node without connections
+	*/
+	static gpuNode createNode(bvhNode* node, ge::sg::IndexedTriangleIterator first, int parent);
+
+	/**
+	* @brief Connects node with its parent and sibling (left child precedes right one in preorder)
+	* @param nodes Flattened nodes
+	* @param index position of node
+	* @param parent position of parent node (-1 for root)
+	* @param right true if node is right child
+	*/
+	static void connect(std::vector<gpuNode>& nodes, int index, int parent, bool right);
+
+	/**
+	* @brief Tests whether node is flattened by parallel task
+	*/
+	static bool isSubtreeRoot(bvhNode* node, unsigned depth);
+
+	/**
+	* @brief Reorders nodes of depth first tree into selected layout and remaps their connections
+	*/
+	void applyLayout();
+
+	/**
+	* @brief Breadth first order of top levels followed by depth first subtrees
+	* @param sizes Sizes of subtrees of nodes
+	* @param order Output order of nodes
+	*/
+	void breadthFirstOrder(const std::vector<int>& sizes, std::vector<int>& order);
+
+	/**
+	* @brief Van Emde Boas order - top half of levels, then subtrees below it, both recursively
+	* @param node Root of laid out part of tree
+	* @param levels Number of levels of laid out part
+	* @param heights Heights of subtrees of nodes (leaf has height 1)
+	* @param order Output order of nodes
+	*/
+	void vanEmdeBoasOrder(int node, unsigned levels, const std::vector<unsigned>& heights, std::vector<int>& order);
 
 	// Result vector
 	std::vector<gpuNode> tree;
-	
-	// Neccesary attributes for transformation
-	std::map<ge::sg::BVH_Node<ge::sg::AABB>*, int> associatedIndices;
-	int id = 0, tmp_cnt = 0;
+
+	unsigned threads = 0;
+	layout nodeLayout = DEPTH_FIRST;
+	std::vector<uint32_t> frequencies;
 
 };
\ No newline at end of file